@@ -0,0 +1,411 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <host-support.h>
+#include <stacsos/kernel/mem/page-allocator-buddy.h>
+#include <stacsos/kernel/mem/page.h>
+#include <stacsos/kernel/mem/slab-cache.h>
+#include <stacsos/memops.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::mem;
+using namespace stacsos::kernel::host;
+
+/*
+ * Randomised stress test and benchmark for the buddy page allocator and the slab caches, built
+ * for the host.  Every operation is checked against a shadow copy of the allocator state, and
+ * the allocator's own free lists are verified at regular intervals.  Any failure panics, which
+ * exits with a non-zero status.
+ *
+ * Usage: alloc-stress [nr-ops] [seed]
+ */
+
+static const int max_test_order = 12;
+static const int nr_live_slots = 4096;
+static const u64 verify_interval = 65536;
+
+static u64 rng_state;
+
+static u64 next_random()
+{
+	// xorshift64
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+// Orders follow a geometric distribution, so small allocations dominate.
+static int random_order()
+{
+	u64 bits = next_random();
+	int order = bits ? __builtin_ctzll(bits) : max_test_order;
+	return order > max_test_order ? max_test_order : order;
+}
+
+static void report_throughput(const char *allocator, u64 object_size, u64 nr_ops, u64 elapsed_ns)
+{
+	u64 ops_per_sec = elapsed_ns ? (nr_ops * 1000000000ull) / elapsed_ns : 0;
+	printf("alloc-stress: throughput allocator=%s object_size=%lu ops=%lu ns=%lu ops_per_sec=%lu ns_per_op=%lu\n", allocator, object_size, nr_ops,
+		elapsed_ns, ops_per_sec, nr_ops ? elapsed_ns / nr_ops : 0);
+}
+
+/*
+ * Buddy allocator
+ */
+
+enum class shadow_state : u8 { unmanaged, free, allocated };
+
+static shadow_state shadow[sim_nr_pages];
+
+static page *live_blocks[nr_live_slots];
+static int live_orders[nr_live_slots];
+
+// Memory is inserted in several ranges with awkward boundaries, and a hole is then punched in one
+// of them, so that the allocator starts out with a realistic mix of block sizes.
+struct sim_range {
+	u64 start, count;
+};
+
+static const sim_range inserted_ranges[] = {
+	{ 1, 4095 },
+	{ 5003, 20000 },
+	{ 32767, sim_nr_pages - 32767 - 3 },
+};
+
+static const sim_range removed_range = { 9001, 123 };
+
+static void verify_buddy(page_allocator_buddy &pa, u64 expected_free)
+{
+	if (!pa.verify()) {
+		panic("buddy: free list verification failed");
+	}
+
+	if (pa.nr_free_pages() != expected_free) {
+		panic("buddy: allocator reports %lu free pages, shadow has %lu", pa.nr_free_pages(), expected_free);
+	}
+}
+
+static void shadow_allocate(page &pg, int order)
+{
+	u64 pfn = pg.pfn();
+	u64 count = 1ull << order;
+
+	if (pfn & (count - 1)) {
+		panic("buddy: order %d block at pfn=%lx is misaligned", order, pfn);
+	}
+
+	if (pfn + count > sim_nr_pages) {
+		panic("buddy: order %d block at pfn=%lx is outside the page array", order, pfn);
+	}
+
+	for (u64 i = pfn; i < pfn + count; i++) {
+		if (shadow[i] != shadow_state::free) {
+			panic("buddy: order %d block at pfn=%lx overlaps %s page pfn=%lx", order, pfn,
+				shadow[i] == shadow_state::allocated ? "an allocated" : "an unmanaged", i);
+		}
+
+		shadow[i] = shadow_state::allocated;
+	}
+}
+
+static void shadow_free(page &pg, int order)
+{
+	u64 pfn = pg.pfn();
+
+	for (u64 i = pfn; i < pfn + (1ull << order); i++) {
+		shadow[i] = shadow_state::free;
+	}
+}
+
+static void stress_buddy(u64 nr_ops)
+{
+	alignas(64) static u8 dummy_mm[64];
+	page_allocator_buddy pa(*reinterpret_cast<memory_manager *>(dummy_mm));
+
+	u64 nr_free = 0;
+	for (const auto &r : inserted_ranges) {
+		pa.insert_pages(page::get_from_pfn(r.start), r.count);
+
+		for (u64 i = r.start; i < r.start + r.count; i++) {
+			shadow[i] = shadow_state::free;
+		}
+
+		nr_free += r.count;
+	}
+
+	pa.remove_pages(page::get_from_pfn(removed_range.start), removed_range.count);
+	for (u64 i = removed_range.start; i < removed_range.start + removed_range.count; i++) {
+		shadow[i] = shadow_state::unmanaged;
+	}
+
+	nr_free -= removed_range.count;
+	verify_buddy(pa, nr_free);
+
+	u64 initial_free = nr_free;
+	u64 initial_blocks[32];
+	for (int order = 0; order < pa.nr_orders(); order++) {
+		initial_blocks[order] = pa.nr_free_blocks(order);
+	}
+
+	// Phase 1: random allocations and frees, checked against the shadow state.
+	u64 nr_failed = 0;
+	for (u64 op = 0; op < nr_ops; op++) {
+		int slot = next_random() % nr_live_slots;
+
+		if (live_blocks[slot]) {
+			int order = live_orders[slot];
+
+			shadow_free(*live_blocks[slot], order);
+			pa.free_pages(*live_blocks[slot], order);
+			nr_free += 1ull << order;
+
+			live_blocks[slot] = nullptr;
+		} else {
+			int order = random_order();
+
+			page *pg = pa.allocate_pages(order);
+			if (!pg) {
+				if (pa.largest_free_order() >= order) {
+					panic("buddy: order %d allocation failed with an order %d block free", order, pa.largest_free_order());
+				}
+
+				nr_failed++;
+				continue;
+			}
+
+			shadow_allocate(*pg, order);
+			nr_free -= 1ull << order;
+
+			live_blocks[slot] = pg;
+			live_orders[slot] = order;
+		}
+
+		if ((op % verify_interval) == 0) {
+			verify_buddy(pa, nr_free);
+		}
+	}
+
+	for (int i = 0; i < nr_live_slots; i++) {
+		if (live_blocks[i]) {
+			shadow_free(*live_blocks[i], live_orders[i]);
+			pa.free_pages(*live_blocks[i], live_orders[i]);
+			nr_free += 1ull << live_orders[i];
+			live_blocks[i] = nullptr;
+		}
+	}
+
+	verify_buddy(pa, nr_free);
+	printf("alloc-stress: buddy random ops=%lu failed=%lu ok\n", nr_ops, nr_failed);
+
+	// Phase 2: exhaust memory one page at a time, then free everything in a random order.  Once
+	// all pages have been returned, every buddy must have been merged back, leaving exactly the
+	// blocks that were present at the start.
+	static page *all_pages[sim_nr_pages];
+	u64 nr_allocated = 0;
+
+	while (page *pg = pa.allocate_pages(0)) {
+		shadow_allocate(*pg, 0);
+		all_pages[nr_allocated++] = pg;
+	}
+
+	if (nr_allocated != initial_free) {
+		panic("buddy: exhausted after %lu pages, expected %lu", nr_allocated, initial_free);
+	}
+
+	verify_buddy(pa, 0);
+
+	for (u64 i = nr_allocated; i > 1; i--) {
+		u64 j = next_random() % i;
+		page *tmp = all_pages[i - 1];
+		all_pages[i - 1] = all_pages[j];
+		all_pages[j] = tmp;
+	}
+
+	for (u64 i = 0; i < nr_allocated; i++) {
+		shadow_free(*all_pages[i], 0);
+		pa.free_pages(*all_pages[i], 0);
+	}
+
+	verify_buddy(pa, initial_free);
+
+	for (int order = 0; order < pa.nr_orders(); order++) {
+		if (pa.nr_free_blocks(order) != initial_blocks[order]) {
+			panic("buddy: order %d has %lu free blocks after coalescing, expected %lu", order, pa.nr_free_blocks(order), initial_blocks[order]);
+		}
+	}
+
+	printf("alloc-stress: buddy exhaust pages=%lu coalesce ok\n", nr_allocated);
+
+	// Phase 3: the same random pattern with no checking, to measure throughput.
+	u64 start = monotonic_ns();
+
+	for (u64 op = 0; op < nr_ops; op++) {
+		int slot = next_random() % nr_live_slots;
+
+		if (live_blocks[slot]) {
+			pa.free_pages(*live_blocks[slot], live_orders[slot]);
+			live_blocks[slot] = nullptr;
+		} else {
+			int order = random_order();
+			live_blocks[slot] = pa.allocate_pages(order);
+			live_orders[slot] = order;
+		}
+	}
+
+	report_throughput("buddy", PAGE_SIZE, nr_ops, monotonic_ns() - start);
+
+	for (int i = 0; i < nr_live_slots; i++) {
+		if (live_blocks[i]) {
+			pa.free_pages(*live_blocks[i], live_orders[i]);
+			live_blocks[i] = nullptr;
+		}
+	}
+
+	verify_buddy(pa, initial_free);
+}
+
+/*
+ * Slab caches
+ */
+
+// On the host, slabs come straight from the C library rather than from the page allocator.
+template <size_t object_size, int slab_page_order> void *slab_cache<object_size, slab_page_order>::allocate_slab()
+{
+	return aligned_alloc(slab_memory_size, slab_memory_size);
+}
+
+// The slab caches search their slab lists linearly, so a smaller working set keeps the run short.
+static const int nr_live_objects = 1024;
+
+static void *live_objects[nr_live_objects];
+
+// Each live object is filled with a pattern derived from its own address, so that an object
+// handed out twice, or overlapping another, is detected when it is freed.
+static u64 object_tag(void *ptr) { return (u64)ptr * 0x9e3779b97f4a7c15ull; }
+
+template <size_t object_size> static void fill_object(void *ptr)
+{
+	u64 *words = (u64 *)ptr;
+	for (size_t i = 0; i < object_size / sizeof(u64); i++) {
+		words[i] = object_tag(ptr) + i;
+	}
+}
+
+template <size_t object_size> static void check_object(void *ptr)
+{
+	u64 *words = (u64 *)ptr;
+	for (size_t i = 0; i < object_size / sizeof(u64); i++) {
+		if (words[i] != object_tag(ptr) + i) {
+			panic("slab-%lu: object %p was corrupted at word %lu", object_size, ptr, i);
+		}
+	}
+}
+
+template <size_t object_size> static void stress_slab(u64 nr_ops)
+{
+	slab_cache<object_size, 0> cache;
+	u64 nr_live = 0;
+
+	for (u64 op = 0; op < nr_ops; op++) {
+		int slot = next_random() % nr_live_objects;
+
+		if (live_objects[slot]) {
+			check_object<object_size>(live_objects[slot]);
+			cache.free(live_objects[slot]);
+
+			live_objects[slot] = nullptr;
+			nr_live--;
+		} else {
+			void *ptr = cache.allocate();
+
+			u64 offset = (uintptr_t)ptr & (PAGE_SIZE - 1);
+			if (offset == 0 || (offset % object_size) != 0) {
+				panic("slab-%lu: object %p is not on an object boundary", object_size, ptr);
+			}
+
+			fill_object<object_size>(ptr);
+
+			live_objects[slot] = ptr;
+			nr_live++;
+		}
+
+		if ((op % verify_interval) == 0) {
+			auto stats = cache.stats();
+			if (stats.nr_objects != nr_live || stats.nr_objects > stats.capacity) {
+				panic("slab-%lu: stats report %lu objects (capacity %lu), expected %lu", object_size, stats.nr_objects, stats.capacity, nr_live);
+			}
+		}
+	}
+
+	int not_in_cache;
+	if (cache.try_free(&not_in_cache)) {
+		panic("slab-%lu: freed an object that does not belong to the cache", object_size);
+	}
+
+	for (int i = 0; i < nr_live_objects; i++) {
+		if (live_objects[i]) {
+			check_object<object_size>(live_objects[i]);
+			cache.free(live_objects[i]);
+			live_objects[i] = nullptr;
+		}
+	}
+
+	if (cache.stats().nr_objects != 0) {
+		panic("slab-%lu: %lu objects remain after freeing everything", object_size, cache.stats().nr_objects);
+	}
+
+	printf("alloc-stress: slab-%lu random ops=%lu slabs=%lu ok\n", object_size, nr_ops, cache.stats().nr_slabs);
+
+	// The warm cache now has enough slabs for the working set, so the timed run measures the
+	// allocator itself rather than the C library.
+	u64 start = monotonic_ns();
+
+	for (u64 op = 0; op < nr_ops; op++) {
+		int slot = next_random() % nr_live_objects;
+
+		if (live_objects[slot]) {
+			cache.free(live_objects[slot]);
+			live_objects[slot] = nullptr;
+		} else {
+			live_objects[slot] = cache.allocate();
+		}
+	}
+
+	report_throughput("slab", object_size, nr_ops, monotonic_ns() - start);
+
+	for (int i = 0; i < nr_live_objects; i++) {
+		if (live_objects[i]) {
+			cache.free(live_objects[i]);
+			live_objects[i] = nullptr;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	u64 nr_ops = argc > 1 ? strtoull(argv[1], nullptr, 0) : 1000000;
+	u64 seed = argc > 2 ? strtoull(argv[2], nullptr, 0) : 1;
+
+	rng_state = seed ? seed : 1;
+
+	printf("alloc-stress: start ops=%lu seed=%lu pages=%lu\n", nr_ops, seed, sim_nr_pages);
+
+	stress_buddy(nr_ops);
+
+	stress_slab<16>(nr_ops);
+	stress_slab<32>(nr_ops);
+	stress_slab<64>(nr_ops);
+	stress_slab<128>(nr_ops);
+	stress_slab<256>(nr_ops);
+	stress_slab<512>(nr_ops);
+	stress_slab<1024>(nr_ops);
+
+	printf("alloc-stress: end\n");
+	return 0;
+}
@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <host-support.h>
+#include <stacsos/kernel/debug.h>
+#include <stacsos/kernel/lock.h>
+
+// Stand-ins for the kernel services used by the allocators.
+
+static const int CLOCK_MONOTONIC = 1;
+
+void panic(const char *fmt, ...)
+{
+	va_list args;
+
+	printf("PANIC: ");
+
+	va_start(args, fmt);
+	vprintf(fmt, args);
+	va_end(args);
+
+	printf("\n");
+	exit(1);
+}
+
+void stacsos::kernel::dprintf(const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	vprintf(fmt, args);
+	va_end(args);
+}
+
+u64 stacsos::kernel::host::monotonic_ns()
+{
+	host_timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+// The harness is single threaded, and cannot disable interrupts, so locks do nothing.
+
+extern "C" void spinlock_acquire(spinlock_var_t *lv) { }
+extern "C" void spinlock_release(spinlock_var_t *lv) { }
+extern "C" void spinlock_irq_acquire(spinlock_var_t *lv, u64 *flags) { *flags = 0; }
+extern "C" void spinlock_irq_release(spinlock_var_t *lv, u64 flags) { }
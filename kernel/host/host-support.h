@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+/*
+ * The host build uses the kernel's own global definitions, so the C library headers cannot be
+ * included.  The handful of library functions the harness needs are declared here instead.
+ */
+struct host_timespec {
+	long tv_sec;
+	long tv_nsec;
+};
+
+extern "C" {
+int printf(const char *fmt, ...);
+int vprintf(const char *fmt, va_list args);
+void exit(int status) __noreturn;
+void *aligned_alloc(size_t alignment, size_t size);
+void free(void *ptr);
+unsigned long long strtoull(const char *str, char **end, int base);
+int clock_gettime(int clock, host_timespec *ts);
+}
+
+namespace stacsos::kernel::host {
+// The number of pages described by the simulated page array.
+static const u64 sim_nr_pages = 1ull << 16;
+
+// An upper bound on sizeof(page), used to size the simulated page array without including page.h.
+static const u64 sim_page_descriptor_size = 64;
+
+extern u64 monotonic_ns();
+} // namespace stacsos::kernel::host
@@ -0,0 +1,190 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <host-support.h>
+#include <stacsos/kernel/sched/alg/cfs.h>
+#include <stacsos/kernel/sched/alg/rr.h>
+#include <stacsos/kernel/sched/alg/sfs.h>
+#include <stacsos/kernel/sched/schedulable-entity.h>
+#include <stacsos/memops.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::sched;
+using namespace stacsos::kernel::sched::alg;
+
+/*
+ * Benchmark for the fair scheduling algorithms' run queues, built for the host.  Each run fills a
+ * run queue with tasks, then repeatedly selects the next task and charges it for a slice of run
+ * time, as core::schedule() does.  Every few selections a queued task is removed and added back,
+ * standing in for a block and a wakeup.  The mean cost of each, in TSC cycles, is reported.
+ *
+ * A second benchmark moves a task from a busy fair queue to one whose tasks have run for far less,
+ * as the load balancer does, and counts the selections it waits for on the new queue.  With its
+ * virtual run time rebased, it should wait for no more than a round of the new queue's tasks.
+ *
+ * Usage: sched-bench [nr-selections] [seed]
+ */
+
+// Run queues that allocate do so through the global operator new, so on the host that is the
+// C library's allocator.
+void *operator new(size_t size) { return aligned_alloc(16, (size + 15) & ~15ull); }
+void *operator new[](size_t size) { return aligned_alloc(16, (size + 15) & ~15ull); }
+void operator delete(void *p) { free(p); }
+void operator delete[](void *p) { free(p); }
+void operator delete(void *p, size_t) { free(p); }
+void operator delete[](void *p, size_t) { free(p); }
+
+static const unsigned int queue_lengths[] = { 2, 8, 32, 128, 512 };
+static const unsigned int requeue_interval = 4;
+
+static u64 rng_state;
+
+static u64 next_random()
+{
+	// xorshift64
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+static void bench(scheduling_algorithm &alg, const char *name, unsigned int nr_tasks, u64 nr_selections)
+{
+	tcb *tasks = (tcb *)aligned_alloc(64, sizeof(tcb) * nr_tasks);
+	memops::bzero(tasks, sizeof(tcb) * nr_tasks);
+
+	for (unsigned int i = 0; i < nr_tasks; i++) {
+		alg.add_to_runqueue(tasks[i]);
+	}
+
+	u64 select_cycles = 0, requeue_cycles = 0, nr_requeues = 0;
+	tcb *current = nullptr;
+
+	for (u64 i = 0; i < nr_selections; i++) {
+		u64 start = __builtin_ia32_rdtsc();
+		tcb *next = alg.select_next_task(current);
+		select_cycles += __builtin_ia32_rdtsc() - start;
+
+		if (!next) {
+			panic("sched-bench: %s selected nothing from %u tasks", name, nr_tasks);
+		}
+
+		// Charge the task for a slice of somewhere between one and two thousand cycles.
+		next->run_time += 1000 + (next_random() % 1000);
+		current = next;
+
+		if (i % requeue_interval == 0) {
+			tcb &t = tasks[next_random() % nr_tasks];
+			if (&t == current) {
+				continue;
+			}
+
+			start = __builtin_ia32_rdtsc();
+			alg.remove_from_runqueue(t);
+			alg.add_to_runqueue(t);
+			requeue_cycles += __builtin_ia32_rdtsc() - start;
+			nr_requeues++;
+		}
+	}
+
+	printf("sched-bench: alg=%s tasks=%u select_cycles=%lu requeue_cycles=%lu\n", name, nr_tasks, select_cycles / nr_selections,
+		nr_requeues ? requeue_cycles / nr_requeues : 0);
+
+	for (unsigned int i = 0; i < nr_tasks; i++) {
+		alg.remove_from_runqueue(tasks[i]);
+	}
+
+	free(tasks);
+}
+
+// Queues NR_TASKS tasks on ALG, and runs them for NR_SELECTIONS slices of a thousand cycles.
+static void fill(scheduling_algorithm &alg, tcb *tasks, unsigned int nr_tasks, u64 nr_selections)
+{
+	for (unsigned int i = 0; i < nr_tasks; i++) {
+		alg.add_to_runqueue(tasks[i]);
+	}
+
+	tcb *current = nullptr;
+	for (u64 i = 0; i < nr_selections; i++) {
+		current = alg.select_next_task(current);
+		current->run_time += 1000;
+	}
+}
+
+static const unsigned int migrate_queue_length = 8;
+static const u64 migrate_wait_limit = 10000000;
+
+/*
+ * Moves a task from a queue that has run for a long time to one that has hardly run at all, either
+ * as a plain remove and add (REBASE false), or through migrate_out() and migrate_in(), and reports
+ * how many selections pass on the new queue before the task is picked.
+ */
+static void bench_migration(bool rebase, u64 nr_selections)
+{
+	tcb *tasks = (tcb *)aligned_alloc(64, sizeof(tcb) * migrate_queue_length * 2);
+	memops::bzero(tasks, sizeof(tcb) * migrate_queue_length * 2);
+
+	completely_fair_scheduler busy, quiet;
+	fill(busy, &tasks[0], migrate_queue_length, nr_selections);
+	fill(quiet, &tasks[migrate_queue_length], migrate_queue_length, nr_selections / 1000);
+
+	// Every task on the busy queue has run for about as long as the others, so any will do.
+	tcb &migrant = tasks[0];
+	busy.remove_from_runqueue(migrant);
+	if (rebase) {
+		busy.migrate_out(migrant);
+		quiet.migrate_in(migrant);
+	}
+	quiet.add_to_runqueue(migrant);
+
+	tcb *current = nullptr;
+	u64 waited = 0;
+	while (waited < migrate_wait_limit) {
+		current = quiet.select_next_task(current);
+		if (current == &migrant) {
+			break;
+		}
+
+		current->run_time += 1000;
+		waited++;
+	}
+
+	printf("sched-bench: alg=cfs migrate rebase=%s waited=%lu%s\n", rebase ? "yes" : "no", waited, waited == migrate_wait_limit ? "+" : "");
+
+	for (unsigned int i = 0; i < migrate_queue_length; i++) {
+		busy.remove_from_runqueue(tasks[i]);
+		quiet.remove_from_runqueue(tasks[migrate_queue_length + i]);
+	}
+
+	free(tasks);
+}
+
+int main(int argc, char **argv)
+{
+	u64 nr_selections = argc > 1 ? strtoull(argv[1], nullptr, 0) : 1000000;
+	u64 seed = argc > 2 ? strtoull(argv[2], nullptr, 0) : 1;
+
+	for (unsigned int nr_tasks : queue_lengths) {
+		rng_state = seed;
+		simple_fair_scheduler sfs;
+		bench(sfs, "sfs", nr_tasks, nr_selections);
+
+		rng_state = seed;
+		round_robin rr;
+		bench(rr, "rr", nr_tasks, nr_selections);
+
+		rng_state = seed;
+		completely_fair_scheduler cfs;
+		bench(cfs, "cfs", nr_tasks, nr_selections);
+	}
+
+	bench_migration(false, nr_selections);
+	bench_migration(true, nr_selections);
+
+	return 0;
+}
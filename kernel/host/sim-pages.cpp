@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <host-support.h>
+
+using namespace stacsos::kernel::host;
+
+/*
+ * In the kernel, the page array is placed by the linker script at _DYNAMIC_DATA_START.  On the
+ * host it is simply a large zeroed array.  This file must not include page.h, whose declaration
+ * of the symbol has a different type.
+ */
+extern "C" {
+__aligned(64) u8 _DYNAMIC_DATA_START[sim_nr_pages * sim_page_descriptor_size];
+}
@@ -7,14 +7,22 @@
  */
 #pragma once
 
+#include <stacsos/kernel/arch/ipi.h>
 #include <stacsos/kernel/arch/irq-manager.h>
 #include <stacsos/kernel/arch/x86/msr.h>
 #include <stacsos/kernel/config.h>
 #include <stacsos/kernel/debug.h>
+#include <stacsos/kernel/arch/per-cpu.h>
+#include <stacsos/kernel/lock.h>
+#include <stacsos/kernel/sched/alg/cfs.h>
+#include <stacsos/kernel/sched/alg/deadline.h>
 #include <stacsos/kernel/sched/alg/rr.h>
+#include <stacsos/kernel/sched/alg/rt.h>
 #include <stacsos/kernel/sched/alg/scheduling-algorithm.h>
 #include <stacsos/kernel/sched/alg/sfs.h>
+#include <stacsos/kernel/sched/cpu-quota.h>
 #include <stacsos/kernel/sched/schedulable-entity.h>
+#include <stacsos/kernel/sched/timer-wheel.h>
 #include <stacsos/list.h>
 
 namespace stacsos::kernel::arch {
@@ -25,22 +33,41 @@ class core_manager;
 
 enum class core_status { offline, online, error, bootstrap };
 
+// The outcome of changing a task's scheduling parameters on a core.
+enum class sched_change_result { ok, not_owner, rejected };
+
 class core {
 	friend class core_manager;
 
 public:
-	static int this_core_id() { return (int)x86::msrs::ia32_tsc_aux; }
-
-	static core &this_core();
+	static core &this_core() { return *this_cpu(cpu_data).this_core; }
+	static int this_core_id() { return this_core().id(); }
 
 	explicit core(int id)
 		: id_(id)
 		, status_(core_status::offline)
+		, per_cpu_offset_(allocate_per_cpu_area(*this))
 		, irqs_(*this)
 		, sched_alg_(nullptr)
+		, current_(nullptr)
+		, previous_(nullptr)
+		, balance_timer_(balance_timer_expired, this)
+		, ticks_(0)
+		, next_tick_(0)
+		, tick_stopped_(false)
+		, slice_end_(0)
+		, resched_at_(0)
+		, nr_steals_(0)
+		, nr_migrations_(0)
+		, schedule_calls_(0)
+		, schedule_cycles_total_(0)
+		, schedule_cycles_max_(0)
+		, nr_yields_(0)
+		, nr_rt_preemptions_(0)
+		, run_start_(0)
 	{
-		idle_thread_.entity = nullptr;
-		idle_thread_.mcontext = nullptr;
+		memops::bzero(&idle_thread_, sizeof(idle_thread_));
+		idle_thread_.policy = sched_policy::normal;
 
 		//*new alg::simple_fair_scheduler()
 
@@ -51,6 +78,8 @@ public:
 
 		if (memops::strcmp(sched_alg_name, "sfs") == 0) {
 			sched_alg_ = new alg::simple_fair_scheduler();
+		} else if (memops::strcmp(sched_alg_name, "cfs") == 0) {
+			sched_alg_ = new alg::completely_fair_scheduler();
 		} else if (memops::strcmp(sched_alg_name, "rr") == 0) {
 			sched_alg_ = new alg::round_robin();
 		} else {
@@ -58,8 +87,53 @@ public:
 		}
 
 		dprintf("core: using scheduling algorithm: %s\n", sched_alg_->name());
+
+		balance_interval_ = config::get().get_option_u64_or_default("sched-balance-interval", default_balance_interval);
+		migration_cost_us_ = config::get().get_option_u64_or_default("sched-migration-cost", default_migration_cost_us);
+
+		const char *tick_mode = config::get().get_option("tick");
+		if (!tick_mode || *tick_mode == 0 || memops::strcmp(tick_mode, "periodic") == 0) {
+			dynamic_tick_ = false;
+		} else if (memops::strcmp(tick_mode, "dynamic") == 0) {
+			dynamic_tick_ = true;
+		} else {
+			panic("Unsupported tick mode '%s'", tick_mode);
+		}
+
+		// yield=trap keeps the old way of yielding, through a software interrupt, so that the two
+		// can be compared.
+		const char *yield_mode = config::get().get_option("yield");
+		if (!yield_mode || *yield_mode == 0 || memops::strcmp(yield_mode, "direct") == 0) {
+			trap_yield_ = false;
+		} else if (memops::strcmp(yield_mode, "trap") == 0) {
+			trap_yield_ = true;
+		} else {
+			panic("Unsupported yield mode '%s'", yield_mode);
+		}
+
+		timeslice_us_ = config::get().get_option_u64_or_default("sched-timeslice", default_timeslice_us);
+
+		u64 dl_max_util = config::get().get_option_u64_or_default("sched-dl-max-util", default_dl_max_util);
+		dl_bandwidth_limit_ = (dl_max_util << alg::deadline_scheduler::bw_shift) / 100;
 	}
 
+	// Periodic load balancing runs every this many periodic tick intervals.
+	static const u64 default_balance_interval = 10;
+
+	// A task that stopped running less recently than this is assumed to still have a warm cache on
+	// its core, and is not migrated.
+	static const u64 default_migration_cost_us = 500;
+
+	// The rate of the timer tick with tick=periodic.
+	static const u64 periodic_tick_frequency = 100;
+
+	// With tick=dynamic, a task runs for this long before another runnable task gets the core.
+	static const u64 default_timeslice_us = 10000;
+
+	// Deadline tasks may reserve at most this percentage of a core between them, which leaves some
+	// time for everything else.
+	static const u64 default_dl_max_util = 95;
+
 	int id() const { return id_; }
 
 	virtual void init() = 0;
@@ -69,27 +143,188 @@ public:
 
 	virtual timer &local_timer() = 0;
 
-	void add_to_runqueue(tcb &tcb) { sched_alg_->add_to_runqueue(tcb); }
-	void remove_from_runqueue(tcb &tcb) { sched_alg_->remove_from_runqueue(tcb); }
+	// Waits in a low-power state until an interrupt arrives, or this core is asked to reschedule.
+	// Called by the idle task, with interrupts enabled.
+	virtual void idle_wait() = 0;
+
+	// The run queue is shared with other cores, which place threads here, so it is always accessed
+	// under the run queue lock.  A task may be migrated to another core while the caller waits for
+	// the lock, so these fail, and should be retried on the new owner, if this core no longer owns it.
+	bool add_to_runqueue(tcb &tcb);
+	bool remove_from_runqueue(tcb &tcb);
+
+	// Moves TCB, which is on no run queue, from this core to TARGET.  Does nothing if this core no
+	// longer owns it.
+	void hand_over(tcb &tcb, core &target);
+
+	// Makes the tasks parked here under quota Q runnable again, unless Q is still throttled.
+	void unpark(const cpu_quota &q);
+
+	// Changes TCB's affinity to MASK, and moves it off this core if MASK does not allow it to run
+	// here.  A running task is moved once it stops running.  A deadline task's bandwidth is reserved
+	// here, so a mask that excludes this core is rejected.
+	sched_change_result change_affinity(tcb &tcb, u64 mask);
+
+	// Changes the scheduling parameters of TCB, moving it between scheduling classes if need be.
+	// Fails like add_to_runqueue() if this core no longer owns it, and is rejected if TCB would
+	// reserve more deadline bandwidth than this core has left, or may not run here.
+	sched_change_result change_sched_params(tcb &tcb, const sched_params &params);
+
+	unsigned int nr_runnable() const { return dl_sched_.nr_runnable() + rt_sched_.nr_runnable() + sched_alg_->nr_runnable(); }
+	unsigned int nr_rt_runnable() const { return rt_sched_.nr_runnable(); }
+	unsigned int nr_dl_runnable() const { return dl_sched_.nr_runnable(); }
+	unsigned int nr_dl_throttled() const { return dl_sched_.nr_throttled(); }
+	unsigned int nr_parked() const { return parked_.count(); }
+
+	// The deadline bandwidth reserved on this core, and the most that may be, as fractions of the
+	// core in fixed point (see deadline_scheduler::bw_shift).
+	u64 dl_bandwidth() const { return dl_sched_.bandwidth(); }
+	u64 dl_bandwidth_limit() const { return dl_bandwidth_limit_; }
+
+	// Picks the next task to run on this core.  VOLUNTARY is true when the current task is giving up
+	// the core itself, rather than being preempted.
+	void schedule(bool voluntary = false);
+
+	// Gives up the core from kernel code, and returns once the calling task is next scheduled.  This
+	// switches directly to the next task, rather than taking an interrupt to do so, unless booted
+	// with yield=trap.
+	static void yield();
+
+	// Called from the local timer interrupt: runs expired software timers, then reschedules.
+	void tick();
+
+	// Software timers that expire on this core.
+	timer_wheel &timers() { return timers_; }
+
+	// Makes this core call schedule() as soon as possible.  May be called from any core.
+	virtual void send_reschedule() = 0;
 
-	void schedule();
+	// Sends an inter-processor interrupt of the given type to this core.
+	virtual void send_ipi(ipi_type type) = 0;
 
-	virtual void set_current_tcb(const tcb *tcb) = 0;
-	virtual tcb *get_current_tcb() = 0;
+	// A core is idle if it is running its idle task and has nothing queued.
+	bool idle() const { return current_ == &idle_thread_ && nr_runnable() == 0; }
+
+	// Returns true if TCB is running on this core, or its kernel stack may still be in use here.
+	bool task_in_use(const tcb &tcb);
+
+	// True if this core has stopped its timer tick, because it has at most one thing to run.
+	bool tick_stopped() const { return tick_stopped_; }
+	u64 nr_ticks() const { return ticks_; }
+
+	u64 nr_steals() const { return nr_steals_; }
+	u64 nr_migrations() const { return nr_migrations_; }
+
+	// The cost of picking and switching to the next task, in timestamp counter cycles, measured
+	// inside the run queue lock on every call to schedule().
+	u64 nr_schedule_calls() const { return schedule_calls_; }
+	u64 schedule_cycles_total() const { return schedule_cycles_total_; }
+	u64 schedule_cycles_max() const { return schedule_cycles_max_; }
+
+	u64 nr_yields() const { return nr_yields_; }
+
+	// The number of times a deadline or real-time task woke up and preempted the task running here.
+	u64 nr_rt_preemptions() const { return nr_rt_preemptions_; }
+
+	// The time this core has spent running its idle task, and running at all, in timestamp counter
+	// cycles.
+	u64 idle_cycles();
+	u64 online_cycles() const { return __builtin_ia32_rdtsc() - run_start_; }
+
+	virtual void set_current_tcb(tcb *tcb) = 0;
+	tcb *get_current_tcb() { return this_cpu(cpu_data).current; }
+
+	// The offset of this core's copy of the per-CPU section.
+	u64 per_cpu_offset() const { return per_cpu_offset_; }
+
+	// Returns this core's copy of the per-CPU variable VAR.
+	template <typename T> T &per_cpu(T &var) const { return *(T *)((uintptr_t)&var + per_cpu_offset_); }
+
+	// Makes this core's per-CPU area the one the executing processor uses.  Must be called on this
+	// core, before anything calls this_core().
+	virtual void load_per_cpu() = 0;
 
 	core_status status() const { return status_; }
+	bool online() const { return status_ == core_status::online || status_ == core_status::bootstrap; }
 
 	irq_manager &irqs() { return irqs_; }
 	const irq_manager &irqs() const { return irqs_; }
 
 	void update_accounting();
 
+	// The frequency of the timestamp counter used for run time accounting.
+	virtual u64 timestamp_frequency() = 0;
+
 private:
 	int id_;
 	core_status status_;
+	u64 per_cpu_offset_;
 	irq_manager irqs_;
 
 	tcb idle_thread_;
+
+	// Deadline tasks always run before real-time tasks, which always run before those of the
+	// selected (fair) algorithm.
+	alg::deadline_scheduler dl_sched_;
+	alg::realtime_scheduler rt_sched_;
 	alg::scheduling_algorithm *sched_alg_;
+	spinlock_irq runqueue_lock_;
+
+	// Tasks owned by this core that its affinity no longer allows, which are moved to another core
+	// the next time this core schedules.
+	intrusive_list evicted_;
+
+	// Tasks owned by this core whose process has used up its CPU quota for this period.
+	intrusive_list parked_;
+
+	// The task running on this core, and the one that ran before it.  Neither can be migrated:
+	// the previous task's kernel stack may still be in use until this core next schedules.
+	tcb *current_, *previous_;
+
+	timer_wheel timers_;
+	soft_timer balance_timer_;
+
+	u64 ticks_;
+	bool dynamic_tick_;
+	u64 next_tick_;
+	bool tick_stopped_;
+	u64 slice_end_; // With tick=dynamic, when the running task's timeslice ends
+	u64 resched_at_; // A tick at or after this time reschedules, or zero if none is due
+	u64 timeslice_us_;
+	bool trap_yield_;
+	u64 dl_bandwidth_limit_;
+	u64 balance_interval_;
+	u64 migration_cost_us_;
+
+	u64 nr_steals_;
+	u64 nr_migrations_;
+
+	u64 schedule_calls_;
+	u64 schedule_cycles_total_;
+	u64 schedule_cycles_max_;
+	u64 nr_yields_;
+	u64 nr_rt_preemptions_;
+	u64 run_start_;
+
+	alg::scheduling_algorithm &class_of(const tcb &tcb)
+	{
+		if (is_deadline(tcb)) {
+			return dl_sched_;
+		}
+
+		return is_realtime(tcb) ? (alg::scheduling_algorithm &)rt_sched_ : *sched_alg_;
+	}
+
+	bool preempts_current(const tcb &tcb) const;
+	bool enqueue(tcb &tcb);
+	void migrate(tcb &tcb, core &target);
+	void push_evicted();
+
+	void program_tick(u64 now);
+	u64 balance_period();
+	static void balance_timer_expired(void *arg);
+	void balance_load();
+	core *find_busiest_core();
+	bool pull_task_from(core &victim, bool idle);
 };
 } // namespace stacsos::kernel::arch
@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/arch/per-cpu.h>
+#include <stacsos/kernel/lock.h>
+
+namespace stacsos::kernel::arch {
+class core;
+
+// Each kind of inter-processor interrupt has its own vector.
+enum class ipi_type { reschedule, call_function, tlb_shootdown };
+static const int nr_ipi_types = 3;
+
+typedef void (*remote_call_fn)(void *arg);
+
+// A request for another core to call a function.  Requests are queued on the target core.
+struct remote_call {
+	remote_call *next;
+	remote_call_fn fn;
+	void *arg;
+	u64 sent_at;
+	volatile bool done;
+
+	// Set for asynchronous calls, whose requests are freed by the target once called.
+	bool owned_by_target;
+};
+
+// Per-core IPI statistics.  Latency is measured from queueing a request to handling it.
+struct ipi_stats {
+	u64 sent[nr_ipi_types];
+	u64 received[nr_ipi_types];
+
+	u64 latency_samples;
+	u64 latency_total;
+	u64 latency_max;
+
+	u64 calls;
+	u64 shootdowns;
+	u64 pages_flushed;
+	u64 full_flushes;
+};
+
+DECLARE_PER_CPU(ipi_stats, ipi_statistics);
+
+/*
+ * Remote function calls and TLB shootdowns.  Every core has a lock-free queue of remote calls, and a
+ * pending TLB invalidation range that concurrent shootdowns are merged into.  An IPI is only sent
+ * when a queue goes from empty to non-empty, so a burst of requests to one core costs one interrupt.
+ *
+ * A core waiting for another to act on its request handles its own queues while it waits, so two
+ * cores that wait on each other (even with interrupts disabled) do not deadlock.
+ */
+class ipi_manager {
+	DEFINE_SINGLETON(ipi_manager)
+
+public:
+	// Invalidations of more than this many pages flush the whole TLB instead.
+	static const u64 max_flush_pages = 32;
+
+	// Calls FN(ARG) on TARGET.  With WAIT, returns once the call has finished; otherwise, returns
+	// once the call has been queued.  A call to the executing core is made straight away.
+	void call(core &target, remote_call_fn fn, void *arg, bool wait);
+
+	// Calls FN(ARG) on every other online core.
+	void call_others(remote_call_fn fn, void *arg, bool wait);
+
+	/*
+	 * Invalidates the translations for [START, END) in the address space whose root is CR3, on
+	 * every core that may have them cached, including this one, and returns once they all have.
+	 * Kernel addresses are invalidated on every core.
+	 */
+	void flush_tlb(u64 cr3, u64 start, u64 end);
+
+	// Called on a core when it receives the corresponding IPI, with interrupts disabled.
+	void handle_calls();
+	void handle_tlb_shootdown();
+
+private:
+	ipi_manager() { }
+
+	bool queue_call(core &target, remote_call *c);
+	void poll();
+};
+
+/*
+ * Collects TLB invalidations, so that a run of page table changes costs one shootdown.  Pages are
+ * coalesced into a single range, which is flushed when the batch is destroyed, when flush() is
+ * called, or when a page from a different address space is added.
+ */
+class tlb_batch {
+public:
+	tlb_batch()
+		: cr3_(0)
+		, start_(0)
+		, end_(0)
+	{
+	}
+
+	~tlb_batch() { flush(); }
+
+	DELETE_DEFAULT_COPY_AND_MOVE(tlb_batch)
+
+	void add(u64 cr3, u64 virtual_address);
+	void flush();
+
+	// Returns true if adding a page in the address space with the given CR3 would flush the batch.
+	bool flushes_on_add(u64 cr3) const { return start_ < end_ && cr3 != cr3_; }
+
+private:
+	u64 cr3_;
+	u64 start_, end_;
+};
+} // namespace stacsos::kernel::arch
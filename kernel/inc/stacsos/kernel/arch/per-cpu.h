@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/sched/schedulable-entity.h>
+
+/*
+ * Per-CPU variables.  DEFINE_PER_CPU places a variable in the .percpu section, which is only a
+ * template: every core gets its own copy of the section when it is created, and finds its copy
+ * through the per-CPU offset stored in the current TCB.  GS points at the current TCB whenever the
+ * kernel is running, so this is a GS-relative load, rather than a (serialising) read of a
+ * model-specific register.
+ *
+ * A thread may be migrated between finding a per-CPU variable and using it, so this_cpu() must be
+ * used with interrupts disabled, unless any core's copy will do (e.g. to count events).
+ */
+#define DEFINE_PER_CPU(type, name) __attribute__((section(".percpu"))) type name
+#define DECLARE_PER_CPU(type, name) extern __attribute__((section(".percpu"))) type name
+
+namespace stacsos::kernel::arch {
+class core;
+
+// The per-CPU data that the core itself needs, kept together on one cache line.
+struct per_cpu_data {
+	core *this_core;
+	sched::tcb *current;
+	u64 active_cr3;
+	bool need_resched;
+
+	// Set while the idle task is waiting in MWAIT on need_resched, so that a store to it is enough
+	// to wake this core.
+	bool idle_polling;
+
+	u64 nr_irqs;
+	u64 nr_syscalls;
+	u64 nr_idle_entries;
+	u64 nr_resched_ipis;
+	u64 nr_poll_wakeups;
+} __aligned(64);
+
+DECLARE_PER_CPU(per_cpu_data, cpu_data);
+
+// Creates a copy of the per-CPU section for core C, and returns its offset from the template.
+u64 allocate_per_cpu_area(core &c);
+
+static inline u64 this_cpu_offset()
+{
+	u64 offset;
+	asm volatile("mov %%gs:%c1, %0" : "=r"(offset) : "i"(__builtin_offsetof(sched::tcb, per_cpu_offset)));
+	return offset;
+}
+
+// Returns this core's copy of the per-CPU variable VAR.
+template <typename T> static inline T &this_cpu(T &var) { return *(T *)((uintptr_t)&var + this_cpu_offset()); }
+
+// Disables interrupts, and returns the flags to give irq_restore() to put them back as they were.
+static inline u64 irq_save()
+{
+	u64 flags;
+	asm volatile("pushfq; pop %0; cli" : "=r"(flags)::"memory");
+	return flags;
+}
+
+static inline void irq_restore(u64 flags) { asm volatile("push %0; popfq" ::"r"(flags) : "memory", "cc"); }
+} // namespace stacsos::kernel::arch
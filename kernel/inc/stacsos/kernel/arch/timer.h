@@ -30,6 +30,12 @@ public:
 	virtual void start(u64 period) = 0;
 	virtual void stop() = 0;
 
+	// Arms the timer to fire once, after the given number of nanoseconds.
+	virtual void start_one_shot(u64 nanoseconds) = 0;
+
+	// Arms the timer to fire once, when the timestamp counter reaches TIMESTAMP.
+	virtual void start_deadline(u64 timestamp) = 0;
+
 private:
 	timer_callback cb_;
 	void *cb_arg_;
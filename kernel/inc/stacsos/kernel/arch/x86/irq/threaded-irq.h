@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/sched/workqueue.h>
+
+namespace stacsos::kernel::arch::x86 {
+class x86_core;
+}
+
+namespace stacsos::kernel::arch::x86::irq {
+// Runs in the interrupt handler, with interrupts disabled.  It should only do what the device needs
+// to be acknowledged, and return true if the threaded handler has work to do.
+using irq_top_half_fn = bool (*)(void *arg);
+
+// Runs on the worker thread of the core that took the interrupt, with interrupts enabled.
+using irq_thread_fn = void (*)(void *arg);
+
+/*
+ * An interrupt handler split in two: a minimal top half that runs in the interrupt handler, and a
+ * threaded handler that does the rest of the work on the core's workqueue.  Interrupts that arrive
+ * before the threaded handler starts are handled by one call, so the top half must leave enough
+ * state behind (e.g. in a ring buffer) for the threaded handler to catch up.
+ */
+class threaded_irq {
+public:
+	threaded_irq(irq_top_half_fn top_half, irq_thread_fn thread_fn, void *arg)
+		: top_half_(top_half)
+		, thread_fn_(thread_fn)
+		, arg_(arg)
+		, work_(thread_fn_trampoline, this)
+		, nr_interrupts_(0)
+		, nr_threaded_runs_(0)
+	{
+	}
+
+	DELETE_DEFAULT_COPY_AND_MOVE(threaded_irq)
+
+	// Routes physical interrupt PHYS_IRQ_NR to a newly allocated vector on TARGET.
+	void attach(u32 phys_irq_nr, x86_core &target);
+
+	u64 nr_interrupts() const { return nr_interrupts_; }
+	u64 nr_threaded_runs() const { return nr_threaded_runs_; }
+
+private:
+	irq_top_half_fn top_half_;
+	irq_thread_fn thread_fn_;
+	void *arg_;
+	sched::work_item work_;
+
+	u64 nr_interrupts_;
+	u64 nr_threaded_runs_;
+
+	static void handle_irq(u8 irq, void *mcontext, void *arg);
+	static void thread_fn_trampoline(void *arg);
+};
+} // namespace stacsos::kernel::arch::x86::irq
@@ -23,6 +23,7 @@ enum class msr_indicies : unsigned {
 
 	IA32_APIC_BASE = 0x1b,
 	IA32_FEATURE_CONTROL = 0x3a,
+	IA32_TSC_DEADLINE = 0x6e0,
 	IA32_LOCAL_APIC_ID = 0x802,
 
 	// VMX Controls
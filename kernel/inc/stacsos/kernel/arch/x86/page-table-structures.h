@@ -25,12 +25,18 @@ struct base_entry {
 	bool pwt() const { return get_bit(3); }
 	bool pcd() const { return get_bit(4); }
 	bool a() const { return get_bit(5); }
+	void a(bool v) { update_bit(5, v); }
 
 	bool size() const { return get_bit(7); }
 	void size(bool v) { update_bit(7, v); }
 
 	bool xd() const { return get_bit(63); }
 
+	// Bit 9 is available to software.  A non-present entry with this bit set describes a page that
+	// has been written out to swap, and the base address field holds the swap slot number.
+	bool swapped() const { return get_bit(9); }
+	void swapped(bool v) { update_bit(9, v); }
+
 	u64 base_address() const { return (bits & base_address_mask); }
 
 	void base_address(u64 addr) { bits = (bits & ~base_address_mask) | (addr & base_address_mask); }
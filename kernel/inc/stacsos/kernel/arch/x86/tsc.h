@@ -17,6 +17,9 @@ public:
 
 	void calibrate();
 
+	// Takes the frequency calibrated by REFERENCE, rather than calibrating this counter separately.
+	void calibrate_from(const tsc &reference) { timer_frequency_ = reference.timer_frequency_; }
+
 	u64 read()
 	{
 		u32 pid;
@@ -25,6 +28,15 @@ public:
 
 	u64 frequency() const { return timer_frequency_; }
 
+	// Conversions between TSC cycles and nanoseconds, split so that the intermediate products
+	// cannot overflow.
+	u64 cycles_to_ns(u64 cycles) const
+	{
+		return (cycles / timer_frequency_) * 1000000000ull + ((cycles % timer_frequency_) * 1000000000ull) / timer_frequency_;
+	}
+
+	u64 ns_to_cycles(u64 ns) const { return (ns / 1000000000ull) * timer_frequency_ + ((ns % 1000000000ull) * timer_frequency_) / 1000000000ull; }
+
 	void spin(u64 milliseconds)
 	{
 		u64 millisecond_period = (frequency() * milliseconds) / 1000ull;
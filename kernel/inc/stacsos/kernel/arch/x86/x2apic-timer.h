@@ -16,6 +16,8 @@ class x2apic_timer : public timer {
 public:
 	x2apic_timer(x2apic &lapic)
 		: lapic_(lapic)
+		, use_tsc_deadline_(false)
+		, deadline_mode_(false)
 	{
 	}
 
@@ -25,6 +27,7 @@ public:
 
 	virtual void start(u64 frequency)
 	{
+		deadline_mode_ = false;
 		lapic_.set_timer_periodic();
 		lapic_.set_timer_divide(3);
 		lapic_.set_timer_initial_count((lapic_.get_timer_frequency() >> 4) / frequency);
@@ -32,10 +35,45 @@ public:
 		lapic_.unmask_interrupts(x2apic_lvts::timer);
 	}
 
-	virtual void stop() { lapic_.mask_interrupts(x2apic_lvts::timer); }
+	virtual void stop()
+	{
+		deadline_mode_ = false;
+		lapic_.mask_interrupts(x2apic_lvts::timer);
+	}
+
+	virtual void start_one_shot(u64 nanoseconds) override
+	{
+		// Keep the count calculation from overflowing.  Longer delays just fire early.
+		if (nanoseconds > max_one_shot_ns) {
+			nanoseconds = max_one_shot_ns;
+		}
+
+		u64 count = ((lapic_.get_timer_frequency() >> 4) * nanoseconds) / 1000000000ull;
+		if (count == 0) {
+			count = 1;
+		} else if (count > 0xffffffffull) {
+			count = 0xffffffffull;
+		}
+
+		deadline_mode_ = false;
+		lapic_.set_timer_one_shot();
+		lapic_.set_timer_divide(3);
+		lapic_.unmask_interrupts(x2apic_lvts::timer);
+
+		// Writing the initial count starts the countdown.
+		lapic_.set_timer_initial_count((u32)count);
+	}
+
+	virtual void start_deadline(u64 timestamp) override;
 
 private:
+	static const u64 max_one_shot_ns = 10000000000ull; // 10 s
+
 	static void timer_irq_handler(u8 irq, void *context, void *arg);
 	x2apic &lapic_;
+
+	// Whether the local APIC supports TSC-deadline mode, and whether the timer is currently in it.
+	bool use_tsc_deadline_;
+	bool deadline_mode_;
 };
 } // namespace stacsos::kernel::arch::x86
@@ -88,6 +88,7 @@ public:
 	void set_timer_periodic()
 	{
 		u64 lvt = msr::read(msr_indicies::X2APIC_LVT_TIMER);
+		lvt &= ~0x00060000;
 		lvt |= 0x00020000;
 		msr::write(msr_indicies::X2APIC_LVT_TIMER, lvt);
 	}
@@ -95,10 +96,21 @@ public:
 	void set_timer_one_shot()
 	{
 		u64 lvt = msr::read(msr_indicies::X2APIC_LVT_TIMER);
-		lvt &= ~0x00020000;
+		lvt &= ~0x00060000;
 		msr::write(msr_indicies::X2APIC_LVT_TIMER, lvt);
 	}
 
+	void set_timer_tsc_deadline()
+	{
+		u64 lvt = msr::read(msr_indicies::X2APIC_LVT_TIMER);
+		lvt &= ~0x00060000;
+		lvt |= 0x00040000;
+		msr::write(msr_indicies::X2APIC_LVT_TIMER, lvt);
+	}
+
+	// In TSC-deadline mode, the timer fires when the TSC reaches V.  Writing zero disarms it.
+	void set_tsc_deadline(u64 v) { msr::write(msr_indicies::IA32_TSC_DEADLINE, v); }
+
 	u32 get_timer_current_count() { return msr::read(msr_indicies::X2APIC_TIMER_CCR); }
 
 	u64 get_timer_frequency() const { return timer_frequency_; }
@@ -112,6 +124,19 @@ public:
 		set_timer_initial_count((timer_frequency_ >> 4) / frequency);
 	}
 
+	void send_ipi(u32 target, u8 vector)
+	{
+		x2apic_icr v;
+
+		v.destination = target;
+		v.vector = vector;
+		v.delivery_mode = icr_delivery_mode::fixed;
+		v.trigger_mode = icr_trigger_mode::edge;
+		v.level = icr_level::assert;
+
+		set_icr(v);
+	}
+
 	void send_remote_init(u32 target)
 	{
 		x2apic_icr v;
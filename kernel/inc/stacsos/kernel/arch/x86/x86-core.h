@@ -16,16 +16,20 @@
 #include <stacsos/kernel/arch/x86/x2apic.h>
 
 namespace stacsos::kernel::arch::x86 {
+enum class idle_mode { poll, hlt, mwait };
+
 class x86_core : public core {
 public:
-	explicit x86_core(int id)
+	x86_core(int id, u32 apic_id)
 		: core(id)
+		, apic_id_(apic_id)
 		, gdt_(*this)
 		, idt_(*this)
 		, tss_(*this)
 		, irqs_(idt_)
 		, lapic_(*this)
 		, timer_(lapic_)
+		, idle_mode_(idle_mode::hlt)
 	{
 	}
 
@@ -37,13 +41,30 @@ public:
 
 	virtual timer &local_timer() override { return timer_; }
 
+	virtual void idle_wait() override;
+
+	// The interrupt vectors used for inter-processor interrupts.
+	static const u8 reschedule_irq = 0xfe;
+	static const u8 call_function_irq = 0xfd;
+	static const u8 tlb_shootdown_irq = 0xfc;
+
+	// The software interrupt a task yields with, when booted with yield=trap.
+	static const u8 yield_irq = 0xff;
+
+	virtual void send_reschedule() override;
+	virtual void send_ipi(ipi_type type) override;
+
+	u32 apic_id() const { return apic_id_; }
+
 	tsc &local_tsc() { return tsc_; }
 
+	virtual u64 timestamp_frequency() override { return tsc_.frequency(); }
+
 	irq::irq_manager<256> &irqmgr() { return irqs_; }
 	const irq::irq_manager<256> &irqmgr() const { return irqs_; }
 
-	virtual void set_current_tcb(const tcb *tcb) override;
-	virtual tcb *get_current_tcb() override;
+	virtual void set_current_tcb(tcb *tcb) override;
+	virtual void load_per_cpu() override;
 
 	x2apic &lapic() { return lapic_; }
 	tsc &timestamp_counter() { return tsc_; }
@@ -54,17 +75,17 @@ public:
 
 	void dump_regs();
 
+	void complete_remote_init();
+
 private:
+	u32 apic_id_;
+
 	global_descriptor_table<16> gdt_;
 	interrupt_descriptor_table<256> idt_;
 	task_state_segment tss_;
 
-	struct {
-		u64 task_ptr;
-		u64 context_ptr;
-		u64 cr3;
-		u64 kernel_stack;
-	} temporary_tcb;
+	// GS points here until this core starts running tasks.
+	tcb temporary_tcb;
 
 	irq::irq_manager<256> irqs_;
 
@@ -72,6 +93,8 @@ private:
 	x2apic_timer timer_;
 	tsc tsc_;
 
+	idle_mode idle_mode_;
+
 	static void exception_handler(u8 irq, void *context, void *arg)
 	{
 		switch (irq) {
@@ -90,8 +113,8 @@ private:
 	}
 
 	void populate_dt();
-	// pfn_t prepare_mpstartup_code();
-	// void complete_remote_init();
+	void select_idle_mode();
+	u8 prepare_mpstartup_code();
 
 	void handle_gpf(machine_context *mc);
 	void handle_page_fault(machine_context *mc);
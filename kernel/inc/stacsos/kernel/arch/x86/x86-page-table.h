@@ -34,6 +34,10 @@ public:
 	void map(mem::page_table_allocator &pta, u64 virtual_address, u64 physical_address, mapping_flags flags, mapping_size size = mapping_size::m4k);
 	void unmap(mem::page_table_allocator &pta, u64 virtual_address);
 
+	pte *get_pte(u64 virtual_address);
+
+	static void flush(u64 virtual_address) { asm volatile("invlpg (%0)" ::"r"(virtual_address) : "memory"); }
+
 	void dump() const;
 
 	u64 effective_cr3() const { return (u64)&pml4_ - 0xffff'8000'0000'0000; }
@@ -7,14 +7,11 @@
  */
 #pragma once
 
+#include <stacsos/kernel/arch/x86/irq/threaded-irq.h>
 #include <stacsos/kernel/dev/device.h>
 #include <stacsos/kernel/dev/input/keys.h>
 #include <stacsos/list.h>
 
-namespace stacsos::kernel::arch {
-class irq;
-}
-
 namespace stacsos::kernel::dev::input {
 
 class keyboard_listener {
@@ -30,9 +27,12 @@ public:
 
 	keyboard(bus &parent)
 		: device(keyboard_device_class, parent)
-		, irq_(nullptr)
+		, irq_(keyboard_irq_top_half, keyboard_irq_thread, this)
 		, listener_(nullptr)
 		, kes_(key_event_state::normal)
+		, event_head_(0)
+		, event_tail_(0)
+		, nr_dropped_events_(0)
 	{
 	}
 
@@ -40,12 +40,22 @@ public:
 
 	void set_listener(keyboard_listener &l) { listener_ = &l; }
 
+	u64 nr_dropped_events() const { return nr_dropped_events_; }
+
 private:
-	arch::irq *irq_;
+	static const unsigned int event_buffer_size = 64;
+
+	arch::x86::irq::threaded_irq irq_;
 	keyboard_listener *listener_;
 	key_event_state kes_;
 
-	static void keyboard_irq_handler(u8, void *, void *);
+	// Raw key events, written by the interrupt handler and read by the threaded handler.
+	u8 event_buffer_[event_buffer_size];
+	unsigned int event_head_, event_tail_;
+	u64 nr_dropped_events_;
+
+	static bool keyboard_irq_top_half(void *arg);
+	static void keyboard_irq_thread(void *arg);
 	void handle_key_event(u8 data);
 	keys scancode_to_key(u8 scancode);
 };
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/dev/device.h>
+
+namespace stacsos::kernel::dev::misc {
+/*
+ * A pseudo-device that reports scheduler statistics as text.  Each line is a
+ * "key value" pair, and a snapshot of the counters is taken when the device is opened.
+ */
+class schedstat : public device {
+public:
+	static device_class schedstat_device_class;
+
+	schedstat(bus &owner)
+		: device(schedstat_device_class, owner)
+	{
+	}
+
+	virtual void configure() override { }
+
+	virtual shared_ptr<fs::file> open_as_file() override;
+};
+} // namespace stacsos::kernel::dev::misc
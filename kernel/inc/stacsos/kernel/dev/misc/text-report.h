@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/fs/file.h>
+#include <stacsos/memory.h>
+
+namespace stacsos::kernel::dev::misc {
+/*
+ * Accumulates the text of a statistics report, as one "key value" pair per line, growing the
+ * buffer as needed.
+ */
+class text_report {
+public:
+	text_report();
+	~text_report() { delete[] buffer_; }
+
+	void add(const char *key, u64 value);
+	void add(const char *key, const char *value);
+
+	size_t length() const { return length_; }
+
+	// Transfers ownership of the buffer to the caller.
+	char *release()
+	{
+		char *r = buffer_;
+		buffer_ = nullptr;
+		return r;
+	}
+
+	// Wraps the report in a read-only file, which takes ownership of the buffer.
+	shared_ptr<fs::file> to_file();
+
+private:
+	size_t capacity_, length_;
+	char *buffer_;
+
+	void append(const char *text, size_t text_length);
+};
+} // namespace stacsos::kernel::dev::misc
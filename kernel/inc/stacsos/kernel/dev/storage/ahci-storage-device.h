@@ -9,6 +9,7 @@
 
 #include <stacsos/kernel/dev/storage/ahci-structures.h>
 #include <stacsos/kernel/dev/storage/block-device.h>
+#include <stacsos/kernel/sched/wait-queue.h>
 
 namespace stacsos::kernel::dev::storage {
 class ahci_storage_device : public block_device {
@@ -19,6 +20,9 @@ public:
 		: block_device(ahci_storage_device_class, parent)
 		, port_(port)
 		, nr_blocks_(0)
+		, dma_buffer_(nullptr)
+		, dma_buffer_bus_address_(0)
+		, dma_buffer_busy_(false)
 	{
 	}
 
@@ -32,10 +36,28 @@ public:
 	virtual void write_blocks_sync(const void *buffer, u64 start, u64 count) override;
 
 private:
+	// Each command table has room for eight PRDT entries of 8 KB, which bounds a single transfer.
+	static const u64 max_prdt_entries = 8;
+	static const u64 prdt_entry_size = KB(8);
+	static const u64 max_blocks_per_command = (max_prdt_entries * prdt_entry_size) / 512;
+
 	volatile hba_port *port_;
 	u64 nr_blocks_;
 
+	// Transfers are staged through this buffer, so callers may pass any kernel pointer.  A transfer
+	// polls the device until it completes, so callers waiting for the buffer sleep, rather than
+	// spinning with interrupts disabled for the length of someone else's transfer.
+	void *dma_buffer_;
+	u64 dma_buffer_bus_address_;
+	bool dma_buffer_busy_;
+	sched::wait_queue dma_buffer_wq_;
+
+	void acquire_dma_buffer();
+	void release_dma_buffer();
+
 	volatile hba_cmd_header *get_free_cmd_slot(int &slot_index);
 	void identify();
+	void transfer_blocks_sync(void *buffer, u64 start, u64 count, bool write);
+	void issue_transfer_sync(u64 start, u64 count, bool write);
 };
 } // namespace stacsos::kernel::dev::storage
@@ -20,6 +20,7 @@ namespace stacsos::kernel::dev::storage {
 #define ATA_DEV_DRQ 0x08
 
 #define ATA_CMD_READ_DMA_EX 0xc8
+#define ATA_CMD_WRITE_DMA_EX 0x35
 #define ATA_CMD_IDENTIFY 0xec
 
 enum class fis_type : u8 {
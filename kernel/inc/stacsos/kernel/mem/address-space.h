@@ -14,15 +14,18 @@
 namespace stacsos::kernel::mem {
 class page_table_allocator;
 class memory_manager;
+class swap_manager;
 
 class address_space {
 	friend class memory_manager;
+	friend class swap_manager;
 
 public:
 	address_space(page_table_allocator &pta, u64 alloc_rgn_start)
 		: pta_(pta)
 		, pt_(page_table::create_empty(pta))
 		, next_alloc_rgn_(alloc_rgn_start)
+		, nr_resident_pages_(0)
 	{
 	}
 
@@ -47,11 +50,14 @@ public:
 
 	address_space *create_linked(u64 alloc_rgn_start);
 
+	u64 nr_resident_pages() const { return nr_resident_pages_; }
+
 private:
 	address_space(page_table_allocator &pta, page_table *pt, u64 alloc_rgn_start)
 		: pta_(pta)
 		, pt_(pt)
 		, next_alloc_rgn_(alloc_rgn_start)
+		, nr_resident_pages_(0)
 	{
 	}
 
@@ -60,5 +66,6 @@ private:
 
 	list<address_space_region *> regions_;
 	u64 next_alloc_rgn_;
+	u64 nr_resident_pages_;
 };
 } // namespace stacsos::kernel::mem
@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/lock.h>
+
+namespace stacsos::kernel::mem {
+enum class dma_flags { none = 0, below_4g = 1, zero = 2 };
+
+DEFINE_ENUM_FLAG_OPERATIONS(dma_flags)
+
+/**
+ * Hands out physically contiguous memory that devices can access directly.  Each allocation
+ * has a kernel virtual address, for the driver, and a bus address, for the device.
+ *
+ * Small allocations come from the page allocator.  Large allocations, and those the page
+ * allocator cannot place below 4 GB, come from a pool of low memory that is set aside at boot.
+ * This means a driver can still get a large buffer after physical memory has fragmented.  The
+ * pool size is set with dma-pool-size=<bytes>.
+ */
+class dma_allocator {
+	DEFINE_SINGLETON(dma_allocator)
+
+private:
+	dma_allocator()
+		: pool_base_(0)
+		, pool_pages_(0)
+		, pool_free_pages_(0)
+	{
+		for (u64 i = 0; i < pool_bitmap_words; i++) {
+			pool_bitmap_[i] = 0;
+		}
+	}
+
+public:
+	static const u64 default_pool_size = MB(4);
+	static const u64 max_pool_size = MB(64);
+
+	// Allocations of at least this size are taken from the pool before the page allocator.
+	static const u64 pool_threshold = KB(64);
+
+	void init_pool(u64 base_address, u64 size);
+
+	void *allocate(size_t size, u64 &bus_address, dma_flags flags);
+	void free(void *ptr, size_t size);
+
+	u64 pool_base() const { return pool_base_; }
+	u64 nr_pool_pages() const { return pool_pages_; }
+	u64 nr_free_pool_pages() const { return pool_free_pages_; }
+
+private:
+	static const u64 pool_bitmap_words = (max_pool_size >> PAGE_BITS) / 64;
+
+	void *allocate_from_pool(u64 nr_pages, u64 &bus_address);
+	void free_to_pool(u64 bus_address, u64 nr_pages);
+
+	bool pool_page_used(u64 index) const { return pool_bitmap_[index / 64] & (1ull << (index % 64)); }
+	void set_pool_page_used(u64 index, bool used)
+	{
+		if (used) {
+			pool_bitmap_[index / 64] |= 1ull << (index % 64);
+		} else {
+			pool_bitmap_[index / 64] &= ~(1ull << (index % 64));
+		}
+	}
+
+	u64 pool_base_;
+	u64 pool_pages_;
+	u64 pool_free_pages_;
+	u64 pool_bitmap_[pool_bitmap_words];
+
+	spinlock_irq lock_;
+};
+
+/**
+ * Allocates SIZE bytes of physically contiguous memory for DMA, and returns its kernel virtual
+ * address.  The address the device should use is returned in BUS_ADDRESS.  Returns nullptr if
+ * the request cannot be satisfied.
+ */
+static inline void *dma_alloc(size_t size, u64 &bus_address, dma_flags flags = dma_flags::below_4g)
+{
+	return dma_allocator::get().allocate(size, bus_address, flags);
+}
+
+/**
+ * Releases memory obtained from dma_alloc.  SIZE must match the size that was allocated.
+ */
+static inline void dma_free(void *ptr, size_t size) { dma_allocator::get().free(ptr, size); }
+} // namespace stacsos::kernel::mem
@@ -16,23 +16,40 @@ struct object_header {
 	u8 data[];
 };
 
+struct large_object_stats {
+	u64 nr_objects;
+	u64 nr_bytes;
+	u64 nr_pages;
+	u64 va_used;
+	u64 va_size;
+};
+
 class large_object_allocator {
 public:
 	large_object_allocator(void *region_base, size_t region_size)
 		: region_base_(region_base)
 		, base_(region_base)
 		, size_(region_size)
+		, nr_objects_(0)
+		, nr_bytes_(0)
+		, nr_pages_(0)
 	{
 	}
 
 	void *allocate(size_t size);
 	bool free(void *ptr);
 
+	large_object_stats stats() const { return large_object_stats { nr_objects_, nr_bytes_, nr_pages_, (u64)base_ - (u64)region_base_, size_ }; }
+
 	bool ptr_in_region(void *ptr) const { return ((uintptr_t)ptr >= (uintptr_t)region_base_) && ((uintptr_t)ptr < ((uintptr_t)region_base_ + size_)); }
 
 private:
 	void *region_base_;
 	void *base_;
 	size_t size_;
+
+	u64 nr_objects_;
+	u64 nr_bytes_;
+	u64 nr_pages_;
 };
 } // namespace stacsos::kernel::mem
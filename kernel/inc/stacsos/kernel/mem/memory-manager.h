@@ -38,11 +38,12 @@ public:
 
 	address_space &root_address_space() const { return *root_address_space_; }
 
-	bool try_handle_page_fault(u64 faulting_address);
+	bool try_handle_page_fault(address_space &as, u64 faulting_address);
 
 private:
 	void initialise_page_descriptors(u64 nr_page_descriptors);
 	void initialise_page_allocator(u64 nr_page_descriptors);
+	void reserve_dma_pool(u64 lowest_address);
 	void initialise_object_allocator();
 	void activate_primary_mapping();
 
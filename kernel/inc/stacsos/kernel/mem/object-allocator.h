@@ -22,6 +22,11 @@ public:
 	void *realloc(void *obj, size_t size);
 	void free(void *obj);
 
+	static const int nr_slab_caches = 7;
+
+	slab_cache_stats slab_stats(int index);
+	large_object_stats loa_stats();
+
 private:
 	spinlock_irq object_allocator_lock_;
 
@@ -14,9 +14,11 @@ class page_allocator_buddy : public page_allocator {
 public:
 	page_allocator_buddy(memory_manager &mm)
 		: page_allocator(mm)
+		, total_free_(0)
 	{
 		for (int i = 0; i <= LastOrder; i++) {
 			free_list_[i] = nullptr;
+			free_blocks_[i] = 0;
 		}
 	}
 
@@ -26,17 +28,44 @@ public:
 	virtual page *allocate_pages(int order, page_allocation_flags flags = page_allocation_flags::none) override;
 	virtual void free_pages(page &base, int order) override;
 
+	virtual const char *name() const override { return "buddy"; }
+
+	virtual u64 nr_free_pages() const override { return total_free_; }
+
+	virtual int nr_orders() const override { return LastOrder + 1; }
+	virtual u64 nr_free_blocks(int order) const override { return free_blocks_[order]; }
+
+	virtual int largest_free_order() const override
+	{
+		for (int order = LastOrder; order >= 0; order--) {
+			if (free_blocks_[order]) {
+				return order;
+			}
+		}
+
+		return -1;
+	}
+
 	virtual void dump() const override;
 
+	/*
+	 * Checks the internal consistency of the free lists: every block is aligned to its order,
+	 * each list is sorted with no duplicates, no pair of free buddies has been left unmerged, and
+	 * the per-order and total counters agree with the lists.  Returns false, after describing the
+	 * first problem found, if any check fails.
+	 */
+	bool verify() const;
+
 private:
 	static const int LastOrder = 16;
 
 	page *free_list_[LastOrder + 1];
+	u64 free_blocks_[LastOrder + 1];
 	u64 total_free_;
 
 	constexpr u64 pages_per_block(int order) const { return 1 << order; }
 
-	constexpr bool block_aligned(int order, u64 pfn) { return !(pfn & (pages_per_block(order) - 1)); }
+	constexpr bool block_aligned(int order, u64 pfn) const { return !(pfn & (pages_per_block(order) - 1)); }
 
 	void insert_free_block(int order, page &block_start);
 	void remove_free_block(int order, page &block_start);
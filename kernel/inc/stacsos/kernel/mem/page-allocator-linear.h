@@ -16,6 +16,7 @@ public:
 	page_allocator_linear(memory_manager &mm)
 		: page_allocator(mm)
 		, free_list_(nullptr)
+		, total_free_(0)
 	{
 	}
 
@@ -25,9 +26,16 @@ public:
 	virtual page *allocate_pages(int order, page_allocation_flags flags = page_allocation_flags::none) override;
 	virtual void free_pages(page &base, int order) override;
 
+	virtual const char *name() const override { return "linear"; }
+
+	virtual u64 nr_free_pages() const override { return total_free_; }
+
+	virtual int largest_free_order() const override;
+
 	virtual void dump() const override;
 
 private:
 	page *free_list_;
+	u64 total_free_;
 };
 } // namespace stacsos::kernel::mem
@@ -7,6 +7,7 @@
  */
 #pragma once
 
+#include <stacsos/kernel/lock.h>
 #include <stacsos/kernel/mem/page-alloc-ref.h>
 
 namespace stacsos::kernel::mem {
@@ -36,11 +37,34 @@ public:
 		return page_alloc_ref(allocate_pages(order, flags), order);
 	}
 
+	virtual const char *name() const = 0;
+
+	virtual u64 nr_free_pages() const = 0;
+
+	/*
+	 * Allocators that manage memory in power-of-two blocks report how many free blocks
+	 * they hold at each order.  Other allocators report no orders.
+	 */
+	virtual int nr_orders() const { return 0; }
+	virtual u64 nr_free_blocks(int order) const { return 0; }
+
+	// Returns the largest order that can currently be allocated, or -1 if there is no free memory.
+	virtual int largest_free_order() const = 0;
+
 	virtual void dump() const = 0;
 
 	void perform_selftest();
+	void perform_benchmark(const char *pattern, u64 seed);
+
+protected:
+	// Serialises updates to the free lists, which are shared by every core.
+	spinlock_irq lock_;
 
 private:
 	memory_manager &mm_;
+
+	void benchmark_sequential(const char *pattern, bool reverse_free);
+	void benchmark_random(const char *pattern, u64 seed);
+	void report_fragmentation(const char *pattern);
 };
 } // namespace stacsos::kernel::mem
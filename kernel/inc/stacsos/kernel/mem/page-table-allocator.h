@@ -14,7 +14,17 @@ namespace stacsos::kernel::mem {
 
 class page_table_allocator {
 public:
+	page_table_allocator()
+		: nr_pages_(0)
+	{
+	}
+
 	page *allocate();
 	void free(page *pg);
+
+	u64 nr_pages() const { return nr_pages_; }
+
+private:
+	u64 nr_pages_;
 };
 } // namespace stacsos::kernel::mem
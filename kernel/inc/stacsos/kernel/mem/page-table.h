@@ -13,4 +13,5 @@ namespace stacsos::kernel::mem {
 using page_table = arch::x86::x86_page_table;
 using mapping_flags = arch::x86::mapping_flags;
 using mapping_size = arch::x86::mapping_size;
+using page_table_entry = arch::x86::pte;
 } // namespace stacsos::kernel::mem
@@ -12,6 +12,13 @@
 namespace stacsos::kernel::mem {
 enum class slab_state { empty, partial, full };
 
+struct slab_cache_stats {
+	size_t object_size;
+	u64 nr_slabs;
+	u64 nr_objects;
+	u64 capacity;
+};
+
 template <size_t object_size, int slab_page_order> class slab_cache {
 private:
 	static const size_t slab_memory_size = ((1u << slab_page_order) * PAGE_SIZE);
@@ -86,6 +93,8 @@ private:
 public:
 	slab_cache()
 		: slabs_(nullptr)
+		, nr_slabs_(0)
+		, nr_objects_(0)
 	{
 	}
 
@@ -107,9 +116,11 @@ public:
 			s = new (slab_base) slab();
 			s->next_ = slabs_;
 			slabs_ = s;
+			nr_slabs_++;
 		}
 
 		void *ptr = s->allocate();
+		nr_objects_++;
 		// dprintf("malloc: cache-size=%u, slab=%p, ptr=%p\n", object_size, s, ptr);
 		return ptr;
 	}
@@ -131,6 +142,7 @@ public:
 		}
 
 		s->free(ptr);
+		nr_objects_--;
 		// dprintf("free: ptr=%p\n", ptr);
 
 		// TODO: Free slabs?
@@ -145,8 +157,16 @@ public:
 		}
 	}
 
+	slab_cache_stats stats() const
+	{
+		// The slab header occupies the first few object slots, so they are not counted as capacity.
+		return slab_cache_stats { object_size, nr_slabs_, nr_objects_, nr_slabs_ * (slab_object_capacity - slab::reserved_objects) };
+	}
+
 private:
 	slab *slabs_;
+	u64 nr_slabs_;
+	u64 nr_objects_;
 
 	void *allocate_slab();
 };
@@ -0,0 +1,118 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/lock.h>
+#include <stacsos/kernel/mem/page-allocator.h>
+#include <stacsos/kernel/mem/page-table.h>
+#include <stacsos/kernel/sched/wait-queue.h>
+
+namespace stacsos::kernel::dev::storage {
+class block_device;
+}
+
+namespace stacsos::kernel::mem {
+class address_space;
+class page;
+
+/**
+ * Manages a swap area on a block device, and pages anonymous user memory out to it when free
+ * memory runs low.  Resident anonymous pages are kept on an LRU list, which is scanned with a
+ * second-chance (clock) policy using the accessed bit in the page table entry.
+ */
+class swap_manager {
+	DEFINE_SINGLETON(swap_manager)
+
+private:
+	swap_manager()
+		: bdev_(nullptr)
+		, first_block_(0)
+		, nr_slots_(0)
+		, nr_free_slots_(0)
+		, next_slot_(0)
+		, slot_bitmap_(nullptr)
+		, in_flight_bitmap_(nullptr)
+		, lru_head_(nullptr)
+		, lru_tail_(nullptr)
+		, nr_resident_(0)
+		, nr_swapped_out_(0)
+		, nr_swapped_in_(0)
+	{
+	}
+
+public:
+	// Reclaim starts when the number of free pages drops below the low watermark, and
+	// continues until the high watermark is reached.
+	static const u64 low_watermark = 1024;
+	static const u64 high_watermark = 2048;
+
+	static const u64 reclaim_interval_ms = 100;
+
+	void init();
+
+	bool enabled() const { return bdev_ != nullptr; }
+
+	page *allocate_anonymous_page(page_allocation_flags flags = page_allocation_flags::zero);
+	void track_page(address_space &as, u64 virtual_address, page &pg);
+
+	bool try_swap_in(address_space &as, u64 virtual_address);
+	bool read_resident_word(address_space &as, u64 virtual_address, u32 &value);
+	u64 reclaim(u64 nr_pages);
+
+	u64 nr_slots() const { return nr_slots_; }
+	u64 nr_free_slots() const { return nr_free_slots_; }
+
+	u64 nr_swapped_out() const { return nr_swapped_out_; }
+	u64 nr_swapped_in() const { return nr_swapped_in_; }
+
+private:
+	struct resident_page {
+		resident_page *prev, *next;
+		address_space *as;
+		u64 virtual_address;
+		page *pg;
+	};
+
+	// Block devices transfer data in 512-byte blocks, so each swap slot spans several blocks.
+	static const u64 blocks_per_slot = PAGE_SIZE / 512;
+
+	static void reclaim_thread_main();
+
+	u64 slot_to_block(u64 slot) const { return first_block_ + (slot * blocks_per_slot); }
+
+	bool allocate_slot(u64 &slot);
+	void free_slot(u64 slot);
+
+	// A slot is in flight while a page is being written to it or read back from it.  Only the
+	// thread that marked it touches the slot or the page table entry that refers to it until then.
+	bool slot_in_flight(u64 slot) const { return __atomic_load_n(&in_flight_bitmap_[slot / 64], __ATOMIC_ACQUIRE) & (1ull << (slot % 64)); }
+	void mark_in_flight(u64 slot);
+	void clear_in_flight(u64 slot);
+
+	void lru_append(resident_page *rp);
+	void lru_remove(resident_page *rp);
+
+	void swap_out(resident_page *rp, u64 slot);
+
+	dev::storage::block_device *bdev_;
+	u64 first_block_;
+	u64 nr_slots_;
+	u64 nr_free_slots_;
+	u64 next_slot_;
+	u64 *slot_bitmap_;
+	u64 *in_flight_bitmap_;
+	sched::wait_queue in_flight_wq_;
+
+	resident_page *lru_head_, *lru_tail_;
+	u64 nr_resident_;
+
+	u64 nr_swapped_out_, nr_swapped_in_;
+
+	spinlock_irq lock_;
+};
+} // namespace stacsos::kernel::mem
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <stacsos/atomic.h>
+#include <stacsos/kernel/lock.h>
 #include <stacsos/kernel/obj/object.h>
 #include <stacsos/map.h>
 
@@ -30,6 +31,8 @@ private:
 public:
 	shared_ptr<object> get_object(sched::process &owner, u64 id)
 	{
+		unique_irq_lock l(lock_);
+
 		map<u64, shared_ptr<object>> *process_object_map;
 		if (!objects_.try_get_value(&owner, process_object_map)) {
 			return nullptr;
@@ -69,6 +72,10 @@ public:
 
 private:
 	atomic_u64 next_id_;
+
+	// Objects are created and looked up by threads on every core, so both levels of map are only
+	// used with this held.
+	spinlock_irq lock_;
 	map<sched::process *, map<u64, shared_ptr<object>> *> objects_;
 
 	u64 allocate_id(sched::process &owner)
@@ -82,14 +89,16 @@ private:
 
 	shared_ptr<object> register_object(sched::process &owner, object *o)
 	{
+		auto object_ptr = shared_ptr(o);
+
+		unique_irq_lock l(lock_);
+
 		map<u64, shared_ptr<object>> *process_object_map;
 		if (!objects_.try_get_value(&owner, process_object_map)) {
 			process_object_map = new map<u64, shared_ptr<object>>();
 			objects_.add(&owner, process_object_map);
 		}
 
-		auto object_ptr = shared_ptr(o);
-
 		process_object_map->add(o->id(), object_ptr);
 		return object_ptr;
 	}
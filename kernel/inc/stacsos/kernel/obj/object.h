@@ -10,11 +10,12 @@
 #include <stacsos/kernel/fs/directory.h>
 #include <stacsos/kernel/fs/file.h>
 #include <stacsos/kernel/sched/process.h>
+#include <stacsos/kernel/sched/scheduler.h>
 #include <stacsos/kernel/sched/thread.h>
 #include <stacsos/memory.h>
 
 namespace stacsos::kernel::obj {
-enum class operation_result_code : u64 { ok = 1, not_found = 2, not_supported = 3 };
+enum class operation_result_code : u64 { ok = 1, not_found = 2, not_supported = 3, timed_out = 4, busy = 5 };
 
 struct operation_result {
 	operation_result_code code;
@@ -22,6 +23,8 @@ struct operation_result {
 
 	static operation_result ok(u64 data = 0) { return operation_result { operation_result_code::ok, data }; }
 	static operation_result not_supported() { return operation_result { operation_result_code::not_supported, 0 }; }
+	static operation_result timed_out() { return operation_result { operation_result_code::timed_out, 0 }; }
+	static operation_result busy() { return operation_result { operation_result_code::busy, 0 }; }
 };
 
 class object {
@@ -35,8 +38,17 @@ public:
 	virtual operation_result write(const void *buffer, size_t length) { return operation_result::not_supported(); }
 	virtual operation_result pwrite(const void *buffer, size_t length, size_t offset) { return operation_result::not_supported(); }
 	virtual operation_result ioctl(u64 cmd, void *buffer, size_t length) { return operation_result::not_supported(); }
-	virtual operation_result wait_for_status_change() { return operation_result::not_supported(); }
-	virtual operation_result join() { return operation_result::not_supported(); }
+
+	// DEADLINE is a timestamp counter value, or zero to wait forever.
+	virtual operation_result wait_for_status_change(u64 deadline) { return operation_result::not_supported(); }
+	virtual operation_result join(u64 deadline) { return operation_result::not_supported(); }
+
+	// The mask of cores a thread may run on.
+	virtual operation_result set_affinity(u64 mask) { return operation_result::not_supported(); }
+	virtual operation_result get_affinity() { return operation_result::not_supported(); }
+
+	// The CPU quota of a process, in timestamp counter cycles of run time per PERIOD cycles.
+	virtual operation_result set_cpu_quota(u64 quota, u64 period) { return operation_result::not_supported(); }
 
 protected:
 	object(u64 id)
@@ -92,17 +104,23 @@ public:
 	{
 	}
 
-	virtual operation_result wait_for_status_change() override
+	virtual operation_result wait_for_status_change(u64 deadline) override
 	{
 		sched::process_state initial = proc_->state();
 
-		while (proc_->state() == initial) {
-			proc_->state_changed_event().wait();
+		if (!proc_->state_changed_event().wait_event([&] { return proc_->state() != initial; }, deadline)) {
+			return operation_result::timed_out();
 		}
 
 		return operation_result::ok(0);
 	}
 
+	virtual operation_result set_cpu_quota(u64 quota, u64 period) override
+	{
+		proc_->quota().configure(quota, period);
+		return operation_result::ok(0);
+	}
+
 private:
 	shared_ptr<sched::process> proc_;
 };
@@ -115,15 +133,26 @@ public:
 	{
 	}
 
-	virtual operation_result join() override
+	virtual operation_result join(u64 deadline) override
 	{
-		while (thread_->state() != sched::thread_states::terminated) {
-			thread_->state_changed_event().wait();
+		if (!thread_->state_changed_event().wait_event([&] { return thread_->state() == sched::thread_states::terminated; }, deadline)) {
+			return operation_result::timed_out();
 		}
 
 		return operation_result::ok(0);
 	}
 
+	virtual operation_result set_affinity(u64 mask) override
+	{
+		if (!sched::scheduler::get().set_affinity(*thread_, mask)) {
+			return operation_result::busy();
+		}
+
+		return operation_result::ok(0);
+	}
+
+	virtual operation_result get_affinity() override { return operation_result::ok(thread_->affinity()); }
+
 private:
 	shared_ptr<sched::thread> thread_;
 };
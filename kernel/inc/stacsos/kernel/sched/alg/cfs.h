@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/sched/alg/scheduling-algorithm.h>
+#include <stacsos/rb-tree.h>
+
+namespace stacsos::kernel::sched::alg {
+
+/*
+ * A fair scheduler in the style of Linux's CFS.  Each task accumulates virtual run time, which is
+ * its real run time scaled by the weight of its nice level, and the task with the least virtual
+ * run time runs next.  Tasks are kept in a red-black tree ordered by virtual run time, so the next
+ * task is always the cached leftmost node.
+ *
+ * New and woken tasks start at the queue's minimum virtual run time, rather than at zero, so they
+ * run soon but cannot monopolise the core while they "catch up".  Each core's queue has its own
+ * minimum, so a task moving between cores takes its virtual run time relative to the old queue's
+ * minimum with it, and is placed at the same distance from the new queue's.
+ */
+class completely_fair_scheduler : public scheduling_algorithm {
+public:
+	completely_fair_scheduler()
+		: min_vruntime_(0)
+	{
+	}
+
+	virtual void add_to_runqueue(tcb &tcb) override;
+	virtual void remove_from_runqueue(tcb &tcb) override;
+	virtual tcb *select_next_task(tcb *current) override;
+	virtual tcb *select_migration_candidate(tcb *exclude_a, tcb *exclude_b, int target_core) override;
+	virtual void migrate_out(tcb &tcb) override;
+	virtual void migrate_in(tcb &tcb) override;
+	virtual unsigned int nr_runnable() const override { return runqueue_.count(); }
+	virtual bool contains(const tcb &tcb) const override;
+	virtual const char *name() const { return "completely fair"; }
+
+	// The weight of a nice 0 task.  Virtual run time advances at real time for such a task.
+	static const u64 nice_0_weight = 1024;
+
+	// Returns the weight for NICE, clamped to the range -20 (heaviest) to 19 (lightest).
+	static u64 nice_to_weight(s64 nice);
+
+private:
+	rb_tree runqueue_;
+	u64 min_vruntime_;
+
+	void update_vruntime(tcb &tcb);
+	void enqueue(tcb &tcb);
+};
+} // namespace stacsos::kernel::sched::alg
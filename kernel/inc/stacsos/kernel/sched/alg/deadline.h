@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/sched/alg/scheduling-algorithm.h>
+#include <stacsos/rb-tree.h>
+
+namespace stacsos::kernel::sched::alg {
+
+/*
+ * The deadline scheduling class: earliest deadline first, with each task's reservation enforced by
+ * a constant bandwidth server (CBS).  A task reserves RUNTIME cycles in every PERIOD, to be used
+ * within DEADLINE of the period starting.  Every task has a budget and an absolute deadline; the
+ * runnable task with the earliest absolute deadline runs.  Time the task runs is charged to its
+ * budget, from the run time kept by the core's accounting.  A task that runs out of budget is
+ * throttled until its next period, when the budget is replenished and the deadline moved on, so an
+ * overrunning task cannot take time reserved by others.
+ *
+ * Admission control (in the core) keeps the total bandwidth of the tasks on a core below a limit,
+ * so that every deadline can be met.  Deadline tasks stay on the core they were admitted on.
+ */
+class deadline_scheduler : public scheduling_algorithm {
+public:
+	// Bandwidth (RUNTIME / PERIOD) is a fraction of a core, in fixed point with this many bits.
+	static const int bw_shift = 20;
+	static const u64 bw_one = 1ull << bw_shift;
+
+	deadline_scheduler()
+		: bandwidth_(0)
+	{
+	}
+
+	virtual void add_to_runqueue(tcb &tcb) override;
+	virtual void remove_from_runqueue(tcb &tcb) override;
+	virtual tcb *select_next_task(tcb *current) override;
+	virtual tcb *select_migration_candidate(tcb *exclude_a, tcb *exclude_b, int target_core) override { return nullptr; }
+	virtual unsigned int nr_runnable() const override { return ready_.count(); }
+	virtual bool contains(const tcb &tcb) const override;
+	virtual const char *name() const { return "earliest deadline first"; }
+
+	// RUNTIME is at most a few seconds of cycles, so it can be shifted without overflowing.
+	static u64 bandwidth_of(u64 runtime, u64 period) { return (runtime << bw_shift) / period; }
+
+	// The total bandwidth of the tasks admitted to this class.
+	u64 bandwidth() const { return bandwidth_; }
+	void add_bandwidth(u64 bw) { bandwidth_ += bw; }
+	void remove_bandwidth(u64 bw) { bandwidth_ -= bw; }
+
+	// Gives up the rest of TCB's budget for this period, e.g. when a periodic job has finished.
+	void yield(tcb &tcb);
+
+	/*
+	 * Returns the time by which this core next needs to reschedule for this class: when a throttled
+	 * task is replenished, or CURRENT runs out of budget.  Returns zero if there is no such time.
+	 */
+	u64 next_event(const tcb *current, u64 now) const;
+
+	unsigned int nr_throttled() const { return throttled_.count(); }
+
+private:
+	// Runnable tasks, and throttled tasks, ordered by absolute deadline.
+	rb_tree ready_;
+	rb_tree throttled_;
+	u64 bandwidth_;
+
+	void charge(tcb &tcb);
+	void check_missed(tcb &tcb, u64 now);
+	void throttle(tcb &tcb);
+	void replenish_expired(u64 now);
+};
+} // namespace stacsos::kernel::sched::alg
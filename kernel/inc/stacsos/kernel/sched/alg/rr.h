@@ -7,7 +7,7 @@
  */
 #pragma once
 
-#include "stacsos/end_list.h"
+#include <stacsos/intrusive-list.h>
 #include <stacsos/kernel/sched/alg/scheduling-algorithm.h>
 
 namespace stacsos::kernel::sched::alg {
@@ -17,12 +17,15 @@ namespace stacsos::kernel::sched::alg {
 
 class round_robin : public scheduling_algorithm {
 private:
-	end_list<tcb *> tcb_list;
+	intrusive_list tcb_list;
 
 public:
 	virtual void add_to_runqueue(tcb &tcb) override;
 	virtual void remove_from_runqueue(tcb &tcb) override;
 	virtual tcb *select_next_task(tcb *current) override;
+	virtual tcb *select_migration_candidate(tcb *exclude_a, tcb *exclude_b, int target_core) override;
+	virtual unsigned int nr_runnable() const override { return tcb_list.count(); }
+	virtual bool contains(const tcb &tcb) const override;
 	virtual const char *name() const { return "round robin"; }
 };
 } // namespace stacsos::kernel::sched::alg
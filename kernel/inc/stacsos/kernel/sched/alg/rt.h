@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/intrusive-list.h>
+#include <stacsos/kernel/sched/alg/scheduling-algorithm.h>
+#include <stacsos/syscalls.h>
+
+namespace stacsos::kernel::sched::alg {
+
+/*
+ * The real-time scheduling class, for fifo and rr threads.  There is a queue per priority, and a
+ * bitmap of the non-empty queues, so the next task is found with a bit scan.  The running task
+ * stays at the head of its queue: a fifo task keeps the core until it blocks, yields or is
+ * preempted by a higher priority, and an rr task moves to the back of its queue once it has run for
+ * a timeslice.
+ *
+ * Real-time tasks are placed when they wake up, and are never chosen by the load balancer.
+ */
+class realtime_scheduler : public scheduling_algorithm {
+public:
+	static const int nr_priorities = max_rt_priority + 1;
+
+	realtime_scheduler()
+		: nr_runnable_(0)
+		, timeslice_(0)
+		, slice_owner_(nullptr)
+		, slice_start_(0)
+	{
+		bitmap_[0] = bitmap_[1] = 0;
+	}
+
+	virtual void add_to_runqueue(tcb &tcb) override;
+	virtual void remove_from_runqueue(tcb &tcb) override;
+	virtual tcb *select_next_task(tcb *current) override;
+	virtual tcb *select_migration_candidate(tcb *exclude_a, tcb *exclude_b, int target_core) override { return nullptr; }
+	virtual unsigned int nr_runnable() const override { return nr_runnable_; }
+	virtual bool contains(const tcb &tcb) const override;
+	virtual const char *name() const { return "real-time"; }
+
+	// Sets the length of an rr timeslice, in timestamp counter cycles.
+	void set_timeslice(u64 cycles) { timeslice_ = cycles; }
+
+	// Moves TCB to the back of its priority's queue, e.g. when it yields.
+	void requeue(tcb &tcb);
+
+	// Returns the priority of the most important runnable task, or zero if there is none.
+	int highest_priority() const;
+
+private:
+	static_assert(nr_priorities <= 128);
+
+	intrusive_list queues_[nr_priorities];
+	u64 bitmap_[2];
+	unsigned int nr_runnable_;
+
+	u64 timeslice_;
+	tcb *slice_owner_;
+	u64 slice_start_;
+};
+} // namespace stacsos::kernel::sched::alg
@@ -17,6 +17,23 @@ public:
 	virtual void add_to_runqueue(tcb &tcb) = 0;
 	virtual void remove_from_runqueue(tcb &tcb) = 0;
 	virtual tcb *select_next_task(tcb *current) = 0;
+	virtual unsigned int nr_runnable() const = 0;
+
+	// Returns true if TCB is on this algorithm's run queue.
+	virtual bool contains(const tcb &tcb) const = 0;
+
+	// Returns the runnable task that has been waiting longest, other than EXCLUDE_A and EXCLUDE_B,
+	// as a candidate to move to the core with ID TARGET_CORE, which its affinity must allow.
+	// Returns nullptr if there is no such task.
+	virtual tcb *select_migration_candidate(tcb *exclude_a, tcb *exclude_b, int target_core) = 0;
+
+	// Called when TCB, which is not on this run queue, moves to another core.  Any state it carries
+	// that only means something on this queue is made relative, for migrate_in() on the new core.
+	virtual void migrate_out(tcb &tcb) { }
+
+	// Called when TCB moves to this core, before it is added to the run queue.
+	virtual void migrate_in(tcb &tcb) { }
+
 	virtual const char *name() const = 0;
 };
 } // namespace stacsos::kernel::sched::alg
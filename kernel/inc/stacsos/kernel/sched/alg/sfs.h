@@ -8,18 +8,27 @@
 #pragma once
 
 #include <stacsos/kernel/sched/alg/scheduling-algorithm.h>
-#include <stacsos/list.h>
+#include <stacsos/rb-tree.h>
 
 namespace stacsos::kernel::sched::alg {
 
+/*
+ * Runs the task that has had the least CPU time.  Tasks are kept in a red-black tree ordered by run
+ * time, so the next task is the cached leftmost node.
+ */
 class simple_fair_scheduler : public scheduling_algorithm {
 public:
-	virtual void add_to_runqueue(tcb &tcb) override { runqueue_.append(&tcb); }
-	virtual void remove_from_runqueue(tcb &tcb) override { runqueue_.remove(&tcb); }
+	virtual void add_to_runqueue(tcb &tcb) override;
+	virtual void remove_from_runqueue(tcb &tcb) override;
 	virtual tcb *select_next_task(tcb *current) override;
+	virtual tcb *select_migration_candidate(tcb *exclude_a, tcb *exclude_b, int target_core) override;
+	virtual unsigned int nr_runnable() const override { return runqueue_.count(); }
+	virtual bool contains(const tcb &tcb) const override;
 	virtual const char *name() const { return "simple fair"; }
 
 private:
-	list<tcb *> runqueue_;
+	rb_tree runqueue_;
+
+	void enqueue(tcb &tcb);
 };
 } // namespace stacsos::kernel::sched::alg
@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/lock.h>
+#include <stacsos/kernel/sched/timer-wheel.h>
+
+namespace stacsos::kernel::sched {
+
+/*
+ * A CPU bandwidth quota, shared by the threads of a process: between them, they may run for at most
+ * QUOTA cycles in every PERIOD, across all cores.  Run time is charged as the cores account for
+ * it.  Once the quota is used up, the threads are throttled: each core parks them, rather than
+ * running them, until a timer refills the quota at the end of the period.  A quota of zero means
+ * the threads are not limited.  Deadline threads are exempt, since they have their own reservation.
+ */
+class cpu_quota {
+public:
+	cpu_quota()
+		: quota_(0)
+		, period_(0)
+		, used_(0)
+		, period_end_(0)
+		, throttled_(false)
+		, nr_periods_(0)
+		, nr_throttled_(0)
+		, refill_timer_(refill_expired, this)
+	{
+	}
+
+	~cpu_quota();
+
+	DELETE_DEFAULT_COPY_AND_MOVE(cpu_quota)
+
+	// Sets the quota, in timestamp counter cycles per PERIOD cycles, and starts a new period.
+	void configure(u64 quota, u64 period);
+
+	u64 quota() const { return quota_; }
+	u64 period() const { return period_; }
+	bool limited() const { return quota_ != 0; }
+
+	// Charges DELTA cycles of run time.
+	void charge(u64 delta)
+	{
+		if (!limited()) {
+			return;
+		}
+
+		charge_slow(delta);
+	}
+
+	bool throttled() const { return __atomic_load_n(&throttled_, __ATOMIC_RELAXED); }
+
+	// The run time left in this period, in cycles.
+	u64 remaining() const
+	{
+		u64 used = __atomic_load_n(&used_, __ATOMIC_RELAXED);
+		return used < quota_ ? quota_ - used : 0;
+	}
+
+	u64 nr_periods() const { return nr_periods_; }
+	u64 nr_throttled() const { return nr_throttled_; }
+
+private:
+	spinlock_irq lock_;
+	u64 quota_, period_;
+	u64 used_;
+	u64 period_end_;
+	bool throttled_;
+
+	u64 nr_periods_;
+	u64 nr_throttled_;
+
+	// Fires at the end of every period while the quota is limited.
+	soft_timer refill_timer_;
+
+	void charge_slow(u64 delta);
+	static void refill_expired(void *arg);
+};
+} // namespace stacsos::kernel::sched
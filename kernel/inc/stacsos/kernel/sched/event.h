@@ -7,17 +7,12 @@
  */
 #pragma once
 
-#include <stacsos/list.h>
+#include <stacsos/kernel/sched/wait-queue.h>
 
 namespace stacsos::kernel::sched {
-class thread;
-
-class event {
+// An event wakes every thread waiting for it when it is triggered.
+class event : public wait_queue {
 public:
-	void trigger();
-	void wait();
-
-private:
-	list<thread *> wait_list_;
+	void trigger() { wake_all(); }
 };
 } // namespace stacsos::kernel::sched
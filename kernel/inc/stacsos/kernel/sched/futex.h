@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/sched/wait-queue.h>
+
+namespace stacsos::kernel::mem {
+class address_space;
+}
+
+namespace stacsos::kernel::sched {
+enum class futex_result { woken, timed_out, value_changed, invalid };
+
+/*
+ * Fast userspace mutexes.  A futex is a 32-bit word in a process' memory: userspace manipulates it
+ * with atomic instructions, and only enters the kernel to sleep when the word says it must wait, or
+ * to wake waiters.  Sleeping threads are kept in a fixed set of wait queues, hashed by address
+ * space and user address, so a futex needs no kernel state while nobody is waiting on it.
+ */
+class futex_table {
+	DEFINE_SINGLETON(futex_table)
+
+public:
+	static const int nr_buckets = 64;
+
+	/*
+	 * Sleeps on the futex at UADDR, if it still holds EXPECTED, until it is woken or the timestamp
+	 * counter reaches DEADLINE (zero means no deadline).
+	 */
+	futex_result wait(mem::address_space &as, u64 uaddr, u32 expected, u64 deadline);
+
+	// Wakes up to COUNT threads sleeping on the futex at UADDR, and returns how many were woken.
+	unsigned int wake(mem::address_space &as, u64 uaddr, unsigned int count);
+
+private:
+	futex_table() { }
+
+	wait_queue buckets_[nr_buckets];
+
+	wait_queue &bucket_for(const wait_key &key);
+};
+} // namespace stacsos::kernel::sched
@@ -7,6 +7,8 @@
  */
 #pragma once
 
+#include <stacsos/atomic.h>
+#include <stacsos/kernel/lock.h>
 #include <stacsos/kernel/sched/process.h>
 #include <stacsos/list.h>
 #include <stacsos/memory.h>
@@ -20,14 +22,33 @@ class process_manager {
 public:
 	DEFINE_SINGLETON(process_manager)
 
-	process_manager() { }
+	process_manager()
+		: next_process_id_(0)
+	{
+	}
 
 	void init();
 
-	shared_ptr<process> create_kernel_process(continuation_fn ep);
+	// Creates a kernel process, with a thread starting at EP, or with no threads if EP is null.
+	shared_ptr<process> create_kernel_process(continuation_fn ep = nullptr);
 	shared_ptr<process> create_process(const char *path, const char *args);
 
+	// Processes may be created on any core, so this returns a copy of the list, taken under the lock.
+	list<shared_ptr<process>> processes() const
+	{
+		unique_irq_lock l(lock_);
+		return active_processes_;
+	}
+
 private:
+	mutable spinlock_irq lock_;
 	list<shared_ptr<process>> active_processes_;
+	atomic_u64 next_process_id_;
+
+	void add_process(shared_ptr<process> p)
+	{
+		unique_irq_lock l(lock_);
+		active_processes_.append(p);
+	}
 };
 } // namespace stacsos::kernel::sched
@@ -7,8 +7,10 @@
  */
 #pragma once
 
+#include <stacsos/kernel/lock.h>
 #include <stacsos/kernel/mem/address-space.h>
 #include <stacsos/kernel/mem/memory-manager.h>
+#include <stacsos/kernel/sched/cpu-quota.h>
 #include <stacsos/kernel/sched/event.h>
 #include <stacsos/kernel/sched/thread.h>
 #include <stacsos/list.h>
@@ -25,20 +27,33 @@ class process {
 	friend class thread;
 
 public:
-	process(exec_privilege priv)
-		: priv_(priv)
+	process(exec_privilege priv, u64 id)
+		: id_(id)
+		, priv_(priv)
 		, state_(process_state::created)
 		, vma_(mem::memory_manager::get().root_address_space().create_linked(0x7fff'2000'0000))
 		, next_user_stack_(0x7fff'1000'0000)
 	{
 	}
 
+	u64 id() const { return id_; }
 	exec_privilege privilege() const { return priv_; }
 
 	shared_ptr<thread> create_thread(u64 entry_point, void *entry_arg = nullptr);
 
 	process_state state() const { return state_; }
 
+	// Threads may be created on any core, so this returns a copy of the list, taken under the lock.
+	list<shared_ptr<thread>> threads() const
+	{
+		unique_irq_lock l(lock_);
+		return threads_;
+	}
+
+	// The CPU bandwidth quota shared by the process's threads.
+	cpu_quota &quota() { return quota_; }
+	const cpu_quota &quota() const { return quota_; }
+
 	void start();
 	void stop();
 
@@ -47,13 +62,18 @@ public:
 	event &state_changed_event() { return state_changed_event_; }
 
 private:
+	u64 id_;
 	exec_privilege priv_;
 	process_state state_;
 	event state_changed_event_;
 
 	mem::address_space *vma_;
+
+	// Protects the thread list, and the next user stack address.
+	mutable spinlock_irq lock_;
 	list<shared_ptr<thread>> threads_;
 	u64 next_user_stack_;
+	cpu_quota quota_;
 
 	void on_thread_stopped(thread &thread);
 };
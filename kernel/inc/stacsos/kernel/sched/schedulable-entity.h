@@ -8,7 +8,10 @@
 #pragma once
 
 #include <stacsos/kernel/arch/x86/machine-context.h>
+#include <stacsos/intrusive-list.h>
 #include <stacsos/memops.h>
+#include <stacsos/rb-tree.h>
+#include <stacsos/syscalls.h>
 
 namespace stacsos::kernel::arch {
 class core;
@@ -16,6 +19,7 @@ class core;
 
 namespace stacsos::kernel::sched {
 class schedulable_entity;
+class cpu_quota;
 
 struct tcb {
 	schedulable_entity *entity; // 0
@@ -26,12 +30,68 @@ struct tcb {
 	u64 start_time;	// 28
 	u64 stop_time;	// 30
 	u64 run_time;	// 38
-} __packed;
+	stacsos::kernel::arch::core *last_core; // 40
+	u64 vruntime; // 48
+	u64 vruntime_sync; // 50
+	s64 nice; // 58
+	rb_node run_node; // 60
+	list_link run_link; // 80
+	u64 per_cpu_offset; // 90 - set to the running core's per-CPU offset when switched in
+	list_link rt_link; // 98
+	sched_policy policy; // a8
+	u8 rt_priority; // a9
+	bool dl_throttled; // aa - out of budget, waiting for it to be replenished
+	bool dl_missed; // ab - the current deadline has already been counted as missed
+	bool dl_yielded; // ac - gave up the rest of its budget, so it is not late
+	u8 reserved[3]; // ad
+	u64 dl_runtime; // b0 - the deadline parameters, in timestamp counter cycles
+	u64 dl_period; // b8
+	u64 dl_deadline; // c0
+	u64 dl_abs_deadline; // c8
+	s64 dl_budget; // d0
+	u64 dl_sync; // d8 - the run time that has been charged to the budget
+	u64 dl_misses; // e0
+	u64 dl_overruns; // e8
+	rb_node dl_node; // f0
+	list_link evict_link; // 110 - on its core's list of tasks to move elsewhere
+	cpu_quota *quota; // 120 - the CPU quota of the task's process, if any
+	list_link park_link; // 128 - on its core's list of tasks throttled by their quota
+};
+
+// The tcb is not packed, so that the embedded tree nodes and list links are properly aligned, but
+// the low-level entry code relies on these offsets, so they must not move.
+static_assert(__builtin_offsetof(tcb, mcontext) == 0x08);
+static_assert(__builtin_offsetof(tcb, kernel_stack) == 0x18);
+static_assert(__builtin_offsetof(tcb, user_stack_save) == 0x20);
+
+// Recover the tcb that embeds a run queue tree node or list link.
+static inline tcb *tcb_from_run_node(rb_node *n) { return (tcb *)((uintptr_t)n - __builtin_offsetof(tcb, run_node)); }
+static inline tcb *tcb_from_run_link(list_link *l) { return (tcb *)((uintptr_t)l - __builtin_offsetof(tcb, run_link)); }
+static inline tcb *tcb_from_rt_link(list_link *l) { return (tcb *)((uintptr_t)l - __builtin_offsetof(tcb, rt_link)); }
+static inline tcb *tcb_from_dl_node(rb_node *n) { return (tcb *)((uintptr_t)n - __builtin_offsetof(tcb, dl_node)); }
+static inline tcb *tcb_from_evict_link(list_link *l) { return (tcb *)((uintptr_t)l - __builtin_offsetof(tcb, evict_link)); }
+static inline tcb *tcb_from_park_link(list_link *l) { return (tcb *)((uintptr_t)l - __builtin_offsetof(tcb, park_link)); }
+
+static inline bool is_deadline(const tcb &t) { return t.policy == sched_policy::deadline; }
+static inline bool is_realtime(const tcb &t) { return t.policy == sched_policy::fifo || t.policy == sched_policy::rr; }
+
+// The scheduling parameters of an entity.  Deadline parameters are in timestamp counter cycles.
+struct sched_params {
+	sched_policy policy;
+	u8 rt_priority;
+	s64 nice;
+	u64 dl_runtime, dl_period, dl_deadline;
+};
 
 class schedulable_entity {
 public:
+	// An affinity mask that allows every core.
+	static const u64 any_core = ~0ull;
+
 	schedulable_entity()
 		: owning_core_(nullptr)
+		, affinity_(any_core)
+		, pinned_(false)
 	{
 		memops::bzero(&tcb_, sizeof(tcb_));
 	}
@@ -39,8 +99,29 @@ public:
 	const tcb *get_tcb() const { return &tcb_; }
 	tcb *get_tcb() { return &tcb_; }
 
+	// The core whose run queue this entity is placed on, or nullptr if it has never been scheduled.
+	arch::core *owning_core() const { return owning_core_; }
+	void set_owning_core(arch::core *c) { owning_core_ = c; }
+
+	// Places a new entity on core C for good: it is never migrated, always woken there, and its
+	// affinity cannot be changed.
+	void pin(arch::core *c);
+
+	bool pinned() const { return pinned_; }
+
+	/*
+	 * The cores the entity may run on, as a mask with a bit for each core ID.  The scheduler never
+	 * places the entity on, or migrates it to, a core outside the mask.  Changing it does not move
+	 * the entity by itself: see scheduler::set_affinity().
+	 */
+	u64 affinity() const { return __atomic_load_n(&affinity_, __ATOMIC_RELAXED); }
+	void set_affinity(u64 mask) { __atomic_store_n(&affinity_, mask, __ATOMIC_RELAXED); }
+	bool allowed_on(int core_id) const { return (affinity() >> core_id) & 1; }
+
 private:
 	arch::core *owning_core_;
+	u64 affinity_;
+	bool pinned_;
 
 protected:
 	__aligned(16) tcb tcb_;
@@ -7,8 +7,38 @@
  */
 #pragma once
 
+#include <stacsos/atomic.h>
+#include <stacsos/syscalls.h>
+
+namespace stacsos::kernel::arch {
+class core;
+}
+
 namespace stacsos::kernel::sched {
 class schedulable_entity;
+struct sched_params;
+
+/*
+ * Counts where woken entities were placed, by the rule that chose the core.
+ */
+struct wakeup_stats {
+	wakeup_stats()
+		: previous_idle(0)
+		, waker_idle(0)
+		, other_idle(0)
+		, previous_busy(0)
+		, pinned(0)
+		, ipis(0)
+	{
+	}
+
+	atomic_u64 previous_idle; // The core it last ran on was idle
+	atomic_u64 waker_idle; // The waking core was idle
+	atomic_u64 other_idle; // Some other core was idle
+	atomic_u64 previous_busy; // No core was idle, so it went back where it last ran
+	atomic_u64 pinned; // It is pinned, a deadline task, or still in use on its previous core, so could not move
+	atomic_u64 ipis; // Reschedule IPIs sent to the chosen core
+};
 
 class scheduler {
 	DEFINE_SINGLETON(scheduler);
@@ -19,5 +49,26 @@ private:
 public:
 	void add_to_schedule(schedulable_entity &e);
 	void remove_from_schedule(schedulable_entity &e);
+
+	// Makes a blocked entity runnable again, choosing a core for it with wake-affine placement.
+	void wake_up(schedulable_entity &e);
+
+	// Sets the scheduling parameters of an entity, which take effect straight away if it is
+	// runnable.  Returns false if the entity asked for more deadline bandwidth than its core has
+	// left, in which case nothing changes.
+	bool set_sched_params(schedulable_entity &e, const sched_params &params);
+
+	// Sets the cores an entity may run on, moving it off its current core if that is no longer
+	// allowed.  Returns false, and changes nothing, if the entity is pinned, or is a deadline task
+	// and MASK does not allow the core its bandwidth is reserved on.
+	bool set_affinity(schedulable_entity &e, u64 mask);
+
+	// Returns the least loaded online core that AFFINITY allows, or nullptr if there is none.
+	arch::core *select_core(u64 affinity);
+
+	const wakeup_stats &wakeup_statistics() const { return wakeup_stats_; }
+
+private:
+	wakeup_stats wakeup_stats_;
 };
 } // namespace stacsos::kernel::sched
@@ -7,27 +7,20 @@
  */
 #pragma once
 
-#include <stacsos/list.h>
+#include <stacsos/kernel/lock.h>
 
 namespace stacsos::kernel::sched {
-class thread;
-
-struct sleeping_thread {
-	thread *thr;
-	u64 wakeup_deadline;
-};
-
 class sleeper {
 	DEFINE_SINGLETON(sleeper)
 
 public:
 	void sleep_ms(u64 duration_ms);
-	void check_wakeup();
+	void sleep_ns(u64 duration_ns);
 
 private:
 	sleeper() { }
 
-	list<sleeping_thread *> sleeping_;
+	spinlock_irq sleeping_lock_;
 
 	void do_sleep(u64 wakeup_deadline);
 };
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/intrusive-list.h>
+#include <stacsos/kernel/lock.h>
+
+namespace stacsos::kernel::sched {
+class timer_wheel;
+
+typedef void (*soft_timer_callback)(void *arg);
+
+/*
+ * A software timer, which calls its callback once the timestamp counter reaches its expiry time.
+ * The timer is intrusive: it is embedded in (or lives on the stack of) whatever is waiting for it,
+ * so arming it never allocates memory.
+ */
+class soft_timer {
+	friend class timer_wheel;
+
+public:
+	soft_timer(soft_timer_callback callback, void *arg)
+		: link_ { nullptr, nullptr }
+		, expires_(0)
+		, callback_(callback)
+		, arg_(arg)
+		, wheel_(nullptr)
+		, pending_(false)
+		, level_(0)
+		, slot_(0)
+	{
+	}
+
+	DELETE_DEFAULT_COPY_AND_MOVE(soft_timer)
+
+	bool pending() const { return pending_; }
+	u64 expires() const { return expires_; }
+
+private:
+	static soft_timer *from_link(list_link *l) { return (soft_timer *)((uintptr_t)l - __builtin_offsetof(soft_timer, link_)); }
+
+	list_link link_;
+	u64 expires_;
+	soft_timer_callback callback_;
+	void *arg_;
+
+	// The wheel this timer was last added to.  It stays set after the timer fires, so that a
+	// cancellation can wait for a callback that is still running.
+	timer_wheel *wheel_;
+	bool pending_;
+	u8 level_, slot_;
+};
+
+/*
+ * A hierarchical timing wheel.  Time is counted in units of 2^unit_shift timestamp counter cycles.
+ * Level 0 has one slot per unit, and each level above covers nr_slots times the span of the one
+ * below.  A timer is placed on the lowest level that covers its expiry, and is moved down a level
+ * (cascaded) as time reaches the start of its slot, so adding and cancelling a timer are O(1).
+ *
+ * Each core has its own wheel, which it runs from its timer interrupt.  Timers may be cancelled
+ * from any core.  Callbacks are called with interrupts disabled, but without the wheel locked, so
+ * they may add timers (including re-adding their own).
+ */
+class timer_wheel {
+	DELETE_DEFAULT_COPY_AND_MOVE(timer_wheel)
+
+public:
+	static const int unit_shift = 10;
+	static const int slot_bits = 6;
+	static const int nr_slots = 1 << slot_bits;
+	static const int nr_levels = 6;
+
+	timer_wheel()
+		: current_(0)
+		, running_(nullptr)
+		, nr_pending_(0)
+	{
+		for (int i = 0; i < nr_levels; i++) {
+			occupied_[i] = 0;
+		}
+	}
+
+	// Arms T to fire when the timestamp counter reaches EXPIRES.  If T is already pending, it is
+	// cancelled first.
+	void add(soft_timer &t, u64 expires);
+
+	// Disarms T, and returns true if it was pending.  If T's callback is running on another core,
+	// waits for it to finish, so T may be freed once this returns.  Must not be called from T's
+	// own callback.
+	static bool cancel(soft_timer &t);
+
+	// Calls the callbacks of every timer that has expired by NOW.
+	void run_expired(u64 now);
+
+	// Returns the timestamp by which run_expired() next needs to be called, or zero if no timer is
+	// pending.  This may be before the earliest expiry, when a higher level needs cascading.
+	u64 next_expiry();
+
+	unsigned int nr_pending() const { return nr_pending_; }
+
+private:
+	spinlock_irq lock_;
+
+	// The next unit to be processed.
+	u64 current_;
+	soft_timer *volatile running_;
+	unsigned int nr_pending_;
+
+	intrusive_list slots_[nr_levels][nr_slots];
+	u64 occupied_[nr_levels];
+
+	static bool detach(soft_timer &t, bool wait);
+	void insert(soft_timer &t);
+	void remove(soft_timer &t);
+	void cascade(int level);
+};
+} // namespace stacsos::kernel::sched
@@ -0,0 +1,108 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/intrusive-list.h>
+#include <stacsos/kernel/lock.h>
+
+namespace stacsos::kernel::sched {
+class thread;
+class wait_queue;
+
+// Identifies what a thread is waiting for, when threads waiting for different things share a queue.
+struct wait_key {
+	const void *object;
+	u64 offset;
+
+	bool operator==(const wait_key &o) const { return object == o.object && offset == o.offset; }
+};
+
+// A thread waiting on a wait queue.  Entries live on the waiting thread's stack.
+struct wait_queue_entry {
+	list_link link;
+	thread *thr;
+	wait_queue *queue;
+	wait_key key;
+	bool timed_out;
+};
+
+enum class wait_result { woken, timed_out, not_waited };
+
+/*
+ * A queue of sleeping threads.  Waking removes threads from the front of the queue, so wake_one
+ * wakes the longest waiter.  Deadlines are timestamp counter values, where zero means no deadline.
+ */
+class wait_queue {
+	DELETE_DEFAULT_COPY_AND_MOVE(wait_queue)
+
+public:
+	wait_queue() { }
+
+	// Sleeps until woken, or until DEADLINE.  Returns false if the deadline passed.
+	bool wait_until(u64 deadline)
+	{
+		unique_irq_lock l(lock_);
+		return sleep(l, deadline, wait_key {});
+	}
+
+	void wait() { wait_until(0); }
+
+	/*
+	 * Sleeps until COND returns true, or until DEADLINE.  COND is checked with the queue locked,
+	 * so a waker that makes it true and then wakes the queue cannot be missed.  Returns the final
+	 * value of COND.
+	 */
+	template <typename Condition> bool wait_event(Condition cond, u64 deadline = 0)
+	{
+		while (true) {
+			unique_irq_lock l(lock_);
+
+			if (cond()) {
+				return true;
+			}
+
+			if (!sleep(l, deadline, wait_key {})) {
+				l.lock();
+				return cond();
+			}
+		}
+	}
+
+	/*
+	 * Sleeps once, under KEY, if COND returns true when checked with the queue locked.  Unlike
+	 * wait_event, the condition is not checked again after waking.
+	 */
+	template <typename Condition> wait_result wait_if(Condition cond, u64 deadline, const wait_key &key)
+	{
+		unique_irq_lock l(lock_);
+
+		if (!cond()) {
+			return wait_result::not_waited;
+		}
+
+		return sleep(l, deadline, key) ? wait_result::woken : wait_result::timed_out;
+	}
+
+	// Each returns the number of threads that were woken.
+	unsigned int wake_one() { return wake_n(1); }
+	unsigned int wake_all() { return wake_n(~0u); }
+	unsigned int wake_n(unsigned int n);
+
+	// Wakes up to N threads that are waiting under KEY.
+	unsigned int wake_n(unsigned int n, const wait_key &key);
+
+	bool empty() const { return waiters_.empty(); }
+
+private:
+	spinlock_irq lock_;
+	intrusive_list waiters_;
+
+	bool sleep(unique_irq_lock &l, u64 deadline, const wait_key &key);
+	static void wait_timed_out(void *arg);
+};
+} // namespace stacsos::kernel::sched
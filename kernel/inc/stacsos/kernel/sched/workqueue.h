@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/kernel/arch/per-cpu.h>
+
+namespace stacsos::kernel::arch {
+class core;
+}
+
+namespace stacsos::kernel::sched {
+class workqueue;
+class wait_queue;
+class thread;
+
+typedef void (*work_fn)(void *arg);
+
+/*
+ * A piece of deferred work.  Like a soft timer, it is embedded in whatever owns it, so queueing it
+ * never allocates memory.  An item can only be queued once at a time: queueing it again before it
+ * has started running does nothing, so a burst of requests is handled by a single call.
+ */
+class work_item {
+	friend class workqueue;
+
+public:
+	work_item(work_fn fn, void *arg)
+		: next_(nullptr)
+		, fn_(fn)
+		, arg_(arg)
+		, queued_at_(0)
+		, pending_(false)
+	{
+	}
+
+	DELETE_DEFAULT_COPY_AND_MOVE(work_item)
+
+	bool pending() const { return pending_; }
+
+private:
+	work_item *next_;
+	work_fn fn_;
+	void *arg_;
+	u64 queued_at_;
+	volatile bool pending_;
+};
+
+// Per-core workqueue statistics.  Latency is measured from queueing an item to starting it.
+struct workqueue_stats {
+	u64 queued;
+	u64 coalesced;
+	u64 run;
+	u64 latency_total;
+	u64 latency_max;
+};
+
+DECLARE_PER_CPU(workqueue_stats, workqueue_statistics);
+
+/*
+ * Per-core kernel worker threads, for work that is too slow to do with interrupts disabled.  Each
+ * core has a lock-free stack of pending items, which can be pushed to from any context, including
+ * hard interrupt handlers, and a fifo worker thread pinned to the core that runs them in the order
+ * they were queued, with interrupts enabled.
+ */
+class workqueue {
+	DEFINE_SINGLETON(workqueue)
+
+public:
+	// Workers run deferred interrupt handling, so they are real-time, ahead of every normal thread.
+	static const u8 worker_priority = 50;
+	static_assert(worker_priority > max_user_rt_priority);
+
+	// Starts a worker thread on every core.  Work queued before this runs once the worker starts.
+	void init();
+
+	// Queues W on the executing core.  Returns false if W was already pending.
+	bool queue(work_item &w);
+
+	// Queues W on core C.  Returns false if W was already pending.
+	bool queue_on(arch::core &c, work_item &w);
+
+private:
+	workqueue() { }
+
+	static void worker_main(void *arg);
+};
+} // namespace stacsos::kernel::sched
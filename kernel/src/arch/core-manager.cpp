@@ -33,7 +33,11 @@ void core_manager::go()
 		}
 
 		dprintf("starting core %d...\n", cores_[i]->id_);
-		//cores_[i]->status_ = cores_[i]->remote_run() ? core_status::online : core_status::error;
+		cores_[i]->status_ = cores_[i]->remote_run() ? core_status::online : core_status::error;
+
+		if (cores_[i]->status_ == core_status::error) {
+			dprintf("core %d failed to start\n", cores_[i]->id_);
+		}
 	}
 
 	// Start this core running
@@ -53,4 +57,10 @@ void core_manager::register_core(core &c)
 	dprintf("core: register core %u\n", c.id_);
 	cores_[c.id_] = &c;
 	nr_cores_++;
+
+	// The boot core is the one running this, so it can use its per-CPU area straight away.  The
+	// other cores load theirs as they start.
+	if (c.id_ == 0) {
+		c.load_per_cpu();
+	}
 }
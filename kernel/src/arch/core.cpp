@@ -14,6 +14,7 @@
 #include <stacsos/kernel/mem/memory-manager.h>
 #include <stacsos/kernel/mem/page-allocator.h>
 #include <stacsos/kernel/sched/schedulable-entity.h>
+#include <stacsos/kernel/sched/scheduler.h>
 
 using namespace stacsos::kernel::arch;
 using namespace stacsos::kernel::arch::x86;
@@ -21,22 +22,54 @@ using namespace stacsos::kernel::sched;
 using namespace stacsos::kernel::mem;
 using namespace stacsos::kernel;
 
-core &core::this_core()
+static void idle_thread()
 {
-	auto &c = core_manager::get().get_core(core::this_core_id());
-	assert(&c != nullptr);
+	// The idle task never leaves its core, so its per-CPU data can be looked up once.
+	auto &pc = this_cpu(cpu_data);
+	core &c = *pc.this_core;
+
+	while (true) {
+		pc.nr_idle_entries++;
+		c.idle_wait();
 
-	return c;
+		// A core woken by a store to need_resched, rather than an interrupt, has to reschedule
+		// by itself.
+		if (*(volatile bool *)&pc.need_resched) {
+			core::yield();
+		}
+	}
 }
 
-static void idle_thread()
+// The CPU quota that limits TCB, if any.  A deadline task's run time is already bounded by its
+// reservation, and parking it would break that reservation, so quotas only apply to other tasks.
+static inline cpu_quota *quota_of(const tcb &tcb) { return is_deadline(tcb) ? nullptr : tcb.quota; }
+
+// Brings TCB's run time up to NOW, and charges the time to its process's CPU quota.
+static inline void charge_run_time(tcb &tcb, u64 now)
 {
-	while (true) {
-		__relax();
+	u64 delta = now - tcb.start_time;
+	tcb.run_time += delta;
+	tcb.start_time = now;
+
+	if (cpu_quota *q = quota_of(tcb)) {
+		q->charge(delta);
 	}
 }
 
 extern "C" __noreturn void x86_return_to_task();
+extern "C" void x86_switch_context();
+
+// Called by x86_switch_context, with interrupts disabled and the yielding task's context saved.
+extern "C" void x86_yield_schedule() { core::this_core().schedule(true); }
+
+void core::yield()
+{
+	if (this_core().trap_yield_) {
+		asm volatile("int $0xff");
+	} else {
+		x86_switch_context();
+	}
+}
 
 void core::run()
 {
@@ -59,24 +92,660 @@ void core::run()
 	idle_thread_.cr3 = memory_manager::get().root_address_space().pgtable().effective_cr3();
 	idle_thread_.kernel_stack = (u64)idle_thread_stack + PAGE_SIZE;
 
+	current_ = &idle_thread_;
 	set_current_tcb(&idle_thread_);
 
+	run_start_ = __builtin_ia32_rdtsc();
+	idle_thread_.start_time = run_start_;
+
+	rt_sched_.set_timeslice((timeslice_us_ * timestamp_frequency()) / 1000000);
+
 	dprintf("core [%d]: run\n", id());
-	local_timer().start(100); // 100 Hz
+	// The timer is always used in one-shot or deadline mode, and re-armed by every schedule(), so
+	// that sleepers can be woken on time.  The first tick just gets things going.
+	local_timer().start_deadline(__builtin_ia32_rdtsc() + timestamp_frequency() / periodic_tick_frequency);
+
+	if (balance_interval_) {
+		timers_.add(balance_timer_, __builtin_ia32_rdtsc() + balance_period());
+	}
 
 	// This will also enable interrupts, because the IF flag is set in rflags.
 	x86_return_to_task();
 	__unreachable();
 }
 
-void core::schedule()
+bool core::add_to_runqueue(tcb &tcb)
+{
+	bool kick;
+
+	{
+		unique_irq_lock l(runqueue_lock_);
+
+		if (tcb.entity->owning_core() != this) {
+			return false;
+		}
+
+		kick = enqueue(tcb);
+	}
+
+	if (kick) {
+		send_reschedule();
+	}
+
+	return true;
+}
+
+/*
+ * Queues TCB here, or, if its affinity no longer allows this core, on the list of tasks to move
+ * elsewhere.  Returns true if this core needs to reschedule.  Called with the run queue lock held.
+ */
+bool core::enqueue(tcb &tcb)
+{
+	if (!tcb.entity->allowed_on(id_)) {
+		evicted_.push_back(&tcb.evict_link);
+		return true;
+	}
+
+	if (quota_of(tcb) && tcb.quota->throttled()) {
+		parked_.push_back(&tcb.park_link);
+		return false;
+	}
+
+	class_of(tcb).add_to_runqueue(tcb);
+
+	// A core without a tick will not notice the new task by itself, so make it reschedule, which
+	// also restarts the tick if there is now more than one task to share the core.  A deadline or
+	// real-time task that outranks the running one has to get the core straight away.
+	bool preempt = preempts_current(tcb);
+	if (preempt) {
+		nr_rt_preemptions_++;
+	}
+
+	bool kick = tick_stopped_ || preempt;
+	tick_stopped_ = false;
+
+	return kick;
+}
+
+bool core::remove_from_runqueue(tcb &tcb)
+{
+	unique_irq_lock l(runqueue_lock_);
+
+	if (tcb.entity->owning_core() != this) {
+		return false;
+	}
+
+	if (intrusive_list::linked(&tcb.evict_link)) {
+		evicted_.remove(&tcb.evict_link);
+	} else if (intrusive_list::linked(&tcb.park_link)) {
+		parked_.remove(&tcb.park_link);
+	} else {
+		class_of(tcb).remove_from_runqueue(tcb);
+	}
+
+	return true;
+}
+
+/*
+ * Makes TARGET the owner of TCB, which is on neither core's run queue.  Called with both run queue
+ * locks held.
+ */
+void core::migrate(tcb &tcb, core &target)
+{
+	sched_alg_->migrate_out(tcb);
+	tcb.entity->set_owning_core(&target);
+	target.sched_alg_->migrate_in(tcb);
+}
+
+void core::hand_over(tcb &tcb, core &target)
+{
+	if (&target == this) {
+		return;
+	}
+
+	// Both run queues are locked in core ID order, as in pull_task_from().
+	core &first = id_ < target.id_ ? *this : target;
+	core &second = id_ < target.id_ ? target : *this;
+
+	unique_irq_lock l1(first.runqueue_lock_);
+	unique_irq_lock l2(second.runqueue_lock_);
+
+	if (tcb.entity->owning_core() == this) {
+		migrate(tcb, target);
+	}
+}
+
+void core::unpark(const cpu_quota &q)
+{
+	bool kick = false;
+
+	{
+		unique_irq_lock l(runqueue_lock_);
+
+		list_link *link = parked_.first();
+		while (link && !q.throttled()) {
+			list_link *next = parked_.next(link);
+			tcb *t = tcb_from_park_link(link);
+
+			if (t->quota == &q) {
+				parked_.remove(link);
+				kick |= enqueue(*t);
+			}
+
+			link = next;
+		}
+	}
+
+	if (kick) {
+		send_reschedule();
+	}
+}
+
+sched_change_result core::change_affinity(tcb &tcb, u64 mask)
+{
+	{
+		unique_irq_lock l(runqueue_lock_);
+
+		if (tcb.entity->owning_core() != this) {
+			return sched_change_result::not_owner;
+		}
+
+		bool allowed = (mask >> id_) & 1;
+		if (!allowed && is_deadline(tcb)) {
+			return sched_change_result::rejected;
+		}
+
+		tcb.entity->set_affinity(mask);
+
+		if (allowed) {
+			return sched_change_result::ok;
+		}
+
+		// The running task is evicted when it next stops running.
+		auto &cls = class_of(tcb);
+		if (&tcb != current_ && cls.contains(tcb)) {
+			cls.remove_from_runqueue(tcb);
+			evicted_.push_back(&tcb.evict_link);
+		}
+	}
+
+	send_reschedule();
+	return sched_change_result::ok;
+}
+
+/*
+ * Moves the tasks whose affinity no longer allows this core to cores that it does allow.  Only the
+ * running task's kernel stack is in use, so every other task can be moved.
+ */
+void core::push_evicted()
+{
+	while (true) {
+		u64 affinity = 0;
+
+		{
+			unique_irq_lock l(runqueue_lock_);
+
+			for (list_link *link = evicted_.first(); link; link = evicted_.next(link)) {
+				tcb *t = tcb_from_evict_link(link);
+				if (t != current_) {
+					affinity = t->entity->affinity();
+					break;
+				}
+			}
+		}
+
+		if (!affinity) {
+			return;
+		}
+
+		core *target = scheduler::get().select_core(affinity);
+		if (!target || target == this) {
+			return;
+		}
+
+		bool kick = false;
+
+		{
+			// Both run queues are locked in core ID order, as in pull_task_from().  The task may
+			// have been removed while neither was held, so look for it again.
+			core &first = id_ < target->id_ ? *this : *target;
+			core &second = id_ < target->id_ ? *target : *this;
+
+			unique_irq_lock l1(first.runqueue_lock_);
+			unique_irq_lock l2(second.runqueue_lock_);
+
+			for (list_link *link = evicted_.first(); link; link = evicted_.next(link)) {
+				tcb *t = tcb_from_evict_link(link);
+				if (t == current_ || !t->entity->allowed_on(target->id_)) {
+					continue;
+				}
+
+				evicted_.remove(link);
+				migrate(*t, *target);
+				kick = target->enqueue(*t);
+
+				nr_migrations_++;
+				break;
+			}
+		}
+
+		if (kick) {
+			target->send_reschedule();
+		}
+	}
+}
+
+sched_change_result core::change_sched_params(tcb &tcb, const sched_params &params)
+{
+	bool queued;
+
+	{
+		unique_irq_lock l(runqueue_lock_);
+
+		if (tcb.entity->owning_core() != this) {
+			return sched_change_result::not_owner;
+		}
+
+		// Bandwidth is reserved on the task's own core, so a task that is not allowed to run here,
+		// and is waiting to be moved elsewhere, cannot become a deadline task.
+		if (params.policy == sched_policy::deadline && !tcb.entity->allowed_on(id_)) {
+			return sched_change_result::rejected;
+		}
+
+		// Admission control: a deadline task is only accepted if the bandwidth reserved here,
+		// including its own, stays within the limit.
+		u64 old_bw = is_deadline(tcb) ? alg::deadline_scheduler::bandwidth_of(tcb.dl_runtime, tcb.dl_period) : 0;
+		u64 new_bw = params.policy == sched_policy::deadline ? alg::deadline_scheduler::bandwidth_of(params.dl_runtime, params.dl_period) : 0;
+
+		if (new_bw && dl_sched_.bandwidth() - old_bw + new_bw > dl_bandwidth_limit_) {
+			return sched_change_result::rejected;
+		}
+
+		auto &old_class = class_of(tcb);
+		queued = old_class.contains(tcb);
+		if (queued) {
+			old_class.remove_from_runqueue(tcb);
+		}
+
+		// Quotas do not apply to deadline tasks, so one that was parked can be queued straight away.
+		if (params.policy == sched_policy::deadline && intrusive_list::linked(&tcb.park_link)) {
+			parked_.remove(&tcb.park_link);
+			queued = true;
+		}
+
+		dl_sched_.remove_bandwidth(old_bw);
+
+		tcb.policy = params.policy;
+		tcb.rt_priority = params.rt_priority;
+		tcb.nice = params.nice;
+
+		if (params.policy == sched_policy::deadline) {
+			// The task starts with an expired deadline, so it gets a fresh one and a full budget
+			// when it is next queued.
+			tcb.dl_runtime = params.dl_runtime;
+			tcb.dl_period = params.dl_period;
+			tcb.dl_deadline = params.dl_deadline;
+			tcb.dl_abs_deadline = 0;
+			tcb.dl_budget = 0;
+			tcb.dl_sync = tcb.run_time;
+			tcb.dl_throttled = false;
+			tcb.dl_missed = false;
+			tcb.dl_yielded = false;
+
+			dl_sched_.add_bandwidth(new_bw);
+		}
+
+		if (queued) {
+			class_of(tcb).add_to_runqueue(tcb);
+		}
+	}
+
+	// The change may mean that a different task should now be running here.
+	if (queued) {
+		send_reschedule();
+	}
+
+	return sched_change_result::ok;
+}
+
+// Returns true if TCB is a deadline or real-time task that should take this core from the task
+// running on it.  Called with the run queue lock held.
+bool core::preempts_current(const tcb &tcb) const
 {
-	tcb *next = sched_alg_->select_next_task(get_current_tcb());
+	if (current_ == nullptr || current_ == &idle_thread_ || current_ == &tcb) {
+		return false;
+	}
+
+	if (is_deadline(tcb)) {
+		if (tcb.dl_throttled) {
+			return false;
+		}
+
+		return !is_deadline(*current_) || tcb.dl_abs_deadline < current_->dl_abs_deadline;
+	}
+
+	if (!is_realtime(tcb) || is_deadline(*current_)) {
+		return false;
+	}
+
+	return !is_realtime(*current_) || tcb.rt_priority > current_->rt_priority;
+}
+
+void core::schedule(bool voluntary)
+{
+	if (!evicted_.empty()) {
+		push_evicted();
+	}
+
+	// A core that has run out of work tries to take some from the busiest core before going idle.
+	if (nr_runnable() == 0) {
+		core *victim = find_busiest_core();
+		if (victim && pull_task_from(*victim, true)) {
+			nr_steals_++;
+		}
+	}
+
+	unique_irq_lock l(runqueue_lock_);
+
+	u64 now = __builtin_ia32_rdtsc();
+
+	// Bring the current task's run time up to date, so that the algorithm sees time spent since
+	// the last tick (e.g. when the task yields).
+	tcb *current = get_current_tcb();
+	if (current) {
+		charge_run_time(*current, now);
+	}
+
+	// A task whose affinity no longer allows this core leaves the run queue, and is moved elsewhere
+	// once it has stopped running here.  Otherwise, the current task competes in its own class.
+	tcb *queued = current;
+	if (current && current->entity && !current->entity->allowed_on(id_) && class_of(*current).contains(*current)) {
+		class_of(*current).remove_from_runqueue(*current);
+		evicted_.push_back(&current->evict_link);
+		queued = nullptr;
+	}
+
+	// A real-time task that gives up the core goes behind the others at its priority.  A deadline
+	// task that gives up the core has finished its job, so waits for its next period.
+	if (voluntary && queued && is_realtime(*queued)) {
+		rt_sched_.requeue(*queued);
+	} else if (voluntary && queued && is_deadline(*queued)) {
+		dl_sched_.yield(*queued);
+	}
+
+	// Scheduling classes are dispatched strictly in order: real-time tasks only get the core when
+	// no deadline task is runnable, and the selected algorithm only when no real-time task is.  A
+	// task whose process has used up its CPU quota is parked, and the next one chosen instead.
+	tcb *next;
+	while (true) {
+		bool queued_dl = queued && is_deadline(*queued);
+		bool queued_rt = queued && is_realtime(*queued);
+		bool queued_fair = queued && !queued_dl && !queued_rt;
+
+		next = dl_sched_.select_next_task(queued_dl ? queued : nullptr);
+		if (!next) {
+			next = rt_sched_.select_next_task(queued_rt ? queued : nullptr);
+		}
+
+		if (!next) {
+			next = sched_alg_->select_next_task(queued_fair ? queued : nullptr);
+		}
+
+		if (!next || !quota_of(*next) || !next->quota->throttled()) {
+			break;
+		}
+
+		class_of(*next).remove_from_runqueue(*next);
+		parked_.push_back(&next->park_link);
+
+		if (next == queued) {
+			queued = nullptr;
+		}
+	}
+
 	if (!next) {
 		next = &idle_thread_;
 	}
 
+	if (next != current) {
+		if (current) {
+			current->stop_time = now;
+		}
+
+		next->start_time = now;
+		next->last_core = this;
+	}
+
+	// This interrupt is still running on the outgoing task's stack, so that task is pinned here
+	// until the next time this core schedules.
+	previous_ = next != current ? current : nullptr;
+	current_ = next;
+
+	// An interrupt taken while the idle task waits in MWAIT can switch straight to a real task,
+	// and the idle task only clears idle_polling when it runs again.  Until then, cores that want
+	// this one to reschedule must send it an IPI, rather than rely on MWAIT noticing the store.
+	if (next != &idle_thread_) {
+		this_cpu(cpu_data).idle_polling = false;
+	}
+
 	set_current_tcb(next);
+
+	slice_end_ = now + (timeslice_us_ * timestamp_frequency()) / 1000000;
+	program_tick(now);
+
+	if (voluntary) {
+		nr_yields_++;
+	}
+
+	this_cpu(cpu_data).need_resched = false;
+
+	u64 cycles = __builtin_ia32_rdtsc() - now;
+	schedule_calls_++;
+	schedule_cycles_total_ += cycles;
+	if (cycles > schedule_cycles_max_) {
+		schedule_cycles_max_ = cycles;
+	}
+}
+
+/*
+ * Arms the local timer for the next tick, or the earliest software timer if that comes first, so
+ * that sleeping threads wake up on time rather than on the next tick.  With tick=periodic, ticks
+ * keep a fixed rate however often this core schedules in between.  With tick=dynamic, the next tick
+ * is the end of the current timeslice, which is only needed if another task is waiting for this
+ * core, so with a single runnable task, or none, and no pending timers, the tick stops entirely.  Called
+ * with the run queue lock held.
+ */
+void core::program_tick(u64 now)
+{
+	u64 deadline = 0;
+
+	if (!dynamic_tick_) {
+		u64 period = timestamp_frequency() / periodic_tick_frequency;
+		if (next_tick_ <= now) {
+			next_tick_ += ((now - next_tick_) / period + 1) * period;
+		}
+
+		deadline = next_tick_;
+	} else if (nr_runnable() > 1) {
+		deadline = slice_end_;
+
+		// The balancer stops with the tick, so restart it now that there is work to share.
+		if (balance_interval_ && !balance_timer_.pending()) {
+			timers_.add(balance_timer_, now + balance_period());
+		}
+	}
+
+	// Tasks waiting to leave this core are moved by the next call to schedule(), which should come
+	// straight away, unless the only one is still running here.
+	if (evicted_.count() > (intrusive_list::linked(&current_->evict_link) ? 1u : 0u)) {
+		deadline = now;
+	}
+
+	// A task with a CPU quota is stopped as soon as the quota could run out.
+	if (quota_of(*current_) && current_->quota->limited()) {
+		u64 exhausted = now + current_->quota->remaining();
+		if (deadline == 0 || exhausted < deadline) {
+			deadline = exhausted;
+		}
+	}
+
+	// Budgets are enforced, and replenished, on time, rather than at the next tick.
+	u64 dl_event = dl_sched_.next_event(current_, now);
+	if (dl_event && (deadline == 0 || dl_event < deadline)) {
+		deadline = dl_event;
+	}
+
+	// Everything up to here needs a reschedule when it comes round.  A software timer only needs the
+	// interrupt, and the running task carries on unless the timer wakes something.
+	resched_at_ = deadline;
+
+	u64 timer_deadline = timers_.next_expiry();
+	if (timer_deadline && (deadline == 0 || timer_deadline < deadline)) {
+		deadline = timer_deadline;
+	}
+
+	if (deadline == 0) {
+		local_timer().stop();
+		tick_stopped_ = true;
+		return;
+	}
+
+	local_timer().start_deadline(deadline);
+	tick_stopped_ = false;
+}
+
+u64 core::idle_cycles()
+{
+	unique_irq_lock l(runqueue_lock_);
+
+	u64 cycles = idle_thread_.run_time;
+	if (current_ == &idle_thread_) {
+		cycles += __builtin_ia32_rdtsc() - idle_thread_.start_time;
+	}
+
+	return cycles;
+}
+
+bool core::task_in_use(const tcb &tcb)
+{
+	unique_irq_lock l(runqueue_lock_);
+	return current_ == &tcb || previous_ == &tcb;
+}
+
+void core::tick()
+{
+	ticks_++;
+
+	update_accounting();
+
+	unsigned int runnable = nr_runnable();
+
+	u64 now = __builtin_ia32_rdtsc();
+	timers_.run_expired(now);
+
+	// Only reschedule if the current slice is over, or something else program_tick() armed the timer
+	// for is due, or an expired timer made a task runnable here.  A tick that only ran timers leaves
+	// the current task's slice alone.
+	bool due = this_cpu(cpu_data).need_resched || nr_runnable() > runnable || (resched_at_ && now >= resched_at_);
+	if (!due) {
+		unique_irq_lock l(runqueue_lock_);
+		program_tick(__builtin_ia32_rdtsc());
+		return;
+	}
+
+	schedule();
+}
+
+u64 core::balance_period() { return (balance_interval_ * timestamp_frequency()) / periodic_tick_frequency; }
+
+void core::balance_timer_expired(void *arg)
+{
+	core *c = (core *)arg;
+	c->balance_load();
+
+	// With tick=dynamic, balancing stops along with the tick when this core runs out of work to
+	// share, and program_tick() starts it again.
+	if (!c->dynamic_tick_ || c->nr_runnable() > 1) {
+		c->timers_.add(c->balance_timer_, __builtin_ia32_rdtsc() + c->balance_period());
+	}
+}
+
+void core::balance_load()
+{
+	core *busiest = find_busiest_core();
+	if (busiest && busiest->nr_runnable() >= nr_runnable() + 2) {
+		pull_task_from(*busiest, false);
+	}
+
+	// Idle cores have no tick in dynamic mode, so they cannot come looking for work.  Wake one
+	// up to steal from this core instead.
+	if (dynamic_tick_ && nr_runnable() >= 2) {
+		for (auto *c : core_manager::get().cores()) {
+			if (c != this && c->online() && c->idle()) {
+				c->send_reschedule();
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Returns the online core, other than this one, with the most runnable tasks, or nullptr if
+ * every other core has an empty run queue.
+ */
+core *core::find_busiest_core()
+{
+	core *busiest = nullptr;
+
+	for (auto *c : core_manager::get().cores()) {
+		if (c == this || !c->online() || c->nr_runnable() == 0) {
+			continue;
+		}
+
+		if (busiest == nullptr || c->nr_runnable() > busiest->nr_runnable()) {
+			busiest = c;
+		}
+	}
+
+	return busiest;
+}
+
+/*
+ * Moves one task from VICTIM's run queue to this core's.  An IDLE pull only requires this core to
+ * have nothing to run; otherwise the victim must have at least two more runnable tasks than this
+ * core.  Either way, tasks that ran within the migration cost window are left alone.
+ */
+bool core::pull_task_from(core &victim, bool idle)
+{
+	// Both run queues are locked, always in core ID order, so that two cores pulling from each
+	// other cannot deadlock.
+	core &first = id_ < victim.id_ ? *this : victim;
+	core &second = id_ < victim.id_ ? victim : *this;
+
+	unique_irq_lock l1(first.runqueue_lock_);
+	unique_irq_lock l2(second.runqueue_lock_);
+
+	// Check again, now that neither queue can change.
+	if (idle ? nr_runnable() != 0 : victim.nr_runnable() < nr_runnable() + 2) {
+		return false;
+	}
+
+	tcb *candidate = victim.sched_alg_->select_migration_candidate(victim.current_, victim.previous_, id_);
+	if (!candidate) {
+		return false;
+	}
+
+	u64 migration_cost = (migration_cost_us_ * timestamp_frequency()) / 1000000;
+	if (__builtin_ia32_rdtsc() - candidate->stop_time < migration_cost) {
+		return false;
+	}
+
+	victim.sched_alg_->remove_from_runqueue(*candidate);
+	victim.migrate(*candidate, *this);
+	sched_alg_->add_to_runqueue(*candidate);
+
+	nr_migrations_++;
+	return true;
 }
 
 void core::update_accounting()
@@ -85,9 +754,6 @@ void core::update_accounting()
 
 	tcb *current = get_current_tcb();
 	if (current) {
-		u64 now = __builtin_ia32_rdtsc();
-		u64 delta = now - current->start_time;
-		current->run_time += delta;
-		current->start_time = now;
+		charge_run_time(*current, __builtin_ia32_rdtsc());
 	}
 }
@@ -0,0 +1,332 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/arch/core-manager.h>
+#include <stacsos/kernel/arch/core.h>
+#include <stacsos/kernel/arch/ipi.h>
+#include <stacsos/kernel/arch/x86/cregs.h>
+#include <stacsos/kernel/mem/page-table.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::arch;
+using namespace stacsos::kernel::arch::x86;
+
+// The pending TLB invalidation of a core.  Concurrent shootdowns are merged into one range, and
+// each is given a ticket, which the core marks complete once it has flushed.
+struct tlb_shootdown_queue {
+	spinlock_irq lock;
+	u64 start, end;
+	bool pending;
+	u64 sent_at;
+	u64 requested;
+	volatile u64 completed;
+};
+
+DEFINE_PER_CPU(ipi_stats, stacsos::kernel::arch::ipi_statistics);
+static DEFINE_PER_CPU(remote_call *, call_queue);
+static DEFINE_PER_CPU(tlb_shootdown_queue, tlb_queue);
+
+// Kernel mappings are shared by every address space.
+static const u64 kernel_base = 0xffff800000000000ull;
+
+static void record_latency(u64 sent_at)
+{
+	auto &stats = this_cpu(ipi_statistics);
+	u64 latency = __builtin_ia32_rdtsc() - sent_at;
+
+	stats.latency_samples++;
+	stats.latency_total += latency;
+	if (latency > stats.latency_max) {
+		stats.latency_max = latency;
+	}
+}
+
+/*
+ * Pushes C onto TARGET's call queue, and returns true if the queue was empty, in which case the
+ * target needs an IPI to notice it.  Otherwise, the IPI sent for the first request is still to be
+ * handled, and the target will find this one along with it.
+ */
+bool ipi_manager::queue_call(core &target, remote_call *c)
+{
+	remote_call *&head = target.per_cpu(call_queue);
+	remote_call *old = __atomic_load_n(&head, __ATOMIC_RELAXED);
+
+	c->sent_at = __builtin_ia32_rdtsc();
+
+	do {
+		c->next = old;
+	} while (!__atomic_compare_exchange_n(&head, &old, c, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	return old == nullptr;
+}
+
+void ipi_manager::call(core &target, remote_call_fn fn, void *arg, bool wait)
+{
+	u64 flags = irq_save();
+
+	if (&target == &core::this_core()) {
+		fn(arg);
+		irq_restore(flags);
+		return;
+	}
+
+	if (!target.online()) {
+		irq_restore(flags);
+		return;
+	}
+
+	remote_call local;
+	remote_call *c = wait ? &local : new remote_call;
+
+	c->fn = fn;
+	c->arg = arg;
+	c->done = false;
+	c->owned_by_target = !wait;
+
+	if (queue_call(target, c)) {
+		target.send_ipi(ipi_type::call_function);
+	}
+
+	if (wait) {
+		while (!c->done) {
+			poll();
+		}
+	}
+
+	irq_restore(flags);
+}
+
+void ipi_manager::call_others(remote_call_fn fn, void *arg, bool wait)
+{
+	u64 flags = irq_save();
+
+	core &self = core::this_core();
+	remote_call calls[core_manager::max_cores];
+	int nr_calls = 0;
+
+	// Every request is queued before waiting for any of them, so the cores run the call in parallel.
+	for (auto *c : core_manager::get().cores()) {
+		if (c == &self || !c->online()) {
+			continue;
+		}
+
+		remote_call *rc = wait ? &calls[nr_calls++] : new remote_call;
+		rc->fn = fn;
+		rc->arg = arg;
+		rc->done = false;
+		rc->owned_by_target = !wait;
+
+		if (queue_call(*c, rc)) {
+			c->send_ipi(ipi_type::call_function);
+		}
+	}
+
+	for (int i = 0; i < nr_calls; i++) {
+		while (!calls[i].done) {
+			poll();
+		}
+	}
+
+	irq_restore(flags);
+}
+
+void ipi_manager::handle_calls()
+{
+	remote_call *list = __atomic_exchange_n(&this_cpu(call_queue), nullptr, __ATOMIC_ACQUIRE);
+
+	// The queue is a stack, so reverse it to make the calls in the order they were made.
+	remote_call *fifo = nullptr;
+	while (list) {
+		remote_call *next = list->next;
+		list->next = fifo;
+		fifo = list;
+		list = next;
+	}
+
+	while (fifo) {
+		remote_call *c = fifo;
+		fifo = c->next;
+
+		record_latency(c->sent_at);
+		this_cpu(ipi_statistics).calls++;
+
+		// A synchronous request lives on its caller's stack, and must not be touched once it is
+		// marked done.
+		bool owned = c->owned_by_target;
+		c->fn(c->arg);
+
+		if (owned) {
+			delete c;
+		} else {
+			__atomic_store_n(&c->done, true, __ATOMIC_RELEASE);
+		}
+	}
+}
+
+static void invalidate_local(u64 start, u64 end)
+{
+	auto &stats = this_cpu(ipi_statistics);
+	u64 nr_pages = (end - start) >> PAGE_BITS;
+
+	if (nr_pages <= ipi_manager::max_flush_pages) {
+		for (u64 va = start; va < end; va += PAGE_SIZE) {
+			mem::page_table::flush(va);
+		}
+
+		stats.pages_flushed += nr_pages;
+		return;
+	}
+
+	// Reloading CR3 keeps global (kernel) mappings, so those need global pages toggled off and on.
+	if (end > kernel_base) {
+		auto flags = cr4::read();
+		cr4::write(flags & ~cr4_flags::PGE);
+		cr4::write(flags);
+	} else {
+		cr3::write(cr3::read());
+	}
+
+	stats.full_flushes++;
+}
+
+void ipi_manager::handle_tlb_shootdown()
+{
+	auto &q = this_cpu(tlb_queue);
+	u64 start, end, ticket;
+
+	{
+		unique_irq_lock l(q.lock);
+
+		if (!q.pending) {
+			return;
+		}
+
+		start = q.start;
+		end = q.end;
+		ticket = q.requested;
+		q.pending = false;
+
+		record_latency(q.sent_at);
+	}
+
+	invalidate_local(start, end);
+	this_cpu(ipi_statistics).shootdowns++;
+
+	__atomic_store_n(&q.completed, ticket, __ATOMIC_RELEASE);
+}
+
+void ipi_manager::flush_tlb(u64 cr3, u64 start, u64 end)
+{
+	start = PAGE_ALIGN_DOWN(start);
+	end = PAGE_ALIGN_UP(end);
+
+	if (start >= end) {
+		return;
+	}
+
+	bool kernel = end > kernel_base;
+
+	u64 flags = irq_save();
+
+	// The page table changes must be visible before deciding which cores need telling: a core that
+	// switches to this address space afterwards loads CR3 after the changes, so its TLB is clean.
+	__sync_synchronize();
+
+	core &self = core::this_core();
+	if (kernel || this_cpu(cpu_data).active_cr3 == cr3) {
+		invalidate_local(start, end);
+	}
+
+	core *targets[core_manager::max_cores];
+	u64 tickets[core_manager::max_cores];
+	int nr_targets = 0;
+
+	for (auto *c : core_manager::get().cores()) {
+		if (c == &self || !c->online()) {
+			continue;
+		}
+
+		if (!kernel && c->per_cpu(cpu_data).active_cr3 != cr3) {
+			continue;
+		}
+
+		auto &q = c->per_cpu(tlb_queue);
+		bool send;
+
+		{
+			unique_irq_lock l(q.lock);
+
+			send = !q.pending;
+			if (send) {
+				q.start = start;
+				q.end = end;
+				q.pending = true;
+				q.sent_at = __builtin_ia32_rdtsc();
+			} else {
+				q.start = start < q.start ? start : q.start;
+				q.end = end > q.end ? end : q.end;
+			}
+
+			tickets[nr_targets] = ++q.requested;
+		}
+
+		targets[nr_targets++] = c;
+
+		if (send) {
+			c->send_ipi(ipi_type::tlb_shootdown);
+		}
+	}
+
+	for (int i = 0; i < nr_targets; i++) {
+		auto &q = targets[i]->per_cpu(tlb_queue);
+
+		while (q.completed < tickets[i]) {
+			poll();
+		}
+	}
+
+	irq_restore(flags);
+}
+
+// Handles this core's own requests while it waits on another core.
+void ipi_manager::poll()
+{
+	if (__atomic_load_n(&this_cpu(call_queue), __ATOMIC_RELAXED)) {
+		handle_calls();
+	}
+
+	handle_tlb_shootdown();
+	__relax();
+}
+
+void tlb_batch::add(u64 cr3, u64 virtual_address)
+{
+	u64 start = PAGE_ALIGN_DOWN(virtual_address);
+
+	if (flushes_on_add(cr3)) {
+		flush();
+	}
+
+	if (start_ >= end_) {
+		cr3_ = cr3;
+		start_ = start;
+		end_ = start + PAGE_SIZE;
+	} else {
+		start_ = start < start_ ? start : start_;
+		end_ = start + PAGE_SIZE > end_ ? start + PAGE_SIZE : end_;
+	}
+}
+
+void tlb_batch::flush()
+{
+	if (start_ < end_) {
+		ipi_manager::get().flush_tlb(cr3_, start_, end_);
+	}
+
+	start_ = end_ = 0;
+}
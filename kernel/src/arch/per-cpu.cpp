@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/arch/core.h>
+#include <stacsos/kernel/arch/per-cpu.h>
+#include <stacsos/kernel/mem/memory-manager.h>
+#include <stacsos/kernel/mem/page-allocator.h>
+#include <stacsos/memops.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel::arch;
+using namespace stacsos::kernel::mem;
+
+DEFINE_PER_CPU(per_cpu_data, stacsos::kernel::arch::cpu_data);
+
+extern "C" char _PERCPU_START, _PERCPU_END;
+
+u64 stacsos::kernel::arch::allocate_per_cpu_area(core &c)
+{
+	u64 size = &_PERCPU_END - &_PERCPU_START;
+
+	int order = 0;
+	while ((PAGE_SIZE << order) < size) {
+		order++;
+	}
+
+	// Each area starts on a new page, so per-CPU variables of different cores never share a cache
+	// line.
+	page *pg = memory_manager::get().pgalloc().allocate_pages(order);
+	if (!pg) {
+		panic("unable to allocate a per-CPU area of order %d", order);
+	}
+
+	void *area = pg->base_address_ptr();
+	memops::memcpy(area, &_PERCPU_START, size);
+
+	u64 offset = (uintptr_t)area - (uintptr_t)&_PERCPU_START;
+	((per_cpu_data *)((uintptr_t)&cpu_data + offset))->this_core = &c;
+
+	return offset;
+}
@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/arch/x86/ioapic.h>
+#include <stacsos/kernel/arch/x86/irq/threaded-irq.h>
+#include <stacsos/kernel/arch/x86/x86-core.h>
+#include <stacsos/kernel/arch/x86/x86-platform.h>
+
+using namespace stacsos::kernel::arch::x86;
+using namespace stacsos::kernel::arch::x86::irq;
+using namespace stacsos::kernel::sched;
+
+void threaded_irq::attach(u32 phys_irq_nr, x86_core &target) { x86_platform::get().get_ioapic()->allocate_physical_irq(phys_irq_nr, target, handle_irq, this); }
+
+void threaded_irq::handle_irq(u8 irq, void *mcontext, void *arg)
+{
+	threaded_irq *ti = (threaded_irq *)arg;
+	ti->nr_interrupts_++;
+
+	bool wake = ti->top_half_(ti->arg_);
+
+	// The device has been dealt with, so further interrupts can be taken while the threaded
+	// handler runs.
+	((x86_core &)core::this_core()).lapic().eoi();
+
+	if (wake) {
+		workqueue::get().queue(ti->work_);
+	}
+}
+
+void threaded_irq::thread_fn_trampoline(void *arg)
+{
+	threaded_irq *ti = (threaded_irq *)arg;
+	ti->nr_threaded_runs_++;
+
+	ti->thread_fn_(ti->arg_);
+}
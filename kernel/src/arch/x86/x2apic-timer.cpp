@@ -5,27 +5,54 @@
  * Copyright (c) University of St Andrews 2024
  * Tom Spink <tcs6@st-andrews.ac.uk>
  */
+#include <stacsos/kernel/arch/x86/cpuid.h>
 #include <stacsos/kernel/arch/x86/machine-context.h>
 #include <stacsos/kernel/arch/x86/x2apic-timer.h>
 #include <stacsos/kernel/arch/x86/x2apic.h>
 #include <stacsos/kernel/arch/x86/x86-core.h>
 #include <stacsos/kernel/debug.h>
-#include <stacsos/kernel/sched/sleeper.h>
 
 using namespace stacsos::kernel;
 using namespace stacsos::kernel::arch::x86;
-using namespace stacsos::kernel::sched;
 
 void x2apic_timer::timer_irq_handler(u8 irq, void *context, void *arg)
 {
 	x2apic_timer *timer = (x2apic_timer *)arg;
-	timer->lapic_.owner().update_accounting();
 
-	sleeper::get().check_wakeup();
+	timer->lapic_.owner().tick();
+	timer->lapic_.eoi();
+}
+
+void x2apic_timer::init()
+{
+	lapic_.set_timer_irq(lapic_.owner().irqmgr().allocate_irq(timer_irq_handler, this));
 
-	timer->lapic_.owner().schedule();
+	cpuid c;
+	c.initialise();
 
-	timer->lapic_.eoi();
+	use_tsc_deadline_ = c.get_feature(cpuid_features::tscdeadline);
+	dprintf("x2apic-timer: deadlines use %s mode\n", use_tsc_deadline_ ? "tsc-deadline" : "one-shot");
 }
 
-void x2apic_timer::init() { lapic_.set_timer_irq(lapic_.owner().irqmgr().allocate_irq(timer_irq_handler, this)); }
+void x2apic_timer::start_deadline(u64 timestamp)
+{
+	if (use_tsc_deadline_) {
+		if (!deadline_mode_) {
+			lapic_.set_timer_tsc_deadline();
+			lapic_.unmask_interrupts(x2apic_lvts::timer);
+
+			// The mode change must be visible before the deadline is written.
+			asm volatile("mfence" ::: "memory");
+			deadline_mode_ = true;
+		}
+
+		// A deadline of zero would disarm the timer, rather than fire immediately.
+		lapic_.set_tsc_deadline(timestamp ? timestamp : 1);
+		return;
+	}
+
+	auto &tsc = lapic_.owner().local_tsc();
+	u64 now = tsc.read();
+
+	start_one_shot(timestamp > now ? tsc.cycles_to_ns(timestamp - now) : 0);
+}
@@ -5,12 +5,15 @@
  * Copyright (c) University of St Andrews 2024
  * Tom Spink <tcs6@st-andrews.ac.uk>
  */
+#include <stacsos/kernel/arch/core-manager.h>
+#include <stacsos/kernel/arch/x86/cpuid.h>
 #include <stacsos/kernel/arch/x86/cregs.h>
 #include <stacsos/kernel/arch/x86/msr.h>
 #include <stacsos/kernel/arch/x86/pit.h>
 #include <stacsos/kernel/arch/x86/x86-core.h>
 #include <stacsos/kernel/debug.h>
 #include <stacsos/kernel/mem/memory-manager.h>
+#include <stacsos/kernel/sched/process.h>
 #include <stacsos/kernel/sched/thread.h>
 #include <stacsos/memops.h>
 
@@ -28,24 +31,22 @@ void x86_core::init()
 	// Populate the descriptor tables (GDT, IDT, TSS)
 	populate_dt();
 
-	// Initialise the local timestamp counter
-	tsc_.calibrate();
+	// Initialise the local timestamp counter.  The counters on every core run at the same rate, so
+	// only the boot core calibrates its own, and the others take its frequency.  Calibrating each
+	// one against the PIT would give every core a slightly different idea of a nanosecond, and time
+	// converted on one core would not agree with time converted on another.
+	auto &boot_core = core_manager::get().get_boot_core();
+	if (this == &boot_core) {
+		tsc_.calibrate();
+	} else {
+		tsc_.calibrate_from(((x86_core &)boot_core).local_tsc());
+	}
 
 	// Initialise the Local APIC, and the Local APIC timer.
 	lapic_.init();
 	timer_.init();
 
-	// Create a temporary TCB so we can take the first interrupt.  This is needed
-	// because the IRQ handling code needs somewhere to store a pointer to the saved
-	// context.
-	temporary_tcb.context_ptr = 0;
-	temporary_tcb.task_ptr = 0;
-	temporary_tcb.cr3 = 0;
-	temporary_tcb.kernel_stack = 0;
-
-	// Pop a pointer to this temporary TCB into GS.  It's not a /real/ tcb structure,
-	// so we can't use set_current_tcb.
-	gsbase::write((u64)&temporary_tcb);
+	select_idle_mode();
 
 	for (int i = 0; i < 32; i++) {
 		irqs_.assign_irq(i, exception_handler, this);
@@ -57,10 +58,18 @@ void x86_core::init()
 	msrs::ia32_fmask = (u64)(1 << 9); // Disable interrupts on entry to system call
 }
 
-void x86_core::set_current_tcb(const stacsos::kernel::sched::tcb *tcb)
+void x86_core::set_current_tcb(stacsos::kernel::sched::tcb *tcb)
 {
 	// TODO: Check if TCB is changing...
 
+	// The TCB leads back to this core's per-CPU data.
+	tcb->per_cpu_offset = per_cpu_offset();
+	this_cpu(cpu_data).current = tcb;
+
+	// Shootdowns for an address space go to the cores that have it loaded.  This is published before
+	// CR3 is written, which serialises, so a shootdown that misses this core cannot leave it stale.
+	this_cpu(cpu_data).active_cr3 = tcb->cr3;
+
 	// A pointer to the current TCB is held in the GS register.
 	gsbase::write((u64)tcb);
 
@@ -71,14 +80,155 @@ void x86_core::set_current_tcb(const stacsos::kernel::sched::tcb *tcb)
 	tss_.set_kernel_stack(tcb->kernel_stack);
 }
 
-stacsos::kernel::sched::tcb *x86_core::get_current_tcb() { return (stacsos::kernel::sched::tcb *)gsbase::read(); }
+void x86_core::load_per_cpu()
+{
+	// Until this core runs its first task, a temporary TCB stands in for one.  This is needed because
+	// the IRQ handling code needs somewhere to store a pointer to the saved context, and it also
+	// leads to the per-CPU area.  It's not a /real/ tcb, so we can't use set_current_tcb.
+	memops::bzero(&temporary_tcb, sizeof(temporary_tcb));
+	temporary_tcb.per_cpu_offset = per_cpu_offset();
 
+	gsbase::write((u64)&temporary_tcb);
+}
+
+// Only used with yield=trap.  Otherwise, core::yield() switches directly.
 static void yield_handler(u8 irq_nr, void *mcontext, void *arg)
 {
 	x86_core *c = (x86_core *)arg;
+	c->schedule(true);
+}
+
+static void reschedule_handler(u8 irq_nr, void *mcontext, void *arg)
+{
+	x86_core *c = (x86_core *)arg;
+	this_cpu(cpu_data).nr_resched_ipis++;
+	this_cpu(ipi_statistics).received[(int)ipi_type::reschedule]++;
+
+	c->lapic().eoi();
 	c->schedule();
 }
 
+static void call_function_handler(u8 irq_nr, void *mcontext, void *arg)
+{
+	x86_core *c = (x86_core *)arg;
+	this_cpu(ipi_statistics).received[(int)ipi_type::call_function]++;
+
+	c->lapic().eoi();
+	ipi_manager::get().handle_calls();
+}
+
+static void tlb_shootdown_handler(u8 irq_nr, void *mcontext, void *arg)
+{
+	x86_core *c = (x86_core *)arg;
+	this_cpu(ipi_statistics).received[(int)ipi_type::tlb_shootdown]++;
+
+	c->lapic().eoi();
+	ipi_manager::get().handle_tlb_shootdown();
+}
+
+void x86_core::send_ipi(ipi_type type)
+{
+	static const u8 vectors[] = { reschedule_irq, call_function_irq, tlb_shootdown_irq };
+
+	u64 flags = irq_save();
+
+	this_cpu(ipi_statistics).sent[(int)type]++;
+	this_core().lapic().send_ipi(apic_id_, vectors[(int)type]);
+
+	irq_restore(flags);
+}
+
+void x86_core::send_reschedule()
+{
+	auto &pc = per_cpu(cpu_data);
+
+	// A core idling in MWAIT is watching need_resched, so the store alone wakes it.  The store is
+	// made visible before idle_polling is checked, and the idle task sets idle_polling before it
+	// checks need_resched, so one side always sees the other.
+	*(volatile bool *)&pc.need_resched = true;
+	__sync_synchronize();
+
+	if (*(volatile bool *)&pc.idle_polling) {
+		return;
+	}
+
+	send_ipi(ipi_type::reschedule);
+}
+
+/*
+ * Chooses how the idle task waits, from the "idle" option: "poll" spins, "hlt" halts until the next
+ * interrupt, and "mwait" also wakes on a store to need_resched, so that waking an idle core needs no
+ * IPI.  By default, MWAIT is used when the processor supports it.
+ */
+void x86_core::select_idle_mode()
+{
+	cpuid c;
+	c.initialise();
+
+	bool have_mwait = c.get_feature(cpuid_features::monitor);
+
+	const char *mode = config::get().get_option("idle");
+	if (!mode || *mode == 0) {
+		idle_mode_ = have_mwait ? idle_mode::mwait : idle_mode::hlt;
+	} else if (memops::strcmp(mode, "poll") == 0) {
+		idle_mode_ = idle_mode::poll;
+	} else if (memops::strcmp(mode, "hlt") == 0) {
+		idle_mode_ = idle_mode::hlt;
+	} else if (memops::strcmp(mode, "mwait") == 0) {
+		if (!have_mwait) {
+			dprintf("core [%d]: mwait is not supported, using hlt\n", id());
+		}
+
+		idle_mode_ = have_mwait ? idle_mode::mwait : idle_mode::hlt;
+	} else {
+		panic("Unsupported idle mode '%s'", mode);
+	}
+}
+
+void x86_core::idle_wait()
+{
+	auto &pc = this_cpu(cpu_data);
+	volatile bool &need_resched = pc.need_resched;
+
+	switch (idle_mode_) {
+	case idle_mode::poll:
+		__relax();
+		break;
+
+	case idle_mode::hlt:
+		// STI only takes effect after the next instruction, so an interrupt that arrives after the
+		// check is taken once HLT has started, and wakes it.
+		asm volatile("cli");
+		if (!need_resched) {
+			asm volatile("sti; hlt");
+		} else {
+			asm volatile("sti");
+		}
+		break;
+
+	case idle_mode::mwait:
+		asm volatile("cli");
+
+		pc.idle_polling = true;
+		__sync_synchronize();
+
+		// Any store to the monitored line after MONITOR makes MWAIT return straight away.
+		asm volatile("monitor" ::"a"(&pc.need_resched), "c"(0), "d"(0));
+		if (!need_resched) {
+			asm volatile("sti; mwait" ::"a"(0), "c"(0));
+		} else {
+			asm volatile("sti");
+		}
+
+		pc.idle_polling = false;
+
+		if (need_resched) {
+			pc.nr_poll_wakeups++;
+		}
+		break;
+	}
+}
+
 void x86_core::populate_dt()
 {
 	// Populate the GDT, with a NULL entry, then CODE and DATA segments for KERNEL and USER mode respectively.
@@ -99,42 +249,78 @@ void x86_core::populate_dt()
 
 	// The IRQ manager takes care of the IDT
 	irqs_.initialise();
-	irqs_.reserve_irq(0xff, yield_handler, this);
+	irqs_.reserve_irq(yield_irq, yield_handler, this);
+	irqs_.reserve_irq(reschedule_irq, reschedule_handler, this);
+	irqs_.reserve_irq(call_function_irq, call_function_handler, this);
+	irqs_.reserve_irq(tlb_shootdown_irq, tlb_shootdown_handler, this);
 
 	// The TSS is needed for swapping stacks if we're going into USER mode.
 	tss_.set_kernel_stack(0);
 	tss_.reload(0x28);
 }
 
-bool x86_core::remote_run() { return false; }
-
-#if 0
 struct mpstartup_data {
 	u64 mpready;
+	u64 mpcr4;
 	u64 mpcr3;
 	x86_core *core_obj;
 	void *mpstack;
-	void (stacsos::kernel::arch::x86::x86_core::*trampoline)(void);
 } __packed;
 
-extern "C" char _MPSTARTUP_START, _MPSTARTUP_END, _MPSTARTUP_SIZE;
-extern "C" mpstartup_data _MPSTARTUP_DATA;
+extern "C" char _MPSTARTUP_START, _MPSTARTUP_END, _MPSTARTUP_DATA;
+
+// The physical address the startup trampoline is copied to.  This must agree with MP_BASE in
+// mpstartup.S.
+static const u64 mpstartup_base = 0x8000;
+
+// The startup page tables, built in start32.S.  The lower (identity) mapping is removed once the
+// boot core is running, but the trampoline needs it back while an AP enters long mode.
+static const u64 boot_pml4 = 0x101000;
+static const u64 boot_pdp_lo = 0x102000;
+
+static const int mpstartup_stack_order = 2;
+
+static volatile mpstartup_data *get_mpstartup_data()
+{
+	return (volatile mpstartup_data *)phys_to_virt(mpstartup_base + (&_MPSTARTUP_DATA - &_MPSTARTUP_START));
+}
+
+extern "C" __noreturn void x86_ap_start(x86_core *c)
+{
+	// The core ID lives in TSC_AUX, for RDTSCP and RDPID.
+	msrs::ia32_tsc_aux = c->id();
+	c->load_per_cpu();
+
+	c->complete_remote_init();
+	__unreachable();
+}
 
 bool x86_core::remote_run()
 {
 	auto &me = this_core();
 
-	pfn_t mpstart_pfn = prepare_mpstartup_code();
+	// The startup stack.  It is abandoned once the core starts running tasks.
+	page *stack = memory_manager::get().pgalloc().allocate_pages(mpstartup_stack_order);
+	if (!stack) {
+		dprintf("core [%d] unable to allocate startup stack\n", id());
+		return false;
+	}
+
+	u8 mpstart_pfn = prepare_mpstartup_code();
 
 	// Acquire a pointer to the mp startup data structure, which we need to fill in.  It should
 	// be volatile, so that we can check the mpready flag without worrying that the compiler
 	// optimises "redundant checks" away.
-	volatile mpstartup_data *d = (volatile mpstartup_data *)&_MPSTARTUP_DATA;
+	volatile mpstartup_data *d = get_mpstartup_data();
 	d->mpready = 0; // Is the core ready?
-	d->mpcr3 = __read_cr3(); // The pages tables to provide the core with (just the same as this core's)
+	d->mpcr4 = (u64)cr4::read(); // The same features as this core
+	d->mpcr3 = memory_manager::get().root_address_space().pgtable().effective_cr3(); // The kernel page tables
 	d->core_obj = this; // A pointer to the core object that is coming online
-	d->mpstack = (void *)(((u64) new char[0x1000]) + 0x1000); // A temporary stack (which we need to remember to free at some point)
-	d->trampoline = &exegol::arch::x86::x86_core::complete_remote_init; // The function to call once we've gotten into 64-bit mode
+	d->mpstack = (void *)((u64)stack->base_address_ptr() + (PAGE_SIZE << mpstartup_stack_order)); // The top of the startup stack
+
+	// Restore the identity mapping in the startup page tables.
+	u64 *pml4 = (u64 *)phys_to_virt(boot_pml4);
+	pml4[0] = boot_pdp_lo | 3;
 
 	// Stick in a full memory fence, just to be safe.
 	asm volatile("mfence" ::: "memory");
@@ -142,53 +328,53 @@ bool x86_core::remote_run()
 	// The sequence is INIT --> SIPI (--> SIPI)
 
 	// Send the INIT
-	me.lapic_.send_remote_init(id());
+	me.lapic_.send_remote_init(apic_id_);
 	me.tsc_.spin(10); // Wait for 10ms...
 
 	// Send the SIPI
-	me.lapic_.send_remote_sipi(id(), mpstart_pfn);
+	me.lapic_.send_remote_sipi(apic_id_, mpstart_pfn);
 	me.tsc_.spin(1); // Wait for 1ms...
 
-	// If the core didn't come online, send another SIPI and give it a second
+	// If the core didn't come online, send another SIPI.  A core that has already started ignores it.
 	if (!d->mpready) {
-		me.lapic_.send_remote_sipi(id(), mpstart_pfn);
-		me.tsc_.spin(1000); // 1s
+		me.lapic_.send_remote_sipi(apic_id_, mpstart_pfn);
 	}
 
+	// Give the core a second to initialise itself.  Cores are brought up one at a time, because
+	// initialisation calibrates against the (shared) PIT.
+	u64 deadline = me.tsc_.read() + me.tsc_.frequency();
+	while (!d->mpready && me.tsc_.read() < deadline) {
+		__relax();
+	}
+
+	// The core has switched to the kernel page tables by the time it reports ready, so the identity
+	// mapping can go again.
+	pml4[0] = 0;
+
 	// Return whether or not the core came online.
 	return !!d->mpready;
 }
 
-pfn_t x86_core::prepare_mpstartup_code()
+u8 x86_core::prepare_mpstartup_code()
 {
-	// This function is a total hack.  It just brutally copies the mp startup code and data into an arbitrary page,
-	// because we can only access PFNs < 0x100 when initialising other processors.
-
-	pfn_t target_pfn = 0; // Let's go for page 0.  The mp startup assembly is written to
-						  // work in page 0 -- there is one place where a relative address
-						  // computation is made, which assumes we're running in page zero.
+	// Copy the mp startup code and data into low memory, because an AP starts in real mode and
+	// can only be pointed at a page below 1M.  The lower 1M is never handed out by the page allocator.
+	memops::memcpy(phys_to_virt(mpstartup_base), &_MPSTARTUP_START, &_MPSTARTUP_END - &_MPSTARTUP_START);
 
-	// Copy the mp startup assembly into the right place.  Technically, we only need the 16-bit
-	// code, because once we jump into 32-bit mode, we're actually executing at normal addresses.
-	void *target_addr = (void *)(target_pfn << PAGE_BITS);
-	memops::memcpy(target_addr, (void *)&_MPSTARTUP_START, (size_t)&_MPSTARTUP_SIZE);
-
-	// We really need to remember to unmap page zero later...
-	return target_pfn;
+	return (u8)(mpstartup_base >> PAGE_BITS);
 }
 
 void x86_core::complete_remote_init()
 {
-	// Update the TSC aux MSR with the core ID, so that the rdpid instruction works.
-	msr::write(msr_indicies::IA32_TSC_AUX, id());
-
 	dprintf("core [%d] online\n", id());
 
-	// Initialise and run this new core.
+	// Initialise this core, then tell the bootstrap core that we're ready before running.
 	init();
+
+	get_mpstartup_data()->mpready = 1;
+
 	run();
 }
-#endif
 
 void x86_core::handle_gpf(machine_context *mc)
 {
@@ -202,7 +388,24 @@ void x86_core::handle_gpf(machine_context *mc)
 
 void x86_core::handle_page_fault(machine_context *mc)
 {
-	if (memory_manager::get().try_handle_page_fault(cr2::read())) {
+	u64 faulting_address = cr2::read();
+
+	// Handling a fault may wait for locks, and for other cores to flush their TLBs, so it runs with
+	// interrupts enabled if the faulting code had them.  Any interrupt taken meanwhile replaces the
+	// saved context pointer in the TCB, so it is put back before returning.
+	bool irqs = mc->rflags & 0x200;
+	if (irqs) {
+		asm volatile("sti");
+	}
+
+	bool handled = memory_manager::get().try_handle_page_fault(thread::current().owner().addrspace(), faulting_address);
+
+	if (irqs) {
+		asm volatile("cli");
+		this_cpu(cpu_data).current->mcontext = mc;
+	}
+
+	if (handled) {
 		return;
 	}
 
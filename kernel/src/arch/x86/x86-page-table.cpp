@@ -5,12 +5,14 @@
  * Copyright (c) University of St Andrews 2024
  * Tom Spink <tcs6@st-andrews.ac.uk>
  */
+#include <stacsos/kernel/arch/ipi.h>
 #include <stacsos/kernel/arch/x86/x86-page-table.h>
 #include <stacsos/kernel/mem/memory-manager.h>
 #include <stacsos/kernel/mem/page-table-allocator.h>
 #include <stacsos/kernel/mem/page.h>
 
 using namespace stacsos::kernel::mem;
+using namespace stacsos::kernel::arch;
 using namespace stacsos::kernel::arch::x86;
 
 static u16 pt_index(u64 address) { return (address >> PAGE_BITS) & 0x1ff; }
@@ -119,6 +121,41 @@ void x86_page_table::map(page_table_allocator &pta, u64 virtual_address, u64 phy
 	l1.us(user);
 }
 
+void x86_page_table::unmap(page_table_allocator &pta, u64 virtual_address)
+{
+	pte *l1 = get_pte(virtual_address);
+	if (!l1) {
+		return;
+	}
+
+	l1->reset();
+	ipi_manager::get().flush_tlb(effective_cr3(), virtual_address, virtual_address + PAGE_SIZE);
+}
+
+/**
+ * Walks the page table and returns the 4k leaf entry for the given virtual address, or nullptr if
+ * an intermediate level is not present, or the address is covered by a large mapping.
+ */
+pte *x86_page_table::get_pte(u64 virtual_address)
+{
+	pml4e &l4 = pml4_[pml4_index(virtual_address)];
+	if (!l4.present()) {
+		return nullptr;
+	}
+
+	pdpe &l3 = (*(pdp *)page::get_from_base_address(l4.base_address()).base_address_ptr())[pdp_index(virtual_address)];
+	if (!l3.present() || l3.size()) {
+		return nullptr;
+	}
+
+	pde &l2 = (*(pd *)page::get_from_base_address(l3.base_address()).base_address_ptr())[pd_index(virtual_address)];
+	if (!l2.present() || l2.size()) {
+		return nullptr;
+	}
+
+	return &(*(pt *)page::get_from_base_address(l2.base_address()).base_address_ptr())[pt_index(virtual_address)];
+}
+
 void x86_page_table::dump() const
 {
 	dprintf("vma @ %p (%p)\n", this, this);
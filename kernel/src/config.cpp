@@ -47,6 +47,41 @@ void config::init(const char *cmdline)
 	add_option(kp, vp);
 }
 
+/**
+ * Returns the value of the named option parsed as an unsigned integer, or DFL if the option is not present
+ * or is not a valid number.  Values prefixed with 0x are parsed as hexadecimal.
+ */
+u64 config::get_option_u64_or_default(const char *name, u64 dfl) const
+{
+	const char *value = get_option(name);
+	if (!value || !*value) {
+		return dfl;
+	}
+
+	u64 base = 10;
+	if (value[0] == '0' && value[1] == 'x') {
+		base = 16;
+		value += 2;
+	}
+
+	u64 result = 0;
+	while (*value) {
+		u64 digit;
+		if (*value >= '0' && *value <= '9') {
+			digit = *value - '0';
+		} else if (base == 16 && *value >= 'a' && *value <= 'f') {
+			digit = *value - 'a' + 10;
+		} else {
+			return dfl;
+		}
+
+		result = (result * base) + digit;
+		value++;
+	}
+
+	return result;
+}
+
 void config::add_option(const char *key, const char *value)
 {
 	options_[nr_options_].key = key;
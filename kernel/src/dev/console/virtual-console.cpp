@@ -137,7 +137,8 @@ void virtual_console::on_key_down(keys key)
 
 	read_buffer_[read_buffer_tail_++] = ch;
 	read_buffer_tail_ %= ARRAY_SIZE(read_buffer_);
-	read_buffer_event_.trigger();
+	// Only one reader can take the character.
+	read_buffer_event_.wake_one();
 }
 
 static u32 vga_colour_map[] = {
@@ -353,9 +354,7 @@ void virtual_console::update_cursor()
 
 u8 virtual_console::read_char()
 {
-	while (read_buffer_head_ == read_buffer_tail_) {
-		read_buffer_event_.wait();
-	}
+	read_buffer_event_.wait_event([this] { return read_buffer_head_ != read_buffer_tail_; });
 
 	u8 elem = read_buffer_[read_buffer_head_];
 
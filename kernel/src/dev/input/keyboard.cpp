@@ -7,11 +7,9 @@
  */
 #include <stacsos/kernel/arch/core-manager.h>
 #include <stacsos/kernel/arch/core.h>
-#include <stacsos/kernel/arch/x86/ioapic.h>
 #include <stacsos/kernel/arch/x86/pio.h>
 #include <stacsos/kernel/arch/x86/x2apic.h>
 #include <stacsos/kernel/arch/x86/x86-core.h>
-#include <stacsos/kernel/arch/x86/x86-platform.h>
 #include <stacsos/kernel/debug.h>
 #include <stacsos/kernel/dev/input/keyboard.h>
 
@@ -24,23 +22,41 @@ device_class keyboard::keyboard_device_class(device_class::root, "kbd");
 
 void keyboard::configure()
 {
-	// irq_ = core_manager::get().get_boot_core().irqs().request_irq();
-	// irq_->attach(keyboard_irq_handler, this);
-
-	// we've requested an irq from the boot core, to handle the keyboard interrupt
-	// now we need to map it to the physical irq
-	x86_platform::get().get_ioapic()->allocate_physical_irq(1, (x86_core &)core_manager::get().get_boot_core(), keyboard_irq_handler, this);
+	// The keyboard interrupt is routed to the boot core.  Its handler only reads the key event
+	// from the controller: the listeners are called from the boot core's worker thread.
+	irq_.attach(1, (x86_core &)core_manager::get().get_boot_core());
 }
 
-void keyboard::keyboard_irq_handler(u8 irq, void *ctx, void *arg)
+bool keyboard::keyboard_irq_top_half(void *arg)
 {
 	keyboard *device = (keyboard *)arg;
 
+	// Reading the event acknowledges it, so it must be read even if there is no room for it.
 	u8 key_event_data = ioports::keyboard_controller::read8();
 
-	device->handle_key_event(key_event_data);
+	unsigned int head = device->event_head_;
+	if (head - __atomic_load_n(&device->event_tail_, __ATOMIC_ACQUIRE) >= event_buffer_size) {
+		device->nr_dropped_events_++;
+		return true;
+	}
+
+	device->event_buffer_[head % event_buffer_size] = key_event_data;
+	__atomic_store_n(&device->event_head_, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+void keyboard::keyboard_irq_thread(void *arg)
+{
+	keyboard *device = (keyboard *)arg;
 
-	((x86_core &)core::this_core()).lapic().eoi();
+	unsigned int tail = device->event_tail_;
+	while (tail != __atomic_load_n(&device->event_head_, __ATOMIC_ACQUIRE)) {
+		device->handle_key_event(device->event_buffer_[tail % event_buffer_size]);
+
+		tail++;
+		__atomic_store_n(&device->event_tail_, tail, __ATOMIC_RELEASE);
+	}
 }
 
 void keyboard::handle_key_event(u8 key_event_data)
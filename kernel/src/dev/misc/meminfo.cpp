@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/dev/misc/meminfo.h>
+#include <stacsos/kernel/dev/misc/text-report.h>
+#include <stacsos/kernel/fs/file.h>
+#include <stacsos/kernel/mem/dma.h>
+#include <stacsos/kernel/mem/memory-manager.h>
+#include <stacsos/kernel/mem/swap-manager.h>
+#include <stacsos/kernel/sched/process-manager.h>
+#include <stacsos/printf.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::fs;
+using namespace stacsos::kernel::dev;
+using namespace stacsos::kernel::dev::misc;
+using namespace stacsos::kernel::mem;
+using namespace stacsos::kernel::sched;
+
+device_class meminfo::meminfo_device_class(device_class::root, "meminfo");
+
+static void generate_report(text_report &r)
+{
+	char key[64];
+	auto &mm = memory_manager::get();
+
+	r.add("meminfo.version", 1);
+
+	// Page allocator
+	auto &pgalloc = mm.pgalloc();
+	r.add("pgalloc.algorithm", pgalloc.name());
+	r.add("pgalloc.free_pages", pgalloc.nr_free_pages());
+
+	for (int order = 0; order < pgalloc.nr_orders(); order++) {
+		snprintf(key, sizeof(key), "pgalloc.free_blocks.order%d", order);
+		r.add(key, pgalloc.nr_free_blocks(order));
+	}
+
+	// Slab caches
+	for (int i = 0; i < object_allocator::nr_slab_caches; i++) {
+		auto stats = mm.objalloc().slab_stats(i);
+
+		snprintf(key, sizeof(key), "slab.%lu.slabs", stats.object_size);
+		r.add(key, stats.nr_slabs);
+		snprintf(key, sizeof(key), "slab.%lu.objects", stats.object_size);
+		r.add(key, stats.nr_objects);
+		snprintf(key, sizeof(key), "slab.%lu.capacity", stats.object_size);
+		r.add(key, stats.capacity);
+		snprintf(key, sizeof(key), "slab.%lu.utilisation_pct", stats.object_size);
+		r.add(key, stats.capacity ? (stats.nr_objects * 100) / stats.capacity : 0);
+	}
+
+	// Large objects
+	auto loa = mm.objalloc().loa_stats();
+	r.add("loa.objects", loa.nr_objects);
+	r.add("loa.bytes", loa.nr_bytes);
+	r.add("loa.pages", loa.nr_pages);
+	r.add("loa.va_used", loa.va_used);
+	r.add("loa.va_size", loa.va_size);
+
+	// DMA pool
+	r.add("dma.pool_pages", dma_allocator::get().nr_pool_pages());
+	r.add("dma.pool_free_pages", dma_allocator::get().nr_free_pool_pages());
+
+	// Page tables
+	r.add("pgtable.pages", mm.ptalloc().nr_pages());
+
+	// Swap
+	auto &swap = swap_manager::get();
+	r.add("swap.slots", swap.nr_slots());
+	r.add("swap.free_slots", swap.nr_free_slots());
+	r.add("swap.pages_out", swap.nr_swapped_out());
+	r.add("swap.pages_in", swap.nr_swapped_in());
+
+	// Processes
+	for (const auto &p : process_manager::get().processes()) {
+		snprintf(key, sizeof(key), "process.%lu.resident_pages", p->id());
+		r.add(key, p->addrspace().nr_resident_pages());
+	}
+}
+
+shared_ptr<file> meminfo::open_as_file()
+{
+	text_report r;
+	generate_report(r);
+
+	return r.to_file();
+}
@@ -0,0 +1,165 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/arch/core-manager.h>
+#include <stacsos/kernel/arch/core.h>
+#include <stacsos/kernel/dev/misc/schedstat.h>
+#include <stacsos/kernel/dev/misc/text-report.h>
+#include <stacsos/kernel/fs/file.h>
+#include <stacsos/kernel/sched/process-manager.h>
+#include <stacsos/kernel/sched/scheduler.h>
+#include <stacsos/kernel/sched/workqueue.h>
+#include <stacsos/printf.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::arch;
+using namespace stacsos::kernel::fs;
+using namespace stacsos::kernel::dev;
+using namespace stacsos::kernel::dev::misc;
+using namespace stacsos::kernel::sched;
+
+device_class schedstat::schedstat_device_class(device_class::root, "schedstat");
+
+static void generate_report(text_report &r)
+{
+	char key[64];
+
+	r.add("schedstat.version", 1);
+
+	auto &wakeups = scheduler::get().wakeup_statistics();
+	r.add("wakeup.previous_idle", wakeups.previous_idle.load());
+	r.add("wakeup.waker_idle", wakeups.waker_idle.load());
+	r.add("wakeup.other_idle", wakeups.other_idle.load());
+	r.add("wakeup.previous_busy", wakeups.previous_busy.load());
+	r.add("wakeup.pinned", wakeups.pinned.load());
+	r.add("wakeup.ipis", wakeups.ipis.load());
+
+	for (auto *c : core_manager::get().cores()) {
+		if (!c->online()) {
+			continue;
+		}
+
+		snprintf(key, sizeof(key), "core.%d.runnable", c->id());
+		r.add(key, c->nr_runnable());
+		snprintf(key, sizeof(key), "core.%d.ticks", c->id());
+		r.add(key, c->nr_ticks());
+		snprintf(key, sizeof(key), "core.%d.tick_stopped", c->id());
+		r.add(key, c->tick_stopped());
+		snprintf(key, sizeof(key), "core.%d.timers", c->id());
+		r.add(key, c->timers().nr_pending());
+		snprintf(key, sizeof(key), "core.%d.steals", c->id());
+		r.add(key, c->nr_steals());
+		snprintf(key, sizeof(key), "core.%d.migrations", c->id());
+		r.add(key, c->nr_migrations());
+		snprintf(key, sizeof(key), "core.%d.schedule_calls", c->id());
+		r.add(key, c->nr_schedule_calls());
+		snprintf(key, sizeof(key), "core.%d.schedule_cycles_mean", c->id());
+		r.add(key, c->nr_schedule_calls() ? c->schedule_cycles_total() / c->nr_schedule_calls() : 0);
+		snprintf(key, sizeof(key), "core.%d.schedule_cycles_max", c->id());
+		r.add(key, c->schedule_cycles_max());
+		snprintf(key, sizeof(key), "core.%d.rt_runnable", c->id());
+		r.add(key, c->nr_rt_runnable());
+		snprintf(key, sizeof(key), "core.%d.rt_preemptions", c->id());
+		r.add(key, c->nr_rt_preemptions());
+		snprintf(key, sizeof(key), "core.%d.dl_runnable", c->id());
+		r.add(key, c->nr_dl_runnable());
+		snprintf(key, sizeof(key), "core.%d.dl_throttled", c->id());
+		r.add(key, c->nr_dl_throttled());
+		snprintf(key, sizeof(key), "core.%d.dl_bandwidth_pct", c->id());
+		r.add(key, (c->dl_bandwidth() * 100) >> alg::deadline_scheduler::bw_shift);
+		snprintf(key, sizeof(key), "core.%d.quota_parked", c->id());
+		r.add(key, c->nr_parked());
+		snprintf(key, sizeof(key), "core.%d.yields", c->id());
+		r.add(key, c->nr_yields());
+		snprintf(key, sizeof(key), "core.%d.irqs", c->id());
+		r.add(key, c->per_cpu(cpu_data).nr_irqs);
+		snprintf(key, sizeof(key), "core.%d.syscalls", c->id());
+		r.add(key, c->per_cpu(cpu_data).nr_syscalls);
+
+		u64 online = c->online_cycles();
+		snprintf(key, sizeof(key), "core.%d.idle_pct", c->id());
+		r.add(key, online ? (c->idle_cycles() * 100) / online : 0);
+		snprintf(key, sizeof(key), "core.%d.idle_entries", c->id());
+		r.add(key, c->per_cpu(cpu_data).nr_idle_entries);
+		snprintf(key, sizeof(key), "core.%d.resched_ipis", c->id());
+		r.add(key, c->per_cpu(cpu_data).nr_resched_ipis);
+		snprintf(key, sizeof(key), "core.%d.resched_poll_wakeups", c->id());
+		r.add(key, c->per_cpu(cpu_data).nr_poll_wakeups);
+
+		static const char *ipi_names[] = { "reschedule", "call_function", "tlb_shootdown" };
+		auto &ipis = c->per_cpu(ipi_statistics);
+
+		for (int i = 0; i < nr_ipi_types; i++) {
+			snprintf(key, sizeof(key), "core.%d.ipi.%s.sent", c->id(), ipi_names[i]);
+			r.add(key, ipis.sent[i]);
+			snprintf(key, sizeof(key), "core.%d.ipi.%s.received", c->id(), ipi_names[i]);
+			r.add(key, ipis.received[i]);
+		}
+
+		snprintf(key, sizeof(key), "core.%d.ipi.latency_cycles_mean", c->id());
+		r.add(key, ipis.latency_samples ? ipis.latency_total / ipis.latency_samples : 0);
+		snprintf(key, sizeof(key), "core.%d.ipi.latency_cycles_max", c->id());
+		r.add(key, ipis.latency_max);
+		snprintf(key, sizeof(key), "core.%d.ipi.calls", c->id());
+		r.add(key, ipis.calls);
+		snprintf(key, sizeof(key), "core.%d.tlb.shootdowns", c->id());
+		r.add(key, ipis.shootdowns);
+		snprintf(key, sizeof(key), "core.%d.tlb.pages_flushed", c->id());
+		r.add(key, ipis.pages_flushed);
+		snprintf(key, sizeof(key), "core.%d.tlb.full_flushes", c->id());
+		r.add(key, ipis.full_flushes);
+
+		auto &work = c->per_cpu(workqueue_statistics);
+		snprintf(key, sizeof(key), "core.%d.work.queued", c->id());
+		r.add(key, work.queued);
+		snprintf(key, sizeof(key), "core.%d.work.coalesced", c->id());
+		r.add(key, work.coalesced);
+		snprintf(key, sizeof(key), "core.%d.work.run", c->id());
+		r.add(key, work.run);
+		snprintf(key, sizeof(key), "core.%d.work.latency_cycles_mean", c->id());
+		r.add(key, work.run ? work.latency_total / work.run : 0);
+		snprintf(key, sizeof(key), "core.%d.work.latency_cycles_max", c->id());
+		r.add(key, work.latency_max);
+	}
+
+	// CPU quotas, and deadline threads, by process ID and thread index.
+	for (const auto &p : process_manager::get().processes()) {
+		const auto &quota = p->quota();
+		if (quota.limited()) {
+			snprintf(key, sizeof(key), "process.%lu.quota_pct", p->id());
+			r.add(key, (quota.quota() * 100) / quota.period());
+			snprintf(key, sizeof(key), "process.%lu.quota_periods", p->id());
+			r.add(key, quota.nr_periods());
+			snprintf(key, sizeof(key), "process.%lu.quota_throttled", p->id());
+			r.add(key, quota.nr_throttled());
+		}
+
+		unsigned int index = 0;
+
+		for (const auto &t : p->threads()) {
+			const tcb &tcb = *t->get_tcb();
+
+			if (is_deadline(tcb)) {
+				snprintf(key, sizeof(key), "thread.%lu.%u.dl_misses", p->id(), index);
+				r.add(key, tcb.dl_misses);
+				snprintf(key, sizeof(key), "thread.%lu.%u.dl_overruns", p->id(), index);
+				r.add(key, tcb.dl_overruns);
+			}
+
+			index++;
+		}
+	}
+}
+
+shared_ptr<file> schedstat::open_as_file()
+{
+	text_report r;
+	generate_report(r);
+
+	return r.to_file();
+}
@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/dev/misc/text-report.h>
+#include <stacsos/kernel/fs/file.h>
+#include <stacsos/memops.h>
+#include <stacsos/printf.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::fs;
+using namespace stacsos::kernel::dev::misc;
+
+text_report::text_report()
+	: capacity_(4096)
+	, length_(0)
+	, buffer_(new char[capacity_])
+{
+	buffer_[0] = 0;
+}
+
+void text_report::add(const char *key, u64 value)
+{
+	char line[128];
+	int line_length = snprintf(line, sizeof(line), "%s %lu\n", key, value);
+
+	append(line, line_length);
+}
+
+void text_report::add(const char *key, const char *value)
+{
+	char line[128];
+	int line_length = snprintf(line, sizeof(line), "%s %s\n", key, value);
+
+	append(line, line_length);
+}
+
+void text_report::append(const char *text, size_t text_length)
+{
+	if (length_ + text_length + 1 > capacity_) {
+		size_t new_capacity = capacity_ * 2;
+		while (length_ + text_length + 1 > new_capacity) {
+			new_capacity *= 2;
+		}
+
+		char *new_buffer = new char[new_capacity];
+		memops::memcpy(new_buffer, buffer_, length_);
+		delete[] buffer_;
+
+		buffer_ = new_buffer;
+		capacity_ = new_capacity;
+	}
+
+	memops::memcpy(&buffer_[length_], text, text_length);
+	length_ += text_length;
+	buffer_[length_] = 0;
+}
+
+/*
+ * Implements file operations for a finished report.  The report is generated once, when the
+ * file is opened, so that a reader sees a consistent snapshot across multiple reads.
+ */
+class text_report_file : public file {
+public:
+	text_report_file(size_t length, char *data)
+		: file(length)
+		, data_(data)
+		, length_(length)
+	{
+	}
+
+	virtual ~text_report_file() { delete[] data_; }
+
+	virtual size_t pread(void *buffer, size_t offset, size_t length) override
+	{
+		if (offset >= length_) {
+			return 0;
+		}
+
+		size_t read_length = min(length, length_ - offset);
+		memops::memcpy(buffer, &data_[offset], read_length);
+
+		return read_length;
+	}
+
+	// No writing allowed!
+	virtual size_t pwrite(const void *buffer, size_t offset, size_t length) override { return 0; }
+
+private:
+	char *data_;
+	size_t length_;
+};
+
+shared_ptr<file> text_report::to_file()
+{
+	size_t report_length = length();
+	return shared_ptr<file>(new text_report_file(report_length, release()));
+}
@@ -9,7 +9,7 @@
 #include <stacsos/kernel/dev/device-manager.h>
 #include <stacsos/kernel/dev/storage/ahci-controller.h>
 #include <stacsos/kernel/dev/storage/ahci-storage-device.h>
-#include <stacsos/kernel/mem/memory-manager.h>
+#include <stacsos/kernel/mem/dma.h>
 #include <stacsos/list.h>
 
 using namespace stacsos::kernel::dev;
@@ -38,14 +38,20 @@ void ahci_controller::probe()
 		}
 	}
 
+	if (usable_ports.count() == 0) {
+		return;
+	}
+
 	// Allocate storage for command list, command table, and FIS.
 	u64 cl_size = 0x400 * usable_ports.count();
 	u64 ctbl_size = 0x100 * 32 * usable_ports.count();
 	u64 fis_size = 0x100 * usable_ports.count();
 
-	u64 clb = memory_manager::get().pgalloc().allocate_pages(0, page_allocation_flags::zero)->base_address();
-	u64 ctbl = memory_manager::get().pgalloc().allocate_pages(0, page_allocation_flags::zero)->base_address();
-	u64 fis = memory_manager::get().pgalloc().allocate_pages(0, page_allocation_flags::zero)->base_address();
+	u64 clb, ctbl, fis;
+	if (!dma_alloc(cl_size, clb, dma_flags::below_4g | dma_flags::zero) || !dma_alloc(ctbl_size, ctbl, dma_flags::below_4g | dma_flags::zero)
+		|| !dma_alloc(fis_size, fis, dma_flags::below_4g | dma_flags::zero)) {
+		panic("ahci: unable to allocate command structures");
+	}
 
 	int port_index = 0;
 	for (volatile hba_port *port : usable_ports) {
@@ -7,12 +7,14 @@
  */
 #include <stacsos/kernel/debug.h>
 #include <stacsos/kernel/dev/storage/ahci-storage-device.h>
+#include <stacsos/kernel/mem/dma.h>
 #include <stacsos/memops.h>
 
 using namespace stacsos;
 using namespace stacsos::kernel;
 using namespace stacsos::kernel::dev;
 using namespace stacsos::kernel::dev::storage;
+using namespace stacsos::kernel::mem;
 
 device_class ahci_storage_device::ahci_storage_device_class(block_device::block_device_class, "ahci");
 
@@ -28,6 +30,11 @@ void ahci_storage_device::configure()
 	port_->cmd |= HBA_PxCMD_FRE;
 	port_->cmd |= HBA_PxCMD_ST;
 
+	dma_buffer_ = dma_alloc(max_blocks_per_command * 512, dma_buffer_bus_address_);
+	if (!dma_buffer_) {
+		panic("ahci: unable to allocate dma buffer");
+	}
+
 	identify();
 }
 
@@ -51,10 +58,9 @@ void ahci_storage_device::identify()
 	volatile hba_cmd_table *cmdtbl = (hba_cmd_table *)phys_to_virt((u64)cmd->ctba);
 	memops::bzero((void *)cmdtbl, sizeof(hba_cmd_table) + sizeof(hba_prdt_entry) * cmd->prdtl);
 
-	u8 *buffer = new u8[512];
-
-	cmdtbl->prdt_entry[0].dba = (u32)(u64)buffer;
-	cmdtbl->prdt_entry[0].dbc = 512;
+	cmdtbl->prdt_entry[0].dba = (u32)dma_buffer_bus_address_;
+	cmdtbl->prdt_entry[0].dbau = (u32)(dma_buffer_bus_address_ >> 32);
+	cmdtbl->prdt_entry[0].dbc = 512 - 1;
 	cmdtbl->prdt_entry[0].i = 1;
 
 	// Prepare command
@@ -87,11 +93,69 @@ void ahci_storage_device::identify()
 		panic("identify error");
 	}
 
-	nr_blocks_ = *(u32 *)(buffer + 120);
-	delete[] buffer;
+	nr_blocks_ = *(u32 *)((u8 *)dma_buffer_ + 120);
+}
+
+void ahci_storage_device::read_blocks_sync(void *buffer, u64 start, u64 count) { transfer_blocks_sync(buffer, start, count, false); }
+
+void ahci_storage_device::write_blocks_sync(const void *buffer, u64 start, u64 count) { transfer_blocks_sync((void *)buffer, start, count, true); }
+
+void ahci_storage_device::acquire_dma_buffer()
+{
+	// The condition is checked with the queue locked, so only one waiter can take the buffer.
+	dma_buffer_wq_.wait_event([this] {
+		if (dma_buffer_busy_) {
+			return false;
+		}
+
+		dma_buffer_busy_ = true;
+		return true;
+	});
+}
+
+void ahci_storage_device::release_dma_buffer()
+{
+	__atomic_store_n(&dma_buffer_busy_, false, __ATOMIC_RELEASE);
+	dma_buffer_wq_.wake_one();
 }
 
-void ahci_storage_device::read_blocks_sync(void *buffer, u64 start, u64 count)
+/**
+ * Transfers COUNT blocks, starting at block START, between the device and BUFFER, and waits for the
+ * transfer to complete.  If WRITE is true, the data flows from BUFFER to the device.  The data is
+ * staged through the device's DMA buffer, in chunks of at most one command's worth of blocks.
+ * Completion is polled, with interrupts left as the caller had them.
+ */
+void ahci_storage_device::transfer_blocks_sync(void *buffer, u64 start, u64 count, bool write)
+{
+	acquire_dma_buffer();
+
+	u8 *data = (u8 *)buffer;
+
+	while (count > 0) {
+		u64 chunk = min(count, max_blocks_per_command);
+
+		if (write) {
+			memops::memcpy(dma_buffer_, data, chunk * 512);
+		}
+
+		issue_transfer_sync(start, chunk, write);
+
+		if (!write) {
+			memops::memcpy(data, dma_buffer_, chunk * 512);
+		}
+
+		data += chunk * 512;
+		start += chunk;
+		count -= chunk;
+	}
+
+	release_dma_buffer();
+}
+
+/**
+ * Issues a single DMA command that transfers COUNT blocks between block START and the DMA buffer.
+ */
+void ahci_storage_device::issue_transfer_sync(u64 start, u64 count, bool write)
 {
 	int slot_index;
 	volatile hba_cmd_header *cmd = get_free_cmd_slot(slot_index);
@@ -100,11 +164,11 @@ void ahci_storage_device::read_blocks_sync(void *buffer, u64 start, u64 count)
 	}
 
 	cmd->cfl = sizeof(fis_reg_host2device) / sizeof(u32);
-	cmd->w = 0;
+	cmd->w = write ? 1 : 0;
 	cmd->prdtl = (u16)((count - 1) >> 4) + 1;
 	cmd->p = 0;
 
-	if (cmd->prdtl > 8) {
+	if (cmd->prdtl > max_prdt_entries) {
 		panic("too many prdtls");
 	}
 
@@ -112,18 +176,22 @@ void ahci_storage_device::read_blocks_sync(void *buffer, u64 start, u64 count)
 	volatile hba_cmd_table *cmdtbl = (hba_cmd_table *)phys_to_virt((u64)cmd->ctba);
 	memops::bzero((void *)cmdtbl, sizeof(hba_cmd_table) + sizeof(hba_prdt_entry) * cmd->prdtl);
 
-	u64 buffer_chunk = (u64)buffer;
+	// Every entry but the last covers 16 blocks.  The count itself is still needed for the FIS.
+	u64 buffer_chunk = dma_buffer_bus_address_;
+	u64 remaining = count;
 	for (int prdt_idx = 0; prdt_idx < cmd->prdtl - 1; prdt_idx++) {
 		cmdtbl->prdt_entry[prdt_idx].dba = (u32)buffer_chunk;
-		cmdtbl->prdt_entry[prdt_idx].dbc = (8 * 1024) - 1;
+		cmdtbl->prdt_entry[prdt_idx].dbau = (u32)(buffer_chunk >> 32);
+		cmdtbl->prdt_entry[prdt_idx].dbc = prdt_entry_size - 1;
 		cmdtbl->prdt_entry[prdt_idx].i = 1;
 
-		buffer_chunk += 8 * 1024;
-		count -= 16;
+		buffer_chunk += prdt_entry_size;
+		remaining -= 16;
 	}
 
 	cmdtbl->prdt_entry[cmd->prdtl - 1].dba = (u32)buffer_chunk;
-	cmdtbl->prdt_entry[cmd->prdtl - 1].dbc = (count << 9) - 1;
+	cmdtbl->prdt_entry[cmd->prdtl - 1].dbau = (u32)(buffer_chunk >> 32);
+	cmdtbl->prdt_entry[cmd->prdtl - 1].dbc = (remaining << 9) - 1;
 	cmdtbl->prdt_entry[cmd->prdtl - 1].i = 1;
 
 	// Prepare command
@@ -132,7 +200,7 @@ void ahci_storage_device::read_blocks_sync(void *buffer, u64 start, u64 count)
 
 	cmdfis->type = fis_type::FIS_TYPE_REG_H2D;
 	cmdfis->c = 1;
-	cmdfis->command = ATA_CMD_READ_DMA_EX;
+	cmdfis->command = write ? ATA_CMD_WRITE_DMA_EX : ATA_CMD_READ_DMA_EX;
 
 	cmdfis->lba0 = (u8)start;
 	cmdfis->lba1 = (u8)(start >> 8);
@@ -159,17 +227,15 @@ void ahci_storage_device::read_blocks_sync(void *buffer, u64 start, u64 count)
 
 		if (port_->interrupt_status & HBA_PxIS_TFES) // Task file error
 		{
-			panic("read error");
+			panic(write ? "write error" : "read error");
 		}
 	}
 
 	if (port_->interrupt_status & HBA_PxIS_TFES) {
-		panic("read error");
+		panic(write ? "write error" : "read error");
 	}
 }
 
-void ahci_storage_device::write_blocks_sync(const void *buffer, u64 start, u64 count) { }
-
 volatile hba_cmd_header *ahci_storage_device::get_free_cmd_slot(int &slot_index)
 {
 	u32 candidate_slots = port_->sata_ctl | port_->command_issue;
@@ -16,13 +16,17 @@
 #include <stacsos/kernel/dev/gfx/qemu-stdvga.h>
 #include <stacsos/kernel/dev/input/keyboard.h>
 #include <stacsos/kernel/dev/misc/cmos-rtc.h>
+#include <stacsos/kernel/dev/misc/meminfo.h>
+#include <stacsos/kernel/dev/misc/schedstat.h>
 #include <stacsos/kernel/dev/storage/ahci-storage-device.h>
 #include <stacsos/kernel/dev/tty/terminal.h>
 #include <stacsos/kernel/fs/filesystem.h>
 #include <stacsos/kernel/fs/vfs.h>
 #include <stacsos/kernel/log.h>
 #include <stacsos/kernel/mem/memory-manager.h>
+#include <stacsos/kernel/mem/swap-manager.h>
 #include <stacsos/kernel/sched/process-manager.h>
+#include <stacsos/kernel/sched/workqueue.h>
 #include <stacsos/memops.h>
 
 using namespace stacsos::kernel;
@@ -45,6 +49,14 @@ static void init_console()
 	auto rtc = new cmos_rtc(dm.sysbus());
 	dm.register_device(*rtc);
 
+	auto mi = new meminfo(dm.sysbus());
+	dm.register_device(*mi);
+	dm.add_device_alias(*mi, "meminfo");
+
+	auto ss = new schedstat(dm.sysbus());
+	dm.register_device(*ss);
+	dm.add_device_alias(*ss, "schedstat");
+
 	auto kbd = new keyboard(dm.sysbus());
 	dm.register_device(*kbd);
 
@@ -95,6 +107,9 @@ static void continue_main()
 {
 	main_logger.log(log_level::info, "now in kernel process");
 
+	// Start the per-core worker threads before any devices, as drivers defer work to them.
+	workqueue::get().init();
+
 	device_manager::get().probe_buses();
 	init_console();
 
@@ -119,6 +134,9 @@ static void continue_main()
 
 	devfs_dir->mount(*new devfs());
 
+	// Bring up swap, now that the block devices have been probed.
+	stacsos::kernel::mem::swap_manager::get().init();
+
 	// Launch the init process
 	auto init_proc = process_manager::get().create_process("/usr/init", "");
 	if (!init_proc) {
@@ -10,6 +10,8 @@
 #include <stacsos/kernel/mem/memory-manager.h>
 #include <stacsos/kernel/mem/page-table-allocator.h>
 #include <stacsos/kernel/mem/page-table.h>
+#include <stacsos/kernel/mem/page.h>
+#include <stacsos/kernel/mem/swap-manager.h>
 
 using namespace stacsos::kernel::mem;
 
@@ -37,9 +39,27 @@ address_space_region *address_space::add_region(u64 base, u64 size, region_flags
 
 	//dprintf("as: add-region base=%lx size=%lx flags=%d alloc=%d\n", base, size, flags, allocate);
 
-	if (allocate) {
+	if (allocate && flags == region_flags::readwrite && swap_manager::get().enabled()) {
+		// Anonymous memory is backed by individual pages when swap is enabled, so that each page can
+		// be reclaimed independently.  There is no single backing block in this case.
+		u64 pages = (size + (PAGE_SIZE - 1)) / PAGE_SIZE;
+		rgn->storage = nullptr;
+
+		for (u64 i = 0; i < pages; i++) {
+			u64 cur_virt = base + (i << PAGE_BITS);
+			page *pg = swap_manager::get().allocate_anonymous_page();
+
+			pt_->map(pta_, cur_virt, pg->base_address(), mapping_flags::present | mapping_flags::writable | mapping_flags::user_accessable, mapping_size::m4k);
+			swap_manager::get().track_page(*this, cur_virt, *pg);
+		}
+
+		nr_resident_pages_ += pages;
+	} else if (allocate) {
 		u64 pages = (size + (PAGE_SIZE - 1)) / PAGE_SIZE;
 		rgn->storage = memory_manager::get().pgalloc().allocate_pages(log2_ceil(pages), page_allocation_flags::zero);
+		if (!rgn->storage) {
+			panic("out of memory");
+		}
 
 		u64 cur_virt = base;
 		u64 cur_phys = rgn->storage->base_address();
@@ -50,6 +70,8 @@ address_space_region *address_space::add_region(u64 base, u64 size, region_flags
 			cur_virt += PAGE_SIZE;
 			cur_phys += PAGE_SIZE;
 		}
+
+		nr_resident_pages_ += pages;
 	} else {
 		rgn->storage = nullptr;
 	}
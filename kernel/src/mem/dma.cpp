@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/debug.h>
+#include <stacsos/kernel/mem/dma.h>
+#include <stacsos/kernel/mem/memory-manager.h>
+#include <stacsos/kernel/mem/page.h>
+#include <stacsos/memops.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::mem;
+
+// Pool allocations are aligned to their own size, up to this many pages, which keeps small
+// buffers from straddling device boundary restrictions.
+static const u64 max_pool_alignment = 16;
+
+void dma_allocator::init_pool(u64 base_address, u64 size)
+{
+	assert(!(base_address & ~PAGE_MASK));
+	assert(size <= max_pool_size);
+	assert(base_address + size <= GB(4));
+
+	pool_base_ = base_address;
+	pool_pages_ = size >> PAGE_BITS;
+	pool_free_pages_ = pool_pages_;
+
+	dprintf("dma: pool at %lx--%lx (%lu pages)\n", pool_base_, pool_base_ + size - 1, pool_pages_);
+}
+
+void *dma_allocator::allocate(size_t size, u64 &bus_address, dma_flags flags)
+{
+	if (size == 0) {
+		return nullptr;
+	}
+
+	u64 nr_pages = PAGE_ALIGN_UP(size) >> PAGE_BITS;
+	int order = log2_ceil(nr_pages);
+	bool below_4g = (flags & dma_flags::below_4g) == dma_flags::below_4g;
+
+	void *ptr = nullptr;
+
+	// Large buffers are the ones that are hard to find in a fragmented page allocator, so they
+	// are taken from the reserved pool first.
+	if (size >= pool_threshold) {
+		ptr = allocate_from_pool(nr_pages, bus_address);
+	}
+
+	if (!ptr) {
+		auto &pgalloc = memory_manager::get().pgalloc();
+
+		page *pg = pgalloc.allocate_pages(order);
+		if (pg) {
+			if (below_4g && (pg->base_address() + ((1ull << order) << PAGE_BITS)) > GB(4)) {
+				pgalloc.free_pages(*pg, order);
+			} else {
+				bus_address = pg->base_address();
+				ptr = pg->base_address_ptr();
+			}
+		}
+	}
+
+	if (!ptr && size < pool_threshold) {
+		ptr = allocate_from_pool(nr_pages, bus_address);
+	}
+
+	if (ptr && (flags & dma_flags::zero) == dma_flags::zero) {
+		memops::pzero(ptr, nr_pages);
+	}
+
+	return ptr;
+}
+
+void dma_allocator::free(void *ptr, size_t size)
+{
+	if (!ptr) {
+		return;
+	}
+
+	u64 nr_pages = PAGE_ALIGN_UP(size) >> PAGE_BITS;
+	u64 bus_address = (u64)ptr - 0xffff'8000'0000'0000ull;
+
+	if (bus_address >= pool_base_ && bus_address < pool_base_ + (pool_pages_ << PAGE_BITS)) {
+		free_to_pool(bus_address, nr_pages);
+	} else {
+		memory_manager::get().pgalloc().free_pages(page::get_from_base_address(bus_address), log2_ceil(nr_pages));
+	}
+}
+
+void *dma_allocator::allocate_from_pool(u64 nr_pages, u64 &bus_address)
+{
+	unique_irq_lock l(lock_);
+
+	if (nr_pages > pool_free_pages_) {
+		return nullptr;
+	}
+
+	u64 alignment = min(1ull << log2_ceil(nr_pages), max_pool_alignment);
+
+	// First fit: on finding a used page, skip to the next aligned candidate beyond it.
+	u64 start = 0;
+	while (start + nr_pages <= pool_pages_) {
+		u64 i = 0;
+		while (i < nr_pages && !pool_page_used(start + i)) {
+			i++;
+		}
+
+		if (i == nr_pages) {
+			for (i = 0; i < nr_pages; i++) {
+				set_pool_page_used(start + i, true);
+			}
+
+			pool_free_pages_ -= nr_pages;
+
+			bus_address = pool_base_ + (start << PAGE_BITS);
+			return phys_to_virt(bus_address);
+		}
+
+		start = (start + i + alignment) & ~(alignment - 1);
+	}
+
+	return nullptr;
+}
+
+void dma_allocator::free_to_pool(u64 bus_address, u64 nr_pages)
+{
+	unique_irq_lock l(lock_);
+
+	u64 start = (bus_address - pool_base_) >> PAGE_BITS;
+	assert(start + nr_pages <= pool_pages_);
+
+	for (u64 i = start; i < start + nr_pages; i++) {
+		assert(pool_page_used(i));
+		set_pool_page_used(i, false);
+	}
+
+	pool_free_pages_ += nr_pages;
+}
@@ -71,6 +71,11 @@ void *large_object_allocator::allocate(size_t size)
 
 	// Advance the base pointer by the number of pages we've just allocated (and mapped)
 	base_ = (void *)((uintptr_t)base_ + (nr_pages * PAGE_SIZE));
+
+	nr_objects_++;
+	nr_bytes_ += size;
+	nr_pages_ += nr_pages;
+
 	return (void *)target;
 }
 
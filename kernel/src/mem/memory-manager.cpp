@@ -7,10 +7,12 @@
  */
 #include <stacsos/kernel/config.h>
 #include <stacsos/kernel/debug.h>
+#include <stacsos/kernel/mem/dma.h>
 #include <stacsos/kernel/mem/memory-manager.h>
 #include <stacsos/kernel/mem/page-allocator-buddy.h>
 #include <stacsos/kernel/mem/page-allocator-linear.h>
 #include <stacsos/kernel/mem/page.h>
+#include <stacsos/kernel/mem/swap-manager.h>
 
 extern "C" const char *_IMAGE_START;
 extern "C" const char *_IMAGE_END;
@@ -129,7 +131,54 @@ void memory_manager::initialise_page_allocator(u64 nr_page_descriptors)
 
 	// Remove the page descriptors array
 	u64 page_descriptors_size = sizeof(page) * nr_page_descriptors;
-	pgalloc_->remove_pages(page::get_from_base_address((u64)&_DYNAMIC_DATA_START - 0xffff'ffff'8000'0000), PAGE_ALIGN_UP(page_descriptors_size) >> PAGE_BITS);
+	u64 page_descriptors_start = (u64)&_DYNAMIC_DATA_START - 0xffff'ffff'8000'0000;
+	pgalloc_->remove_pages(page::get_from_base_address(page_descriptors_start), PAGE_ALIGN_UP(page_descriptors_size) >> PAGE_BITS);
+
+	// Set aside low memory for large DMA buffers, above everything that has been removed so far.
+	reserve_dma_pool(PAGE_ALIGN_UP(page_descriptors_start + page_descriptors_size));
+
+	// The benchmark runs against the fully populated allocator, and halts the system when complete.
+	const char *bench_pattern = config::get().get_option("pgalloc-bench");
+	if (bench_pattern) {
+		pgalloc_->perform_benchmark(bench_pattern, config::get().get_option_u64_or_default("pgalloc-bench-seed", 0x5eed));
+		__unreachable();
+	}
+}
+
+/*
+ * Finds a physically contiguous range of available memory below 4 GB, at or above LOWEST_ADDRESS,
+ * and hands it over to the DMA allocator.
+ */
+void memory_manager::reserve_dma_pool(u64 lowest_address)
+{
+	u64 pool_size = PAGE_ALIGN_UP(config::get().get_option_u64_or_default("dma-pool-size", dma_allocator::default_pool_size));
+	if (pool_size == 0) {
+		dprintf("dma: pool disabled\n");
+		return;
+	}
+
+	if (pool_size > dma_allocator::max_pool_size) {
+		pool_size = dma_allocator::max_pool_size;
+	}
+
+	for (int i = 0; i < nr_memory_blocks; i++) {
+		const memory_block *mb = &memory_blocks[i];
+		if (!mb->avail) {
+			continue;
+		}
+
+		// Start on a 2 MB boundary, which suits devices with alignment requirements.
+		u64 start = (max(mb->start, lowest_address) + (MB(2) - 1)) & ~(MB(2) - 1);
+		u64 end = min(mb->start + mb->length, GB(4));
+
+		if (start + pool_size <= end) {
+			pgalloc_->remove_pages(page::get_from_base_address(start), pool_size >> PAGE_BITS);
+			dma_allocator::get().init_pool(start, pool_size);
+			return;
+		}
+	}
+
+	dprintf("dma: unable to reserve a %lu byte pool below 4 GB\n", pool_size);
 }
 
 void memory_manager::initialise_object_allocator()
@@ -155,4 +204,8 @@ void memory_manager::activate_primary_mapping()
 	root_address_space_->pgtable().activate();
 }
 
-bool memory_manager::try_handle_page_fault(u64 faulting_address) { return false; }
+bool memory_manager::try_handle_page_fault(address_space &as, u64 faulting_address)
+{
+	// The only recoverable faults at the moment are accesses to pages that have been swapped out.
+	return swap_manager::get().try_swap_in(as, faulting_address);
+}
@@ -70,3 +70,33 @@ void object_allocator::free(void *ptr)
 		panic("unable to free object");
 	}
 }
+
+slab_cache_stats object_allocator::slab_stats(int index)
+{
+	unique_irq_lock l(object_allocator_lock_);
+
+	switch (index) {
+	case 0:
+		return cache16_.stats();
+	case 1:
+		return cache32_.stats();
+	case 2:
+		return cache64_.stats();
+	case 3:
+		return cache128_.stats();
+	case 4:
+		return cache256_.stats();
+	case 5:
+		return cache512_.stats();
+	case 6:
+		return cache1024_.stats();
+	default:
+		panic("invalid slab cache index %d", index);
+	}
+}
+
+large_object_stats object_allocator::loa_stats()
+{
+	unique_irq_lock l(object_allocator_lock_);
+	return loa_.stats();
+}
@@ -0,0 +1,263 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/debug.h>
+#include <stacsos/kernel/mem/page-allocator.h>
+#include <stacsos/kernel/mem/page.h>
+#include <stacsos/memops.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::mem;
+
+// The benchmark runs before the object allocator is usable, so all of its bookkeeping is static.
+
+static const int bench_max_order = 10;
+static const int bench_blocks_per_order = 64;
+static const int bench_random_slots = 1024;
+static const int bench_random_ops = 20000;
+static const int bench_histogram_buckets = 32;
+
+struct bench_op_stats {
+	u64 count, failed;
+	u64 min, max, total;
+	u64 histogram[bench_histogram_buckets];
+
+	void reset()
+	{
+		count = failed = total = max = 0;
+		min = ~0ull;
+		memops::bzero(histogram, sizeof(histogram));
+	}
+
+	void record(u64 cycles)
+	{
+		count++;
+		total += cycles;
+		min = cycles < min ? cycles : min;
+		max = cycles > max ? cycles : max;
+
+		int bucket = cycles ? log2(cycles) : 0;
+		histogram[bucket < bench_histogram_buckets ? bucket : bench_histogram_buckets - 1]++;
+	}
+};
+
+static bench_op_stats alloc_stats[bench_max_order + 1];
+static bench_op_stats free_stats[bench_max_order + 1];
+
+static page *bench_blocks[bench_blocks_per_order];
+static page *random_blocks[bench_random_slots];
+static int random_orders[bench_random_slots];
+
+static inline u64 bench_timestamp()
+{
+	u32 aux;
+	return __builtin_ia32_rdtscp(&aux);
+}
+
+static u64 bench_random(u64 &state)
+{
+	// xorshift64
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+static void reset_stats()
+{
+	for (int order = 0; order <= bench_max_order; order++) {
+		alloc_stats[order].reset();
+		free_stats[order].reset();
+	}
+}
+
+/**
+ * Prints one line per (operation, order) pair.  The histogram is a list of bucket:count
+ * pairs, where bucket N holds operations that took between 2^N and 2^(N+1)-1 cycles.
+ */
+static void report_stats(const char *pattern)
+{
+	for (int op = 0; op < 2; op++) {
+		for (int order = 0; order <= bench_max_order; order++) {
+			const bench_op_stats &s = op == 0 ? alloc_stats[order] : free_stats[order];
+			if (!s.count && !s.failed) {
+				continue;
+			}
+
+			dprintf("pgalloc-bench: result pattern=%s op=%s order=%d count=%lu failed=%lu min=%lu mean=%lu max=%lu hist=", pattern, op == 0 ? "alloc" : "free",
+				order, s.count, s.failed, s.count ? s.min : 0, s.count ? s.total / s.count : 0, s.max);
+
+			bool first = true;
+			for (int bucket = 0; bucket < bench_histogram_buckets; bucket++) {
+				if (s.histogram[bucket]) {
+					dprintf("%s%d:%lu", first ? "" : ",", bucket, s.histogram[bucket]);
+					first = false;
+				}
+			}
+
+			dprintf("\n");
+		}
+	}
+}
+
+void page_allocator::report_fragmentation(const char *pattern)
+{
+	u64 nr_free = nr_free_pages();
+
+	int largest_order = largest_free_order();
+
+	dprintf("pgalloc-bench: frag pattern=%s free_pages=%lu largest_order=%d", pattern, nr_free, largest_order);
+
+	// For allocators that track blocks by order, report the unusable free space index for each
+	// order: the fraction of free memory that cannot satisfy an allocation of that order.
+	for (int target = 0; target < nr_orders() && target <= bench_max_order; target++) {
+		u64 usable = 0;
+		for (int order = target; order < nr_orders(); order++) {
+			usable += nr_free_blocks(order) << order;
+		}
+
+		dprintf(" unusable_pct.order%d=%lu", target, nr_free ? ((nr_free - usable) * 100) / nr_free : 0);
+	}
+
+	dprintf("\n");
+}
+
+/**
+ * Allocates a fixed number of blocks of each order, then frees them, either in
+ * allocation order or in reverse.
+ */
+void page_allocator::benchmark_sequential(const char *pattern, bool reverse_free)
+{
+	reset_stats();
+
+	for (int order = 0; order <= bench_max_order; order++) {
+		int nr_allocated = 0;
+
+		for (int i = 0; i < bench_blocks_per_order; i++) {
+			u64 start = bench_timestamp();
+			page *pg = allocate_pages(order);
+			u64 end = bench_timestamp();
+
+			if (!pg) {
+				alloc_stats[order].failed++;
+				break;
+			}
+
+			alloc_stats[order].record(end - start);
+			bench_blocks[nr_allocated++] = pg;
+		}
+
+		for (int i = 0; i < nr_allocated; i++) {
+			page *pg = bench_blocks[reverse_free ? (nr_allocated - 1 - i) : i];
+
+			u64 start = bench_timestamp();
+			free_pages(*pg, order);
+			u64 end = bench_timestamp();
+
+			free_stats[order].record(end - start);
+		}
+	}
+
+	report_stats(pattern);
+	report_fragmentation(pattern);
+}
+
+/**
+ * Performs a random mix of allocations and frees over a fixed set of slots.  Orders are
+ * chosen from a geometric distribution, so small allocations dominate, as in a real
+ * workload.  Fragmentation is reported while the surviving allocations are still live.
+ */
+void page_allocator::benchmark_random(const char *pattern, u64 seed)
+{
+	reset_stats();
+
+	u64 state = seed ? seed : 1;
+
+	for (int i = 0; i < bench_random_slots; i++) {
+		random_blocks[i] = nullptr;
+	}
+
+	for (int op = 0; op < bench_random_ops; op++) {
+		u64 r = bench_random(state);
+		int slot = r % bench_random_slots;
+
+		if (random_blocks[slot]) {
+			int order = random_orders[slot];
+
+			u64 start = bench_timestamp();
+			free_pages(*random_blocks[slot], order);
+			u64 end = bench_timestamp();
+
+			free_stats[order].record(end - start);
+			random_blocks[slot] = nullptr;
+		} else {
+			u64 order_bits = bench_random(state);
+			int order = order_bits ? __builtin_ctzll(order_bits) : bench_max_order;
+			order = order > bench_max_order ? bench_max_order : order;
+
+			u64 start = bench_timestamp();
+			page *pg = allocate_pages(order);
+			u64 end = bench_timestamp();
+
+			if (!pg) {
+				alloc_stats[order].failed++;
+				continue;
+			}
+
+			alloc_stats[order].record(end - start);
+			random_blocks[slot] = pg;
+			random_orders[slot] = order;
+		}
+	}
+
+	report_stats(pattern);
+	report_fragmentation(pattern);
+
+	for (int i = 0; i < bench_random_slots; i++) {
+		if (random_blocks[i]) {
+			free_pages(*random_blocks[i], random_orders[i]);
+			random_blocks[i] = nullptr;
+		}
+	}
+}
+
+/**
+ * Runs the page allocator benchmark selected by PATTERN, which is one of "sequential",
+ * "reverse", "random" or "all".  Results are written to the debug console, one record per
+ * line, and the system is halted afterwards.
+ */
+void page_allocator::perform_benchmark(const char *pattern, u64 seed)
+{
+	bool all = memops::strcmp(pattern, "all") == 0;
+	bool known = all;
+
+	dprintf("pgalloc-bench: start allocator=%s pattern=%s seed=%lu free_pages=%lu\n", name(), pattern, seed, nr_free_pages());
+	report_fragmentation("initial");
+
+	if (all || memops::strcmp(pattern, "sequential") == 0) {
+		benchmark_sequential("sequential", false);
+		known = true;
+	}
+
+	if (all || memops::strcmp(pattern, "reverse") == 0) {
+		benchmark_sequential("reverse", true);
+		known = true;
+	}
+
+	if (all || memops::strcmp(pattern, "random") == 0) {
+		benchmark_random("random", seed);
+		known = true;
+	}
+
+	if (!known) {
+		dprintf("pgalloc-bench: error unknown pattern '%s'\n", pattern);
+	}
+
+	dprintf("pgalloc-bench: end\n");
+	abort();
+}
@@ -31,8 +31,54 @@ void page_allocator_buddy::dump() const
 	}
 }
 
+bool page_allocator_buddy::verify() const
+{
+	u64 total = 0;
+
+	for (int order = 0; order <= LastOrder; order++) {
+		u64 count = 0;
+
+		for (page *c = free_list_[order]; c; c = c->next_free_) {
+			if (!block_aligned(order, c->pfn())) {
+				dprintf("buddy: verify: block pfn=%lx is not aligned to order %d\n", c->pfn(), order);
+				return false;
+			}
+
+			page *next = c->next_free_;
+			if (next && next <= c) {
+				dprintf("buddy: verify: order %d list is not sorted at pfn=%lx\n", order, c->pfn());
+				return false;
+			}
+
+			// The list is sorted, so a lower buddy's partner can only be the next entry.
+			if (order < LastOrder && next && !(c->pfn() & pages_per_block(order)) && next->pfn() == (c->pfn() ^ pages_per_block(order))) {
+				dprintf("buddy: verify: order %d buddies pfn=%lx and pfn=%lx are not merged\n", order, c->pfn(), next->pfn());
+				return false;
+			}
+
+			count++;
+		}
+
+		if (count != free_blocks_[order]) {
+			dprintf("buddy: verify: order %d holds %lu blocks, but the counter says %lu\n", order, count, free_blocks_[order]);
+			return false;
+		}
+
+		total += count << order;
+	}
+
+	if (total != total_free_) {
+		dprintf("buddy: verify: free lists hold %lu pages, but the counter says %lu\n", total, total_free_);
+		return false;
+	}
+
+	return true;
+}
+
 void page_allocator_buddy::insert_pages(page &range_start, u64 page_count)
 {
+	unique_irq_lock l(lock_);
+
 	page *current = &range_start;
 	u64 remianing_pages = page_count;
 	while (remianing_pages > 0) {
@@ -74,6 +120,8 @@ page *page_allocator_buddy::get_block_from_page(int order, page &target)
 
 void page_allocator_buddy::remove_pages(page &range_start, u64 page_count)
 {
+	unique_irq_lock l(lock_);
+
 	page *current = &range_start;
 	u64 remaining_pages = page_count;
 	while (remaining_pages > 0) {
@@ -128,6 +176,9 @@ void page_allocator_buddy::insert_free_block(int order, page &block_start)
 
 	target->next_free_ = *slot;
 	*slot = target;
+
+	free_blocks_[order]++;
+	total_free_ += pages_per_block(order);
 }
 
 void page_allocator_buddy::remove_free_block(int order, page &block_start)
@@ -149,6 +200,9 @@ void page_allocator_buddy::remove_free_block(int order, page &block_start)
 
 	*candidate_slot = target->next_free_;
 	target->next_free_ = nullptr;
+
+	free_blocks_[order]--;
+	total_free_ -= pages_per_block(order);
 }
 
 void page_allocator_buddy::split_block(int order, page &block_start)
@@ -194,16 +248,23 @@ void page_allocator_buddy::merge_buddies(int order, page &buddy)
 
 page *page_allocator_buddy::allocate_pages(int order, page_allocation_flags flags)
 {
+	unique_irq_lock l(lock_);
+
 	// -1 to keep it DRY
 	int current_order = order - 1;
 	page *block = nullptr;
 
 	// Go up in order until we find a free block (-1 accommodates for the current order)
-	while (!block && current_order <= LastOrder) {
+	while (!block && current_order < LastOrder) {
 		current_order += 1;
 		block = free_list_[current_order];
 	}
 
+	// Out of memory: there is no block of this order, or any larger order, to split
+	if (!block) {
+		return nullptr;
+	}
+
 	// Then, go down however many steps we took, splitting the first block we find
 	// This will not run if current_order == order
 	for (; current_order > order; current_order--) {
@@ -212,13 +273,22 @@ page *page_allocator_buddy::allocate_pages(int order, page_allocation_flags flag
 
 	// Finally, we have our page
 	// The two loops will not loop if there already exists a block in the desired order
-	// nullcheck before deference. The allocator will return a nullptr if we're out of memory
-	if (block) remove_free_block(order, *block);
+	remove_free_block(order, *block);
+
+	// The block belongs to the caller now, so there is no need to hold the lock while zeroing it.
+	l.unlock();
+
+	if ((flags & page_allocation_flags::zero) == page_allocation_flags::zero) {
+		memops::pzero(block->base_address_ptr(), pages_per_block(order));
+	}
+
 	return block;
 }
 
 void page_allocator_buddy::free_pages(page &block_start, int order)
 {
+	unique_irq_lock l(lock_);
+
 	// Possible to combine merge_buddies into insert_free_block
 	// Since merge_buddies is usually called right after inserting a block
 	insert_free_block(order, block_start);
@@ -7,11 +7,15 @@
  */
 #include <stacsos/kernel/debug.h>
 #include <stacsos/kernel/mem/page-allocator-linear.h>
+#include <stacsos/memops.h>
 
+using namespace stacsos::kernel;
 using namespace stacsos::kernel::mem;
 
 void page_allocator_linear::insert_pages(page &range_start, u64 page_count)
 {
+	unique_irq_lock l(lock_);
+
 	page **slot = &free_list_;
 
 	while (*slot) {
@@ -20,10 +24,14 @@ void page_allocator_linear::insert_pages(page &range_start, u64 page_count)
 
 	*slot = &range_start;
 	range_start.free_block_size_ = page_count;
+
+	total_free_ += page_count;
 }
 
 void page_allocator_linear::remove_pages(page &range_start_r, u64 page_count)
 {
+	unique_irq_lock l(lock_);
+
 	page *free_block = free_list_;
 
 	while (free_block) {
@@ -40,11 +48,12 @@ void page_allocator_linear::remove_pages(page &range_start_r, u64 page_count)
 			u64 offset = range_start - free_block_start;
 			// dprintf("  offset=%lx\n", offset);
 
-			free_block->free_block_size_ = offset;
-
 			u64 remainder_pages = range_end > free_block_end ? 0 : free_block_end - range_end;
 			// dprintf("  remainder=%lx\n", remainder_pages);
 
+			total_free_ -= free_block->free_block_size_ - (offset + remainder_pages);
+			free_block->free_block_size_ = offset;
+
 			if (remainder_pages) {
 				page *tmp_next_free = free_block->next_free_;
 
@@ -67,14 +76,25 @@ page *page_allocator_linear::allocate_pages(int order, page_allocation_flags fla
 	// find a free block with enough pages
 	// take from the end, so we can just reduce the free block size
 
+	unique_irq_lock l(lock_);
+
 	page *free_block = free_list_;
 
 	while (free_block) {
 		if (free_block->free_block_size_ >= page_count) {
 			free_block->free_block_size_ -= page_count;
+			total_free_ -= page_count;
 
 			u64 start_pfn = free_block->pfn() + free_block->free_block_size_;
-			return &page::get_from_pfn(start_pfn);
+			page *block = &page::get_from_pfn(start_pfn);
+
+			l.unlock();
+
+			if ((flags & page_allocation_flags::zero) == page_allocation_flags::zero) {
+				memops::pzero(block->base_address_ptr(), page_count);
+			}
+
+			return block;
 		}
 
 		free_block = free_block->next_free_;
@@ -88,6 +108,19 @@ void page_allocator_linear::free_pages(page &base, int order)
 	// TODO
 }
 
+int page_allocator_linear::largest_free_order() const
+{
+	u64 largest_block = 0;
+
+	for (page *free_block = free_list_; free_block; free_block = free_block->next_free_) {
+		largest_block = max(largest_block, free_block->free_block_size_);
+	}
+
+	// Blocks are carved from the end of a free block without any alignment requirement, so any
+	// power of two that fits is allocatable.
+	return largest_block ? (int)log2(largest_block) : -1;
+}
+
 void page_allocator_linear::dump() const
 {
 	page *free_block = free_list_;
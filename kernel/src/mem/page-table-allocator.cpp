@@ -10,7 +10,12 @@ page *page_table_allocator::allocate()
 		panic("unable to allocate page table");
 	}
 
+	nr_pages_++;
 	return p;
 }
 
-void page_table_allocator::free(page *pg) { memory_manager::get().pgalloc().free_pages(*pg, 0); }
+void page_table_allocator::free(page *pg)
+{
+	memory_manager::get().pgalloc().free_pages(*pg, 0);
+	nr_pages_--;
+}
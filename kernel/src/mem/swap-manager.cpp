@@ -0,0 +1,406 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/arch/ipi.h>
+#include <stacsos/kernel/config.h>
+#include <stacsos/kernel/debug.h>
+#include <stacsos/kernel/dev/device-manager.h>
+#include <stacsos/kernel/dev/storage/block-device.h>
+#include <stacsos/kernel/mem/address-space.h>
+#include <stacsos/kernel/mem/memory-manager.h>
+#include <stacsos/kernel/mem/page.h>
+#include <stacsos/kernel/mem/swap-manager.h>
+#include <stacsos/kernel/sched/process-manager.h>
+#include <stacsos/kernel/sched/sleeper.h>
+#include <stacsos/memops.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::arch;
+using namespace stacsos::kernel::dev;
+using namespace stacsos::kernel::dev::storage;
+using namespace stacsos::kernel::mem;
+using namespace stacsos::kernel::sched;
+
+/**
+ * Configures the swap area from the kernel command-line.  Swap is enabled with swap=<device>, and
+ * the area on that device can be restricted to a reserved range of blocks with swap-start=<block>
+ * and swap-size=<pages>.  If no swap device is given, swapping is disabled.
+ */
+void swap_manager::init()
+{
+	const char *swap_device_name = config::get().get_option("swap");
+	if (!swap_device_name || !*swap_device_name) {
+		dprintf("swap: disabled\n");
+		return;
+	}
+
+	device *dev;
+	if (!device_manager::get().try_get_device_by_name(string(swap_device_name), dev)) {
+		dprintf("swap: device '%s' not found\n", swap_device_name);
+		return;
+	}
+
+	if (!dev->devclass().is_a(block_device::block_device_class)) {
+		dprintf("swap: device '%s' is not a block device\n", swap_device_name);
+		return;
+	}
+
+	block_device *bdev = (block_device *)dev;
+
+	first_block_ = config::get().get_option_u64_or_default("swap-start", 0);
+	if (first_block_ >= bdev->nr_blocks()) {
+		dprintf("swap: start block %lu is beyond the end of the device\n", first_block_);
+		return;
+	}
+
+	u64 max_slots = (bdev->nr_blocks() - first_block_) / blocks_per_slot;
+	nr_slots_ = min(config::get().get_option_u64_or_default("swap-size", max_slots), max_slots);
+	if (nr_slots_ == 0) {
+		dprintf("swap: swap area is empty\n");
+		return;
+	}
+
+	u64 bitmap_words = (nr_slots_ + 63) / 64;
+	slot_bitmap_ = new u64[bitmap_words];
+	memops::bzero(slot_bitmap_, bitmap_words * sizeof(u64));
+	in_flight_bitmap_ = new u64[bitmap_words];
+	memops::bzero(in_flight_bitmap_, bitmap_words * sizeof(u64));
+
+	nr_free_slots_ = nr_slots_;
+	next_slot_ = 0;
+	bdev_ = bdev;
+
+	dprintf("swap: using '%s' blocks %lu--%lu (%lu slots)\n", swap_device_name, first_block_, slot_to_block(nr_slots_) - 1, nr_slots_);
+
+	process_manager::get().create_kernel_process(reclaim_thread_main)->start();
+}
+
+/**
+ * Allocates a single page for anonymous memory, with the given allocation flags.  If the page
+ * allocator is exhausted, pages are reclaimed directly into swap before retrying.
+ */
+page *swap_manager::allocate_anonymous_page(page_allocation_flags flags)
+{
+	auto &pgalloc = memory_manager::get().pgalloc();
+
+	page *pg = pgalloc.allocate_pages(0, flags);
+	if (!pg && enabled()) {
+		reclaim(high_watermark);
+		pg = pgalloc.allocate_pages(0, flags);
+	}
+
+	if (!pg) {
+		panic("out of memory");
+	}
+
+	return pg;
+}
+
+/**
+ * Adds a resident anonymous page, mapped at the given virtual address, to the LRU list so that it
+ * can be considered for reclaim.
+ */
+void swap_manager::track_page(address_space &as, u64 virtual_address, page &pg)
+{
+	if (!enabled()) {
+		return;
+	}
+
+	auto rp = new resident_page { nullptr, nullptr, &as, PAGE_ALIGN_DOWN(virtual_address), &pg };
+
+	unique_irq_lock l(lock_);
+	lru_append(rp);
+}
+
+/**
+ * Attempts to bring a swapped-out page back into memory, in response to a page fault on the given
+ * virtual address.  Returns false if the address does not refer to a swapped-out page.
+ */
+bool swap_manager::try_swap_in(address_space &as, u64 virtual_address)
+{
+	if (!enabled()) {
+		return false;
+	}
+
+	virtual_address = PAGE_ALIGN_DOWN(virtual_address);
+
+	unique_irq_lock l(lock_);
+
+	page_table_entry *entry = as.pgtable().get_pte(virtual_address);
+	if (!entry || entry->present() || !entry->swapped()) {
+		return false;
+	}
+
+	u64 slot = entry->base_address() >> PAGE_BITS;
+
+	// The page is still being written out, or another thread is already reading it back in.  Wait
+	// for that to finish, and let the faulting access be retried.
+	if (slot_in_flight(slot)) {
+		l.unlock();
+		in_flight_wq_.wait_event([this, slot] { return !slot_in_flight(slot); });
+		return true;
+	}
+
+	// The disk read is polled, and a page fault runs with interrupts enabled if the faulting code
+	// had them, so the read happens with the lock dropped, rather than holding up other cores.  The
+	// page is overwritten by the read, so it need not be zeroed.
+	mark_in_flight(slot);
+	l.unlock();
+
+	page *pg = allocate_anonymous_page(page_allocation_flags::none);
+	bdev_->read_blocks_sync(pg->base_address_ptr(), slot_to_block(slot), blocks_per_slot);
+
+	l.lock();
+
+	free_slot(slot);
+	clear_in_flight(slot);
+
+	// The access permissions were left in place when the page was swapped out, so only the
+	// frame and the present bit need restoring.
+	entry->swapped(false);
+	entry->base_address(pg->base_address());
+	entry->present(true);
+	page_table::flush(virtual_address);
+
+	lru_append(new resident_page { nullptr, nullptr, &as, virtual_address, pg });
+	as.nr_resident_pages_++;
+	nr_swapped_in_++;
+
+	l.unlock();
+	in_flight_wq_.wake_all();
+
+	return true;
+}
+
+/**
+ * Reads the 32-bit word at the given virtual address without faulting, for callers that hold a
+ * spinlock.  Returns false if the page is not resident, e.g. because it has been swapped out, in
+ * which case the caller should fault it back in with the lock released, and try again.  The word
+ * must not cross a page boundary, and the address must already have been mapped.
+ */
+bool swap_manager::read_resident_word(address_space &as, u64 virtual_address, u32 &value)
+{
+	// Only 4k pages of anonymous memory are ever reclaimed, so anything else stays put.
+	if (!enabled()) {
+		value = *(volatile u32 *)virtual_address;
+		return true;
+	}
+
+	unique_irq_lock l(lock_);
+
+	page_table_entry *entry = as.pgtable().get_pte(virtual_address);
+	if (!entry) {
+		value = *(volatile u32 *)virtual_address;
+		return true;
+	}
+
+	if (!entry->present()) {
+		return false;
+	}
+
+	// Reclaim unmaps a page with the lock held, so it cannot take this one away during the read.
+	value = *(volatile u32 *)phys_to_virt(entry->base_address() + (virtual_address & (PAGE_SIZE - 1)));
+	return true;
+}
+
+/**
+ * Writes up to NR_PAGES of the least recently used anonymous pages out to swap, and returns
+ * the number of pages that were actually freed.
+ */
+u64 swap_manager::reclaim(u64 nr_pages)
+{
+	if (!enabled()) {
+		return 0;
+	}
+
+	// Clearing an accessed bit only needs other cores to notice eventually, so those flushes are
+	// batched up.  TLB shootdowns wait for other cores, so they are never issued with the lock
+	// held, and the batch is flushed after the lock is released.
+	tlb_batch accessed_flushes;
+
+	unique_irq_lock l(lock_);
+
+	// Each page gets at most one second chance, so two passes over the list are enough to find
+	// every candidate.
+	u64 budget = nr_resident_ * 2;
+	u64 reclaimed = 0;
+
+	while (reclaimed < nr_pages && budget-- > 0 && lru_head_) {
+		resident_page *rp = lru_head_;
+		lru_remove(rp);
+
+		page_table_entry *entry = rp->as->pgtable().get_pte(rp->virtual_address);
+		if (!entry || !entry->present()) {
+			delete rp;
+			continue;
+		}
+
+		// Recently referenced pages are given a second chance, and go to the back of the list.
+		if (entry->a()) {
+			entry->a(false);
+			lru_append(rp);
+
+			u64 cr3 = rp->as->pgtable().effective_cr3();
+			if (accessed_flushes.flushes_on_add(cr3)) {
+				l.unlock();
+				accessed_flushes.flush();
+				l.lock();
+			}
+
+			accessed_flushes.add(cr3, rp->virtual_address);
+			continue;
+		}
+
+		u64 slot;
+		if (!allocate_slot(slot)) {
+			lru_append(rp);
+			break;
+		}
+
+		// Unmap the page before writing it out, so that its contents cannot change underneath us.
+		// The page is off the LRU list and its slot is in flight, so nothing else touches either
+		// while the lock is dropped for the shootdown and the write.
+		entry->present(false);
+		entry->swapped(true);
+		entry->base_address(slot << PAGE_BITS);
+		mark_in_flight(slot);
+
+		l.unlock();
+		swap_out(rp, slot);
+		l.lock();
+
+		clear_in_flight(slot);
+		rp->as->nr_resident_pages_--;
+		nr_swapped_out_++;
+
+		delete rp;
+		reclaimed++;
+
+		in_flight_wq_.wake_all();
+	}
+
+	return reclaimed;
+}
+
+/**
+ * Writes RP's page out to SLOT, and frees it.  The page must already be unmapped, and the slot
+ * marked in flight.  Called without the lock held.
+ */
+void swap_manager::swap_out(resident_page *rp, u64 slot)
+{
+	// Any core running in the address space may still have the page in its TLB, so they all have
+	// to flush it first.  User mappings are not global, and are discarded when CR3 is reloaded on a
+	// context switch, so other cores are unaffected.
+	ipi_manager::get().flush_tlb(rp->as->pgtable().effective_cr3(), rp->virtual_address, rp->virtual_address + PAGE_SIZE);
+
+	bdev_->write_blocks_sync(rp->pg->base_address_ptr(), slot_to_block(slot), blocks_per_slot);
+
+	memory_manager::get().pgalloc().free_pages(*rp->pg, 0);
+}
+
+bool swap_manager::allocate_slot(u64 &slot)
+{
+	if (nr_free_slots_ == 0) {
+		return false;
+	}
+
+	for (u64 i = 0; i < nr_slots_; i++) {
+		u64 candidate = (next_slot_ + i) % nr_slots_;
+		u64 &word = slot_bitmap_[candidate / 64];
+		u64 bit = 1ull << (candidate % 64);
+
+		if (!(word & bit)) {
+			word |= bit;
+			nr_free_slots_--;
+
+			next_slot_ = candidate + 1;
+			slot = candidate;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void swap_manager::free_slot(u64 slot)
+{
+	assert(slot < nr_slots_);
+
+	u64 &word = slot_bitmap_[slot / 64];
+	u64 bit = 1ull << (slot % 64);
+
+	assert(word & bit);
+
+	word &= ~bit;
+	nr_free_slots_++;
+}
+
+void swap_manager::mark_in_flight(u64 slot)
+{
+	u64 &word = in_flight_bitmap_[slot / 64];
+	__atomic_store_n(&word, word | (1ull << (slot % 64)), __ATOMIC_RELEASE);
+}
+
+void swap_manager::clear_in_flight(u64 slot)
+{
+	u64 &word = in_flight_bitmap_[slot / 64];
+	__atomic_store_n(&word, word & ~(1ull << (slot % 64)), __ATOMIC_RELEASE);
+}
+
+void swap_manager::lru_append(resident_page *rp)
+{
+	rp->next = nullptr;
+	rp->prev = lru_tail_;
+
+	if (lru_tail_) {
+		lru_tail_->next = rp;
+	} else {
+		lru_head_ = rp;
+	}
+
+	lru_tail_ = rp;
+	nr_resident_++;
+}
+
+void swap_manager::lru_remove(resident_page *rp)
+{
+	if (rp->prev) {
+		rp->prev->next = rp->next;
+	} else {
+		lru_head_ = rp->next;
+	}
+
+	if (rp->next) {
+		rp->next->prev = rp->prev;
+	} else {
+		lru_tail_ = rp->prev;
+	}
+
+	rp->prev = rp->next = nullptr;
+	nr_resident_--;
+}
+
+/**
+ * Background reclaim: periodically checks free memory against the watermarks, and pushes pages
+ * out to swap before allocations start failing.
+ */
+void swap_manager::reclaim_thread_main()
+{
+	auto &sm = swap_manager::get();
+	auto &pgalloc = memory_manager::get().pgalloc();
+
+	while (true) {
+		u64 nr_free = pgalloc.nr_free_pages();
+		if (nr_free < low_watermark) {
+			u64 reclaimed = sm.reclaim(high_watermark - nr_free);
+			dprintf("swap: reclaimed %lu pages (free=%lu, swap-free=%lu)\n", reclaimed, pgalloc.nr_free_pages(), sm.nr_free_slots());
+		}
+
+		sleeper::get().sleep_ms(reclaim_interval_ms);
+	}
+}
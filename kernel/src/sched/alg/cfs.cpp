@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/sched/alg/cfs.h>
+#include <stacsos/kernel/sched/schedulable-entity.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel::sched;
+using namespace stacsos::kernel::sched::alg;
+
+// Weights for nice levels -20 to 19.  Each level is worth roughly 10% of CPU time relative to its
+// neighbours, as in Linux.
+static const u64 nice_weights[40] = {
+	/* -20 */ 88761, 71755, 56483, 46273, 36291,
+	/* -15 */ 29154, 23254, 18705, 14949, 11916,
+	/* -10 */ 9548, 7620, 6100, 4904, 3906,
+	/*  -5 */ 3121, 2501, 1991, 1586, 1277,
+	/*   0 */ 1024, 820, 655, 526, 423,
+	/*   5 */ 335, 272, 215, 172, 137,
+	/*  10 */ 110, 87, 70, 56, 45,
+	/*  15 */ 36, 29, 23, 18, 15,
+};
+
+static bool vruntime_less(rb_node *a, rb_node *b) { return tcb_from_run_node(a)->vruntime < tcb_from_run_node(b)->vruntime; }
+
+u64 completely_fair_scheduler::nice_to_weight(s64 nice)
+{
+	if (nice < -20) {
+		nice = -20;
+	} else if (nice > 19) {
+		nice = 19;
+	}
+
+	return nice_weights[nice + 20];
+}
+
+/*
+ * Charges TCB with the run time it has accumulated since it was last charged, scaled by its weight.
+ */
+void completely_fair_scheduler::update_vruntime(tcb &tcb)
+{
+	u64 delta = tcb.run_time - tcb.vruntime_sync;
+	tcb.vruntime_sync = tcb.run_time;
+
+	tcb.vruntime += (delta * nice_0_weight) / nice_to_weight(tcb.nice);
+}
+
+void completely_fair_scheduler::enqueue(tcb &tcb) { runqueue_.insert(&tcb.run_node, vruntime_less); }
+
+void completely_fair_scheduler::add_to_runqueue(tcb &tcb)
+{
+	if (tcb.run_node.linked) {
+		return;
+	}
+
+	// A task that has been away (or is new) keeps any virtual run time it is owed, but no more than
+	// the queue's minimum: otherwise it would hold the core until it caught up with everyone else.
+	tcb.vruntime = max(tcb.vruntime, min_vruntime_);
+	tcb.vruntime_sync = tcb.run_time;
+
+	enqueue(tcb);
+}
+
+void completely_fair_scheduler::remove_from_runqueue(tcb &tcb)
+{
+	if (!tcb.run_node.linked) {
+		return;
+	}
+
+	update_vruntime(tcb);
+	runqueue_.remove(&tcb.run_node);
+}
+
+void completely_fair_scheduler::migrate_out(tcb &tcb)
+{
+	// A task that has been asleep may be behind the minimum, but would be raised to it on waking
+	// anyway.
+	tcb.vruntime = tcb.vruntime > min_vruntime_ ? tcb.vruntime - min_vruntime_ : 0;
+}
+
+void completely_fair_scheduler::migrate_in(tcb &tcb) { tcb.vruntime += min_vruntime_; }
+
+bool completely_fair_scheduler::contains(const tcb &tcb) const { return tcb.run_node.linked; }
+
+tcb *completely_fair_scheduler::select_next_task(tcb *current)
+{
+	// The current task stays in the tree while it runs, so its key is stale.  Charge it, and move
+	// it to its new position.
+	if (current && current->run_node.linked) {
+		runqueue_.remove(&current->run_node);
+		update_vruntime(*current);
+		enqueue(*current);
+	}
+
+	rb_node *first = runqueue_.first();
+	if (!first) {
+		return nullptr;
+	}
+
+	tcb *next = tcb_from_run_node(first);
+	min_vruntime_ = max(min_vruntime_, next->vruntime);
+
+	return next;
+}
+
+tcb *completely_fair_scheduler::select_migration_candidate(tcb *exclude_a, tcb *exclude_b, int target_core)
+{
+	tcb *candidate = nullptr;
+
+	// The task that stopped running longest ago has the coldest cache.
+	for (rb_node *n = runqueue_.first(); n; n = rb_tree::next(n)) {
+		tcb *t = tcb_from_run_node(n);
+		if (t == exclude_a || t == exclude_b || !t->entity->allowed_on(target_core)) {
+			continue;
+		}
+
+		if (candidate == nullptr || t->stop_time < candidate->stop_time) {
+			candidate = t;
+		}
+	}
+
+	return candidate;
+}
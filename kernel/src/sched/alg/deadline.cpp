@@ -0,0 +1,180 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/sched/alg/deadline.h>
+#include <stacsos/kernel/sched/schedulable-entity.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel::sched;
+using namespace stacsos::kernel::sched::alg;
+
+// A throttled task gets its budget back at the start of its next period.
+static inline u64 replenish_time(const tcb &t) { return t.dl_abs_deadline - t.dl_deadline + t.dl_period; }
+
+static bool deadline_less(rb_node *a, rb_node *b) { return tcb_from_dl_node(a)->dl_abs_deadline < tcb_from_dl_node(b)->dl_abs_deadline; }
+static bool replenish_less(rb_node *a, rb_node *b) { return replenish_time(*tcb_from_dl_node(a)) < replenish_time(*tcb_from_dl_node(b)); }
+
+/*
+ * Charges TCB's budget with the run time it has accumulated since it was last charged.
+ */
+void deadline_scheduler::charge(tcb &tcb)
+{
+	u64 delta = tcb.run_time - tcb.dl_sync;
+	tcb.dl_sync = tcb.run_time;
+	tcb.dl_budget -= (s64)delta;
+}
+
+void deadline_scheduler::check_missed(tcb &tcb, u64 now)
+{
+	if (!tcb.dl_missed && now > tcb.dl_abs_deadline) {
+		tcb.dl_missed = true;
+		tcb.dl_misses++;
+	}
+}
+
+void deadline_scheduler::throttle(tcb &tcb)
+{
+	tcb.dl_throttled = true;
+	throttled_.insert(&tcb.dl_node, replenish_less);
+}
+
+void deadline_scheduler::add_to_runqueue(tcb &tcb)
+{
+	if (tcb.dl_node.linked) {
+		return;
+	}
+
+	u64 now = __builtin_ia32_rdtsc();
+
+	// Catch up on time the task ran before it last blocked.
+	charge(tcb);
+
+	// The CBS wakeup rule: the task keeps its deadline and what is left of its budget, unless using
+	// that budget before the deadline would take more than its reserved bandwidth.  In that case, or
+	// once the deadline has passed, it starts afresh.
+	u64 budget = tcb.dl_budget > 0 ? tcb.dl_budget : 0;
+	if (now >= tcb.dl_abs_deadline || (unsigned __int128)budget * tcb.dl_period > (unsigned __int128)tcb.dl_runtime * (tcb.dl_abs_deadline - now)) {
+		tcb.dl_abs_deadline = now + tcb.dl_deadline;
+		tcb.dl_budget = tcb.dl_runtime;
+		tcb.dl_missed = false;
+		tcb.dl_yielded = false;
+	}
+
+	if (tcb.dl_budget <= 0) {
+		throttle(tcb);
+	} else {
+		ready_.insert(&tcb.dl_node, deadline_less);
+	}
+}
+
+void deadline_scheduler::remove_from_runqueue(tcb &tcb)
+{
+	if (!tcb.dl_node.linked) {
+		return;
+	}
+
+	if (tcb.dl_throttled) {
+		throttled_.remove(&tcb.dl_node);
+		tcb.dl_throttled = false;
+	} else {
+		ready_.remove(&tcb.dl_node);
+	}
+}
+
+bool deadline_scheduler::contains(const tcb &tcb) const { return tcb.dl_node.linked; }
+
+void deadline_scheduler::yield(tcb &tcb)
+{
+	if (!tcb.dl_node.linked || tcb.dl_throttled) {
+		return;
+	}
+
+	charge(tcb);
+
+	ready_.remove(&tcb.dl_node);
+	tcb.dl_budget = 0;
+	tcb.dl_yielded = true;
+	throttle(tcb);
+}
+
+void deadline_scheduler::replenish_expired(u64 now)
+{
+	rb_node *n;
+	while ((n = throttled_.first()) && replenish_time(*tcb_from_dl_node(n)) <= now) {
+		tcb &t = *tcb_from_dl_node(n);
+
+		throttled_.remove(n);
+		t.dl_throttled = false;
+
+		// A task that ran out of budget, rather than finishing early, still had work to do when its
+		// deadline passed.
+		if (!t.dl_yielded) {
+			if (!t.dl_missed) {
+				t.dl_misses++;
+			}
+
+			t.dl_overruns++;
+		}
+
+		// Move on a period at a time, until the task has budget again.  A task that has fallen more
+		// than a period behind starts again from now.
+		do {
+			t.dl_abs_deadline += t.dl_period;
+			t.dl_budget += t.dl_runtime;
+		} while (t.dl_budget <= 0);
+
+		if (replenish_time(t) <= now) {
+			t.dl_abs_deadline = now + t.dl_deadline;
+			t.dl_budget = t.dl_runtime;
+		}
+
+		t.dl_missed = false;
+		t.dl_yielded = false;
+		ready_.insert(&t.dl_node, deadline_less);
+	}
+}
+
+tcb *deadline_scheduler::select_next_task(tcb *current)
+{
+	u64 now = __builtin_ia32_rdtsc();
+
+	if (current && current->dl_node.linked && !current->dl_throttled) {
+		charge(*current);
+		check_missed(*current, now);
+
+		if (current->dl_budget <= 0) {
+			ready_.remove(&current->dl_node);
+			throttle(*current);
+		}
+	}
+
+	replenish_expired(now);
+
+	rb_node *first = ready_.first();
+	return first ? tcb_from_dl_node(first) : nullptr;
+}
+
+u64 deadline_scheduler::next_event(const tcb *current, u64 now) const
+{
+	u64 event = 0;
+
+	rb_node *first = throttled_.first();
+	if (first) {
+		event = replenish_time(*tcb_from_dl_node(first));
+	}
+
+	if (current && current->policy == sched_policy::deadline && current->dl_node.linked && !current->dl_throttled) {
+		// The budget may not have been charged for the task's latest run time yet.
+		s64 budget = current->dl_budget - (s64)(current->run_time - current->dl_sync);
+		u64 exhausted = now + (budget > 0 ? budget : 0);
+		if (event == 0 || exhausted < event) {
+			event = exhausted;
+		}
+	}
+
+	return event;
+}
@@ -6,6 +6,7 @@
  * Tom Spink <tcs6@st-andrews.ac.uk>
  */
 #include <stacsos/kernel/sched/alg/rr.h>
+#include <stacsos/kernel/sched/schedulable-entity.h>
 
 // *** COURSEWORK NOTE *** //
 // This will be where you are implementing your round-robin scheduling algorithm.
@@ -15,32 +16,50 @@
 using namespace stacsos::kernel::sched;
 using namespace stacsos::kernel::sched::alg;
 
-void round_robin::add_to_runqueue(tcb &tcb) {
-	tcb_list.enqueue(&tcb);
+void round_robin::add_to_runqueue(tcb &tcb)
+{
+	if (!intrusive_list::linked(&tcb.run_link)) {
+		tcb_list.push_back(&tcb.run_link);
+	}
 }
 
-void round_robin::remove_from_runqueue(tcb &tcb) {
-	tcb_list.remove(&tcb);
+void round_robin::remove_from_runqueue(tcb &tcb)
+{
+	if (intrusive_list::linked(&tcb.run_link)) {
+		tcb_list.remove(&tcb.run_link);
+	}
 }
 
-tcb *round_robin::select_next_task(tcb *current) {
+bool round_robin::contains(const tcb &tcb) const { return intrusive_list::linked(&tcb.run_link); }
+
+tcb *round_robin::select_next_task(tcb *current)
+{
 	if (tcb_list.empty()) {
 		return nullptr;
 	}
 
 	// A true RR implementation does time slicing to each process,
 	// however, I couldn't find a way to implement from editing rr.h and rr.cpp only.
-	
-	// Avoid modifying the list if there's only one elemet
-	if (tcb_list.count() == 1) {
-		return tcb_list.first();
+
+	// Take the next in line, and move it to the back of the queue.
+	return tcb_from_run_link(tcb_list.rotate());
+}
+
+tcb *round_robin::select_migration_candidate(tcb *exclude_a, tcb *exclude_b, int target_core)
+{
+	tcb *candidate = nullptr;
+
+	// The task that stopped running longest ago has the coldest cache.
+	for (list_link *l = tcb_list.first(); l; l = tcb_list.next(l)) {
+		tcb *t = tcb_from_run_link(l);
+		if (t == exclude_a || t == exclude_b || !t->entity->allowed_on(target_core)) {
+			continue;
+		}
+
+		if (candidate == nullptr || t->stop_time < candidate->stop_time) {
+			candidate = t;
+		}
 	}
-	
-	// Get the next in line and remove it from the list
-	tcb *first = tcb_list.dequeue();
-	// Add it back to the end of the list 
-	// A Circular LL would give constant time, but currenty it's O(n)
-	tcb_list.enqueue(first);
-
-	return first;
+
+	return candidate;
 }
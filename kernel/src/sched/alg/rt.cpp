@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/sched/alg/rt.h>
+#include <stacsos/kernel/sched/schedulable-entity.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel::sched;
+using namespace stacsos::kernel::sched::alg;
+
+void realtime_scheduler::add_to_runqueue(tcb &tcb)
+{
+	if (intrusive_list::linked(&tcb.rt_link)) {
+		return;
+	}
+
+	int prio = tcb.rt_priority;
+	queues_[prio].push_back(&tcb.rt_link);
+	bitmap_[prio / 64] |= 1ull << (prio % 64);
+	nr_runnable_++;
+}
+
+void realtime_scheduler::remove_from_runqueue(tcb &tcb)
+{
+	if (!intrusive_list::linked(&tcb.rt_link)) {
+		return;
+	}
+
+	int prio = tcb.rt_priority;
+	queues_[prio].remove(&tcb.rt_link);
+	if (queues_[prio].empty()) {
+		bitmap_[prio / 64] &= ~(1ull << (prio % 64));
+	}
+
+	nr_runnable_--;
+
+	if (slice_owner_ == &tcb) {
+		slice_owner_ = nullptr;
+	}
+}
+
+bool realtime_scheduler::contains(const tcb &tcb) const { return intrusive_list::linked(&tcb.rt_link); }
+
+void realtime_scheduler::requeue(tcb &tcb)
+{
+	if (!intrusive_list::linked(&tcb.rt_link)) {
+		return;
+	}
+
+	auto &queue = queues_[tcb.rt_priority];
+	queue.remove(&tcb.rt_link);
+	queue.push_back(&tcb.rt_link);
+
+	if (slice_owner_ == &tcb) {
+		slice_owner_ = nullptr;
+	}
+}
+
+int realtime_scheduler::highest_priority() const
+{
+	if (bitmap_[1]) {
+		return 127 - __builtin_clzll(bitmap_[1]);
+	}
+
+	if (bitmap_[0]) {
+		return 63 - __builtin_clzll(bitmap_[0]);
+	}
+
+	return 0;
+}
+
+tcb *realtime_scheduler::select_next_task(tcb *current)
+{
+	// An rr task that has used up its timeslice lets the others at its priority have a turn.
+	if (current && current == slice_owner_ && current->policy == sched_policy::rr && current->run_time - slice_start_ >= timeslice_) {
+		requeue(*current);
+	}
+
+	int prio = highest_priority();
+	if (prio == 0) {
+		return nullptr;
+	}
+
+	tcb *next = tcb_from_rt_link(queues_[prio].first());
+
+	if (next != slice_owner_) {
+		slice_owner_ = next;
+		slice_start_ = next->run_time;
+	}
+
+	return next;
+}
@@ -9,26 +9,62 @@
 #include <stacsos/kernel/sched/alg/sfs.h>
 #include <stacsos/kernel/sched/schedulable-entity.h>
 
+using namespace stacsos;
 using namespace stacsos::kernel::sched;
 using namespace stacsos::kernel::sched::alg;
 
-tcb *simple_fair_scheduler::select_next_task(tcb *current)
+// The tree is keyed on vruntime, which for this scheduler is just the run time at the point the
+// task was queued or last charged.  The core updates run_time while a task runs, so it cannot be
+// the key itself.
+static bool run_time_less(rb_node *a, rb_node *b) { return tcb_from_run_node(a)->vruntime < tcb_from_run_node(b)->vruntime; }
+
+void simple_fair_scheduler::enqueue(tcb &tcb)
+{
+	tcb.vruntime = tcb.run_time;
+	runqueue_.insert(&tcb.run_node, run_time_less);
+}
+
+void simple_fair_scheduler::add_to_runqueue(tcb &tcb)
+{
+	if (!tcb.run_node.linked) {
+		enqueue(tcb);
+	}
+}
+
+void simple_fair_scheduler::remove_from_runqueue(tcb &tcb)
 {
-	if (runqueue_.empty()) {
-		return nullptr;
+	if (tcb.run_node.linked) {
+		runqueue_.remove(&tcb.run_node);
 	}
+}
+
+bool simple_fair_scheduler::contains(const tcb &tcb) const { return tcb.run_node.linked; }
 
-	if (runqueue_.count() == 1) {
-		return runqueue_.first();
+tcb *simple_fair_scheduler::select_next_task(tcb *current)
+{
+	// Only the current task has run since it was queued, so only its key is stale.
+	if (current && current->run_node.linked) {
+		runqueue_.remove(&current->run_node);
+		enqueue(*current);
 	}
 
-	u64 min_runtime = 0;
+	rb_node *first = runqueue_.first();
+	return first ? tcb_from_run_node(first) : nullptr;
+}
+
+tcb *simple_fair_scheduler::select_migration_candidate(tcb *exclude_a, tcb *exclude_b, int target_core)
+{
 	tcb *candidate = nullptr;
 
-	for (auto *thread : runqueue_) {
-		if (candidate == nullptr || (thread->run_time < min_runtime)) {
-			min_runtime = thread->run_time;
-			candidate = thread;
+	// The task that stopped running longest ago has the coldest cache.
+	for (rb_node *n = runqueue_.first(); n; n = rb_tree::next(n)) {
+		tcb *t = tcb_from_run_node(n);
+		if (t == exclude_a || t == exclude_b || !t->entity->allowed_on(target_core)) {
+			continue;
+		}
+
+		if (candidate == nullptr || t->stop_time < candidate->stop_time) {
+			candidate = t;
 		}
 	}
 
@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/arch/core-manager.h>
+#include <stacsos/kernel/arch/core.h>
+#include <stacsos/kernel/sched/cpu-quota.h>
+
+using namespace stacsos::kernel::sched;
+using namespace stacsos::kernel::arch;
+
+cpu_quota::~cpu_quota()
+{
+	configure(0, 0);
+
+	// The timer callback may have re-armed the timer while the first cancellation waited for it,
+	// but it will not do so again now that the quota is unlimited.
+	timer_wheel::cancel(refill_timer_);
+}
+
+void cpu_quota::configure(u64 quota, u64 period)
+{
+	u64 end = __builtin_ia32_rdtsc() + period;
+
+	{
+		unique_irq_lock l(lock_);
+
+		quota_ = quota;
+		period_ = period;
+		used_ = 0;
+		period_end_ = end;
+		__atomic_store_n(&throttled_, false, __ATOMIC_RELAXED);
+	}
+
+	timer_wheel::cancel(refill_timer_);
+
+	if (quota) {
+		core::this_core().timers().add(refill_timer_, end);
+	}
+
+	// Threads parked under the old quota can run again.
+	for (auto *c : core_manager::get().cores()) {
+		if (c->online()) {
+			c->unpark(*this);
+		}
+	}
+}
+
+void cpu_quota::charge_slow(u64 delta)
+{
+	unique_irq_lock l(lock_);
+
+	used_ += delta;
+
+	if (quota_ && used_ >= quota_ && !throttled_) {
+		__atomic_store_n(&throttled_, true, __ATOMIC_RELAXED);
+		nr_throttled_++;
+	}
+}
+
+void cpu_quota::refill_expired(void *arg)
+{
+	cpu_quota *q = (cpu_quota *)arg;
+	u64 next;
+
+	{
+		unique_irq_lock l(q->lock_);
+
+		if (!q->quota_) {
+			return;
+		}
+
+		// Time the threads ran beyond the quota is not carried over, so a period that started
+		// throttled does not leave the next one short.
+		u64 now = __builtin_ia32_rdtsc();
+		while (q->period_end_ <= now) {
+			q->period_end_ += q->period_;
+		}
+
+		q->used_ = 0;
+		q->nr_periods_++;
+		__atomic_store_n(&q->throttled_, false, __ATOMIC_RELAXED);
+
+		next = q->period_end_;
+	}
+
+	for (auto *c : core_manager::get().cores()) {
+		if (c->online()) {
+			c->unpark(*q);
+		}
+	}
+
+	core::this_core().timers().add(q->refill_timer_, next);
+}
@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/mem/address-space.h>
+#include <stacsos/kernel/mem/swap-manager.h>
+#include <stacsos/kernel/sched/futex.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::mem;
+using namespace stacsos::kernel::sched;
+
+// Futex words must be naturally aligned, and live in the lower (user) half of the address space.
+static bool valid_futex_address(u64 uaddr) { return (uaddr & 3) == 0 && uaddr < 0x0000800000000000ull; }
+
+static_assert(futex_table::nr_buckets == 64, "the bucket hash produces six bits");
+
+wait_queue &futex_table::bucket_for(const wait_key &key)
+{
+	// Fibonacci hashing: the top bits of the product depend on every bit of the key.
+	u64 h = ((u64)key.object ^ key.offset) * 0x9e3779b97f4a7c15ull;
+	return buckets_[h >> 58];
+}
+
+futex_result futex_table::wait(address_space &as, u64 uaddr, u32 expected, u64 deadline)
+{
+	if (!valid_futex_address(uaddr)) {
+		return futex_result::invalid;
+	}
+
+	volatile u32 *word = (volatile u32 *)uaddr;
+	wait_key key { &as, uaddr };
+
+	while (true) {
+		// Touch the word before the bucket is locked, so that any page fault needed to bring it in is
+		// taken with interrupts enabled.
+		(void)*word;
+
+		// The value is checked with the bucket locked, and a waker must take the same lock, so a wake
+		// that follows a change to the word cannot be missed.  The check must not fault, so it reads
+		// the word with reclaim held off, and fails if the page has been swapped out again since it
+		// was touched.
+		bool resident = true;
+		auto result = bucket_for(key).wait_if(
+			[&as, uaddr, expected, &resident] {
+				u32 value;
+				resident = swap_manager::get().read_resident_word(as, uaddr, value);
+				return resident && value == expected;
+			},
+			deadline, key);
+
+		switch (result) {
+		case wait_result::woken:
+			return futex_result::woken;
+		case wait_result::timed_out:
+			return futex_result::timed_out;
+		default:
+			if (resident) {
+				return futex_result::value_changed;
+			}
+		}
+	}
+}
+
+unsigned int futex_table::wake(address_space &as, u64 uaddr, unsigned int count)
+{
+	if (!valid_futex_address(uaddr)) {
+		return 0;
+	}
+
+	wait_key key { &as, uaddr };
+	return bucket_for(key).wake_n(count, key);
+}
@@ -24,11 +24,13 @@ void process_manager::init() { dprintf("processes: init\n"); }
 
 shared_ptr<process> process_manager::create_kernel_process(continuation_fn cfn)
 {
-	auto kp = new process(exec_privilege::kernel);
-	kp->create_thread((u64)cfn);
+	auto kp = new process(exec_privilege::kernel, next_process_id_++);
+	if (cfn) {
+		kp->create_thread((u64)cfn);
+	}
 
 	auto kpp = shared_ptr(kp);
-	active_processes_.append(kpp);
+	add_process(kpp);
 
 	return kpp;
 }
@@ -67,7 +69,7 @@ shared_ptr<process> process_manager::create_process(const char *path, const char
 	// load address space
 	// create main thread
 
-	auto proc = new process(exec_privilege::user);
+	auto proc = new process(exec_privilege::user, next_process_id_++);
 
 	char *program_headers = new char[ehdr->e_phnum * ehdr->e_phentsize];
 	file->pread(program_headers, ehdr->e_phoff, ehdr->e_phnum * ehdr->e_phentsize);
@@ -107,7 +109,7 @@ shared_ptr<process> process_manager::create_process(const char *path, const char
 	proc->create_thread(ehdr->e_entry, (void *)data_page->base);
 
 	auto pp = shared_ptr(proc);
-	active_processes_.append(pp);
+	add_process(pp);
 
 	return pp;
 }
@@ -5,6 +5,7 @@
  * Copyright (c) University of St Andrews 2024
  * Tom Spink <tcs6@st-andrews.ac.uk>
  */
+#include <stacsos/kernel/arch/per-cpu.h>
 #include <stacsos/kernel/mem/address-space.h>
 #include <stacsos/kernel/sched/process.h>
 #include <stacsos/kernel/sched/thread.h>
@@ -17,24 +18,51 @@ shared_ptr<thread> process::create_thread(u64 entry_point, void *entry_arg)
 {
 	u64 user_stack = 0;
 	if (priv_ == exec_privilege::user) {
-		u64 stack_base = next_user_stack_;
+		u64 stack_base;
 		u64 stack_size = 0x4000;
 
-		next_user_stack_ += stack_size + 0x1000; // Allocate the stack size, but plus a "guard page".
+		{
+			unique_irq_lock l(lock_);
+
+			stack_base = next_user_stack_;
+			next_user_stack_ += stack_size + 0x1000; // Allocate the stack size, but plus a "guard page".
+		}
 
 		user_stack = stack_base + stack_size;
 		addrspace().add_region(stack_base, stack_size, region_flags::readwrite, true);
 	}
 
 	shared_ptr<thread> t = shared_ptr(new thread(*this, entry_point, entry_arg, user_stack));
-	threads_.append(t);
+	t->get_tcb()->quota = &quota_;
+
+	// A new thread inherits the scheduling parameters and affinity of the thread that created it,
+	// whether it is in the same process or a new one.  Deadline bandwidth is reserved for one
+	// thread, so the children of a deadline thread are normal threads.
+	auto creator = stacsos::kernel::arch::this_cpu(stacsos::kernel::arch::cpu_data).current;
+	if (creator && creator->entity) {
+		tcb &new_tcb = *t->get_tcb();
+		new_tcb.nice = creator->nice;
+		t->set_affinity(creator->entity->affinity());
+
+		if (!is_deadline(*creator)) {
+			new_tcb.policy = creator->policy;
+			new_tcb.rt_priority = creator->rt_priority;
+		}
+	}
+
+	{
+		unique_irq_lock l(lock_);
+		threads_.append(t);
+	}
 
 	return t;
 }
 
+// Starting and stopping threads calls back into the process, so these walk a copy of the thread list.
+
 void process::start()
 {
-	for (auto &t : threads_) {
+	for (auto &t : threads()) {
 		t->start();
 	}
 
@@ -44,7 +72,7 @@ void process::start()
 
 void process::stop()
 {
-	for (auto &t : threads_) {
+	for (auto &t : threads()) {
 		t->stop();
 	}
 
@@ -56,7 +84,7 @@ void process::on_thread_stopped(thread &thread)
 {
 	dprintf("thread stopped\n");
 
-	for (auto &t : threads_) {
+	for (auto &t : threads()) {
 		if (t->state() != thread_states::terminated) {
 			return;
 		}
@@ -13,8 +13,162 @@
 using namespace stacsos::kernel::sched;
 using namespace stacsos::kernel::arch;
 
-// TODO: support multicore.
+/*
+ * Chooses a core for an entity that has not been scheduled before, or has to leave its core: the
+ * online core with the fewest runnable entities, of those that AFFINITY allows.  Before the cores
+ * are started, everything goes on the boot core.
+ */
+core *scheduler::select_core(u64 affinity)
+{
+	core *candidate = nullptr;
+	bool any_online = false;
+
+	for (auto *c : core_manager::get().cores()) {
+		if (!c->online()) {
+			continue;
+		}
+
+		any_online = true;
+
+		if (!((affinity >> c->id()) & 1)) {
+			continue;
+		}
+
+		if (candidate == nullptr || c->nr_runnable() < candidate->nr_runnable()) {
+			candidate = c;
+		}
+	}
+
+	return any_online ? candidate : &core_manager::get().get_boot_core();
+}
+
+void schedulable_entity::pin(core *c)
+{
+	owning_core_ = c;
+	affinity_ = 1ull << c->id();
+	pinned_ = true;
+}
+
+void scheduler::add_to_schedule(schedulable_entity &e)
+{
+	// An entity stays on the core it was first placed on, unless the load balancer moves it.
+	if (!e.owning_core()) {
+		e.set_owning_core(select_core(e.affinity()));
+	}
+
+	// If the entity is migrated while we wait for its core's run queue lock, try again on the new core.
+	while (!e.owning_core()->add_to_runqueue(*e.get_tcb())) { }
+}
+
+/*
+ * Places a woken entity, preferring (in order) the core it last ran on, if that core is idle, the
+ * waking core, if it is idle, and any other idle core, of those its affinity allows.  If no such
+ * core is idle, the entity returns to the core it last ran on, if allowed, or else the least loaded
+ * allowed core.  A pinned entity, or a deadline task, always goes back to its own core.  An idle
+ * target is sent a reschedule IPI, so the entity runs without waiting for the next timer tick.
+ */
+void scheduler::wake_up(schedulable_entity &e)
+{
+	tcb &t = *e.get_tcb();
+
+	core *previous = t.last_core ? t.last_core : e.owning_core();
+	core *target = nullptr;
+
+	if (e.pinned() || is_deadline(t)) {
+		// Deadline tasks stay on the core their bandwidth is reserved on.
+		target = e.owning_core();
+		wakeup_stats_.pinned++;
+	} else if (previous && previous->task_in_use(t)) {
+		// The entity is still on its way off the previous core (it may not even have yielded
+		// yet), so it must stay there.  If its affinity has changed, that core moves it on.
+		target = previous;
+		wakeup_stats_.pinned++;
+	} else if (previous && e.allowed_on(previous->id()) && previous->idle()) {
+		target = previous;
+		wakeup_stats_.previous_idle++;
+	} else if (e.allowed_on(core::this_core_id()) && core::this_core().idle()) {
+		target = &core::this_core();
+		wakeup_stats_.waker_idle++;
+	} else {
+		for (auto *c : core_manager::get().cores()) {
+			if (c->online() && e.allowed_on(c->id()) && c->idle()) {
+				target = c;
+				wakeup_stats_.other_idle++;
+				break;
+			}
+		}
+	}
+
+	if (!target) {
+		target = previous && e.allowed_on(previous->id()) ? previous : select_core(e.affinity());
+		wakeup_stats_.previous_busy++;
+	}
+
+	bool kick = target->idle();
+
+	if (e.owning_core()) {
+		e.owning_core()->hand_over(t, *target);
+	} else {
+		e.set_owning_core(target);
+	}
+
+	add_to_schedule(e);
+
+	if (kick) {
+		target->send_reschedule();
+		wakeup_stats_.ipis++;
+	}
+}
+
+bool scheduler::set_sched_params(schedulable_entity &e, const sched_params &params)
+{
+	// Deadline bandwidth is reserved on a particular core, so an entity that has never been
+	// scheduled is placed now, and stays there.
+	if (params.policy == sched_policy::deadline && !e.owning_core()) {
+		e.set_owning_core(select_core(e.affinity()));
+	}
+
+	core *c;
+	sched_change_result r = sched_change_result::not_owner;
+	while ((c = e.owning_core()) && (r = c->change_sched_params(*e.get_tcb(), params)) == sched_change_result::not_owner) { }
+
+	// An entity that has never been scheduled is on no run queue, so there is nothing to move.
+	if (!c) {
+		tcb &t = *e.get_tcb();
+		t.policy = params.policy;
+		t.rt_priority = params.rt_priority;
+		t.nice = params.nice;
+		return true;
+	}
+
+	return r == sched_change_result::ok;
+}
+
+bool scheduler::set_affinity(schedulable_entity &e, u64 mask)
+{
+	// Pinned entities never move.
+	if (e.pinned()) {
+		return false;
+	}
+
+	// The mask is checked and changed under the run queue lock of the entity's core, so that it
+	// cannot race with a change of policy.  The entity may have been migrated while we waited for
+	// that lock, in which case the new core checks it again.
+	core *c;
+	sched_change_result r = sched_change_result::not_owner;
+	while ((c = e.owning_core()) && (r = c->change_affinity(*e.get_tcb(), mask)) == sched_change_result::not_owner) { }
+
+	// An entity that has never been scheduled is on no run queue, so there is nothing to move.
+	if (!c) {
+		e.set_affinity(mask);
+		return true;
+	}
 
-void scheduler::add_to_schedule(schedulable_entity &e) { core_manager::get().get_core(0).add_to_runqueue(*e.get_tcb()); }
+	return r == sched_change_result::ok;
+}
 
-void scheduler::remove_from_schedule(schedulable_entity &e) { core_manager::get().get_core(0).remove_from_runqueue(*e.get_tcb()); }
+void scheduler::remove_from_schedule(schedulable_entity &e)
+{
+	core *c;
+	while ((c = e.owning_core()) && !c->remove_from_runqueue(*e.get_tcb())) { }
+}
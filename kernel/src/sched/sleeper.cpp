@@ -10,46 +10,40 @@
 #include <stacsos/kernel/debug.h>
 #include <stacsos/kernel/sched/sleeper.h>
 #include <stacsos/kernel/sched/thread.h>
+#include <stacsos/kernel/sched/timer-wheel.h>
 
 using namespace stacsos::kernel::sched;
+using namespace stacsos::kernel::arch;
 using namespace stacsos::kernel::arch::x86;
 
-void sleeper::sleep_ms(u64 duration_ms)
+void sleeper::sleep_ms(u64 duration_ms) { sleep_ns(duration_ms * 1000000ull); }
+
+void sleeper::sleep_ns(u64 duration_ns)
 {
 	auto &tsc = x86_core::this_core().local_tsc();
 	u64 ref_time = tsc.read();
 
-	do_sleep(ref_time + ((duration_ms * tsc.frequency()) / 1000));
+	do_sleep(ref_time + tsc.ns_to_cycles(duration_ns));
 }
 
+static void wake_sleeper(void *arg) { ((thread *)arg)->resume(); }
+
 void sleeper::do_sleep(u64 wakeup_deadline)
 {
 	thread *ct = &thread::current();
-	ct->suspend();
-
-	sleeping_thread *st = new sleeping_thread { ct, wakeup_deadline };
-	sleeping_.append(st);
-
-	// dprintf("sleeper: sleeping %p deadline=%lu\n", ct, wakeup_deadline);
+	soft_timer timer(wake_sleeper, ct);
 
-	asm volatile("int $0xff");
-}
+	{
+		// Interrupts stay off until the timer is armed: if the tick switched away from this
+		// thread after it was suspended, but before the timer existed, nothing would wake it up.
+		unique_irq_lock l(sleeping_lock_);
 
-void sleeper::check_wakeup()
-{
-	u64 ref_time = x86_core::this_core().local_tsc().read();
-
-	// TODO: some kind of priority queue
-	list<sleeping_thread *> resumed;
-	for (auto sleeping : sleeping_) {
-		if (ref_time > sleeping->wakeup_deadline) {
-			// dprintf("sleeper: waking %p\n", sleeping->thr);
-			sleeping->thr->resume();
-			resumed.append(sleeping);
-		}
+		ct->suspend();
+		core::this_core().timers().add(timer, wakeup_deadline);
 	}
 
-	for (auto resume : resumed) {
-		sleeping_.remove(resume);
-	}
+	core::yield();
+
+	// The timer lives on this stack, so make sure its callback has finished with it.
+	timer_wheel::cancel(timer);
 }
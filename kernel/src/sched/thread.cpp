@@ -31,7 +31,7 @@ thread::thread(process &owner, u64 ep, void *ep_arg, u64 user_stack)
 
 thread &thread::current()
 {
-	auto current_tcb = stacsos::kernel::arch::core::this_core().get_current_tcb();
+	auto current_tcb = stacsos::kernel::arch::this_cpu(stacsos::kernel::arch::cpu_data).current;
 	assert(current_tcb != nullptr);
 
 	return *(thread *)(current_tcb->entity);
@@ -43,6 +43,12 @@ void thread::start() { change_state(thread_states::runnable); }
 void thread::stop()
 {
 	change_state(thread_states::terminated);
+
+	// Give back the deadline bandwidth the thread reserved on its core.
+	if (is_deadline(*get_tcb())) {
+		scheduler::get().set_sched_params(*this, sched_params { sched_policy::normal, 0, get_tcb()->nice, 0, 0, 0 });
+	}
+
 	owner_.on_thread_stopped(*this);
 }
 void thread::suspend() { change_state(thread_states::suspended); }
@@ -115,6 +121,8 @@ void thread::change_state(thread_states new_state)
 		return;
 	}
 
+	thread_states old_state = state_;
+
 	switch (new_state) {
 	case thread_states::created: // thread is newly created
 		switch (state_) {
@@ -131,11 +139,15 @@ void thread::change_state(thread_states new_state)
 		switch (state_) {
 		case thread_states::created:
 		case thread_states::running:
-		case thread_states::suspended:
 			state_ = new_state;
 			scheduler::get().add_to_schedule(*this);
 			break;
 
+		case thread_states::suspended:
+			state_ = new_state;
+			scheduler::get().wake_up(*this);
+			break;
+
 		default:
 			panic("illegal thread state change");
 		}
@@ -183,5 +195,9 @@ void thread::change_state(thread_states new_state)
 		panic("illegal thread state change");
 	}
 
-	state_changed_event_.trigger();
+	// Nobody waits for a thread to sleep or wake up, and those changes happen while wait queues
+	// are locked, so they are not announced.
+	if (new_state != thread_states::suspended && old_state != thread_states::suspended) {
+		state_changed_event_.trigger();
+	}
 }
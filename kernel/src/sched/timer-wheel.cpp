@@ -0,0 +1,239 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/sched/timer-wheel.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::sched;
+
+// Expiry times are rounded up to the next unit, so a timer never fires early.
+static inline u64 expiry_unit(u64 expires) { return (expires + (1ull << timer_wheel::unit_shift) - 1) >> timer_wheel::unit_shift; }
+
+void timer_wheel::add(soft_timer &t, u64 expires)
+{
+	// A callback may re-add its own timer, so this does not wait for the callback to finish.
+	detach(t, false);
+
+	unique_irq_lock l(lock_);
+
+	// An empty wheel may have fallen behind, if nothing has run it for a while.  It has nothing
+	// to cascade, so it can just be brought up to date.
+	if (nr_pending_ == 0) {
+		u64 now_unit = __builtin_ia32_rdtsc() >> unit_shift;
+		if (now_unit > current_) {
+			current_ = now_unit;
+		}
+	}
+
+	t.expires_ = expires;
+	t.wheel_ = this;
+	insert(t);
+}
+
+bool timer_wheel::cancel(soft_timer &t) { return detach(t, true); }
+
+/*
+ * Removes T from the wheel it is pending on, and returns true if it was pending.  If WAIT is true,
+ * and T's callback is running, waits for it to finish.
+ */
+bool timer_wheel::detach(soft_timer &t, bool wait)
+{
+	while (true) {
+		timer_wheel *w = t.wheel_;
+		if (!w) {
+			return false;
+		}
+
+		unique_irq_lock l(w->lock_);
+
+		if (t.wheel_ != w) {
+			continue;
+		}
+
+		if (wait && w->running_ == &t) {
+			l.unlock();
+
+			while (w->running_ == &t) {
+				__relax();
+			}
+
+			continue;
+		}
+
+		if (!t.pending_) {
+			return false;
+		}
+
+		w->remove(t);
+		return true;
+	}
+}
+
+void timer_wheel::insert(soft_timer &t)
+{
+	u64 unit = expiry_unit(t.expires_);
+
+	// Timers that have already expired go in the slot that is processed next.
+	u64 when = unit > current_ ? unit : current_;
+	u64 delta = when - current_;
+
+	int level = 0;
+	while (level < nr_levels - 1 && delta >= (1ull << ((level + 1) * slot_bits))) {
+		level++;
+	}
+
+	// Timers beyond the range of the top level wait in its furthest slot, and are placed again
+	// when it is cascaded.
+	if (delta >= (1ull << (nr_levels * slot_bits))) {
+		when = current_ + (1ull << (nr_levels * slot_bits)) - 1;
+	}
+
+	int slot = (when >> (level * slot_bits)) & (nr_slots - 1);
+
+	slots_[level][slot].push_back(&t.link_);
+	occupied_[level] |= 1ull << slot;
+
+	t.level_ = level;
+	t.slot_ = slot;
+	t.pending_ = true;
+	nr_pending_++;
+}
+
+void timer_wheel::remove(soft_timer &t)
+{
+	auto &slot = slots_[t.level_][t.slot_];
+
+	slot.remove(&t.link_);
+	if (slot.empty()) {
+		occupied_[t.level_] &= ~(1ull << t.slot_);
+	}
+
+	t.pending_ = false;
+	nr_pending_--;
+}
+
+/*
+ * Re-places the timers in the slot of LEVEL that current_ has just reached, which moves them to
+ * lower levels.
+ */
+void timer_wheel::cascade(int level)
+{
+	int slot = (current_ >> (level * slot_bits)) & (nr_slots - 1);
+	auto &list = slots_[level][slot];
+
+	intrusive_list moving;
+	while (!list.empty()) {
+		moving.push_back(list.pop_front());
+	}
+
+	occupied_[level] &= ~(1ull << slot);
+
+	while (!moving.empty()) {
+		soft_timer *t = soft_timer::from_link(moving.pop_front());
+
+		nr_pending_--;
+		insert(*t);
+	}
+}
+
+void timer_wheel::run_expired(u64 now)
+{
+	u64 now_unit = now >> unit_shift;
+
+	unique_irq_lock l(lock_);
+
+	while (current_ <= now_unit) {
+		if (nr_pending_ == 0) {
+			current_ = now_unit + 1;
+			break;
+		}
+
+		// At the start of a slot on a higher level, move its timers down.  The highest level goes
+		// first, as its timers may land in the lower slots that are cascaded next.
+		int top = 0;
+		while (top < nr_levels - 1 && (current_ & ((1ull << ((top + 1) * slot_bits)) - 1)) == 0) {
+			top++;
+		}
+
+		for (int level = top; level > 0; level--) {
+			cascade(level);
+		}
+
+		auto &slot = slots_[0][current_ & (nr_slots - 1)];
+		while (!slot.empty()) {
+			soft_timer *t = soft_timer::from_link(slot.first());
+			remove(*t);
+
+			running_ = t;
+			l.unlock();
+
+			t->callback_(t->arg_);
+
+			l.lock();
+			running_ = nullptr;
+		}
+
+		current_++;
+
+		// Skip over stretches of time in which nothing can expire or cascade: when the lowest
+		// levels are empty, jump to the start of the next slot on the lowest occupied level.
+		int level = 0;
+		while (level < nr_levels && occupied_[level] == 0) {
+			level++;
+		}
+
+		if (level > 0 && level < nr_levels) {
+			u64 span = 1ull << (level * slot_bits);
+			u64 next = (current_ + span - 1) & ~(span - 1);
+
+			current_ = next < now_unit + 1 ? next : now_unit + 1;
+		}
+	}
+}
+
+u64 timer_wheel::next_expiry()
+{
+	unique_irq_lock l(lock_);
+
+	if (nr_pending_ == 0) {
+		return 0;
+	}
+
+	u64 best = ~0ull;
+
+	for (int level = 0; level < nr_levels; level++) {
+		u64 bits = occupied_[level];
+		if (!bits) {
+			continue;
+		}
+
+		int shift = level * slot_bits;
+		u64 cur = current_ >> shift;
+		int idx = cur & (nr_slots - 1);
+
+		// Rotate the occupancy map so that the current slot is bit 0.
+		u64 rotated = idx ? (bits >> idx) | (bits << (nr_slots - idx)) : bits;
+
+		// The current slot of a higher level has already been cascaded, unless current_ is at
+		// its very start, so timers in it are next reached a full turn later.
+		u64 k;
+		if ((current_ & ((1ull << shift) - 1)) == 0 || !(rotated & 1)) {
+			k = __builtin_ctzll(rotated);
+		} else {
+			rotated &= ~1ull;
+			k = rotated ? __builtin_ctzll(rotated) : nr_slots;
+		}
+
+		u64 when = (cur + k) << shift;
+		if (when < best) {
+			best = when;
+		}
+	}
+
+	return best << unit_shift;
+}
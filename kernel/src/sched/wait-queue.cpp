@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/arch/core.h>
+#include <stacsos/kernel/sched/thread.h>
+#include <stacsos/kernel/sched/timer-wheel.h>
+#include <stacsos/kernel/sched/wait-queue.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel::sched;
+using namespace stacsos::kernel::arch;
+
+static inline wait_queue_entry *entry_from_link(list_link *l)
+{
+	return (wait_queue_entry *)((uintptr_t)l - __builtin_offsetof(wait_queue_entry, link));
+}
+
+/*
+ * Puts the current thread on the queue and switches away from it.  Called with L held; the thread
+ * is suspended before the lock is released, so a wake-up cannot slip in between.
+ */
+bool wait_queue::sleep(unique_irq_lock &l, u64 deadline, const wait_key &key)
+{
+	if (deadline && __builtin_ia32_rdtsc() >= deadline) {
+		l.unlock();
+		return false;
+	}
+
+	thread *ct = &thread::current();
+
+	wait_queue_entry e { { nullptr, nullptr }, ct, this, key, false };
+	soft_timer timer(wait_timed_out, &e);
+
+	waiters_.push_back(&e.link);
+	ct->suspend();
+
+	if (deadline) {
+		core::this_core().timers().add(timer, deadline);
+	}
+
+	l.unlock();
+
+	core::yield();
+
+	// The entry and the timer live on this stack, so make sure the timer callback has finished
+	// with them.
+	if (deadline) {
+		timer_wheel::cancel(timer);
+	}
+
+	return !e.timed_out;
+}
+
+void wait_queue::wait_timed_out(void *arg)
+{
+	wait_queue_entry *e = (wait_queue_entry *)arg;
+	unique_irq_lock l(e->queue->lock_);
+
+	// The thread may have been woken just before the timer fired.
+	if (intrusive_list::linked(&e->link)) {
+		e->queue->waiters_.remove(&e->link);
+		e->timed_out = true;
+		e->thr->resume();
+	}
+}
+
+unsigned int wait_queue::wake_n(unsigned int n)
+{
+	unique_irq_lock l(lock_);
+
+	unsigned int woken = 0;
+	while (woken < n && !waiters_.empty()) {
+		// The entry belongs to the woken thread, and must not be touched once it is resumed.
+		thread *t = entry_from_link(waiters_.pop_front())->thr;
+		t->resume();
+
+		woken++;
+	}
+
+	return woken;
+}
+
+unsigned int wait_queue::wake_n(unsigned int n, const wait_key &key)
+{
+	unique_irq_lock l(lock_);
+
+	unsigned int woken = 0;
+	list_link *link = waiters_.first();
+
+	while (woken < n && link) {
+		list_link *next = waiters_.next(link);
+		wait_queue_entry *e = entry_from_link(link);
+
+		if (e->key == key) {
+			thread *t = e->thr;
+
+			waiters_.remove(link);
+			t->resume();
+
+			woken++;
+		}
+
+		link = next;
+	}
+
+	return woken;
+}
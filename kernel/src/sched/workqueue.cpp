@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Kernel
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/kernel/arch/core-manager.h>
+#include <stacsos/kernel/arch/core.h>
+#include <stacsos/kernel/debug.h>
+#include <stacsos/kernel/sched/process-manager.h>
+#include <stacsos/kernel/sched/scheduler.h>
+#include <stacsos/kernel/sched/thread.h>
+#include <stacsos/kernel/sched/wait-queue.h>
+#include <stacsos/kernel/sched/workqueue.h>
+
+using namespace stacsos;
+using namespace stacsos::kernel;
+using namespace stacsos::kernel::arch;
+using namespace stacsos::kernel::sched;
+
+DEFINE_PER_CPU(workqueue_stats, stacsos::kernel::sched::workqueue_statistics);
+
+// The items queued on a core, most recent first, and the queue its worker sleeps on.  The wait
+// queue is created with the worker, so there is nobody to wake before then.
+static DEFINE_PER_CPU(work_item *, pending_work);
+static DEFINE_PER_CPU(wait_queue *, worker_waiters);
+
+void workqueue::init()
+{
+	auto kp = process_manager::get().create_kernel_process();
+
+	for (auto *c : core_manager::get().cores()) {
+		if (!c->online()) {
+			continue;
+		}
+
+		c->per_cpu(worker_waiters) = new wait_queue();
+
+		auto worker = kp->create_thread((u64)worker_main, c);
+		worker->pin(c);
+		scheduler::get().set_sched_params(*worker, sched_params { sched_policy::fifo, worker_priority, 0, 0, 0, 0 });
+	}
+
+	kp->start();
+
+	dprintf("workqueue: started workers\n");
+}
+
+bool workqueue::queue(work_item &w)
+{
+	// Interrupts stay disabled, so that the item is queued on the core that was looked up.
+	u64 flags = irq_save();
+	bool queued = queue_on(core::this_core(), w);
+	irq_restore(flags);
+
+	return queued;
+}
+
+bool workqueue::queue_on(core &c, work_item &w)
+{
+	auto &stats = c.per_cpu(workqueue_statistics);
+
+	if (__atomic_exchange_n(&w.pending_, true, __ATOMIC_ACQUIRE)) {
+		__atomic_fetch_add(&stats.coalesced, 1, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	__atomic_fetch_add(&stats.queued, 1, __ATOMIC_RELAXED);
+	w.queued_at_ = __builtin_ia32_rdtsc();
+
+	work_item *&head = c.per_cpu(pending_work);
+	work_item *old = __atomic_load_n(&head, __ATOMIC_RELAXED);
+
+	do {
+		w.next_ = old;
+	} while (!__atomic_compare_exchange_n(&head, &old, &w, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	// The worker only needs waking when the queue was empty: otherwise, it has yet to take the
+	// items already there, and will find this one with them.
+	if (old == nullptr) {
+		wait_queue *waiters = c.per_cpu(worker_waiters);
+		if (waiters) {
+			waiters->wake_one();
+		}
+	}
+
+	return true;
+}
+
+void workqueue::worker_main(void *arg)
+{
+	// The worker is pinned, so its core's per-CPU data can be looked up once.
+	core &c = *(core *)arg;
+	work_item *&head = c.per_cpu(pending_work);
+	wait_queue &waiters = *c.per_cpu(worker_waiters);
+	auto &stats = c.per_cpu(workqueue_statistics);
+
+	while (true) {
+		waiters.wait_event([&] { return __atomic_load_n(&head, __ATOMIC_RELAXED) != nullptr; });
+
+		work_item *list = __atomic_exchange_n(&head, nullptr, __ATOMIC_ACQUIRE);
+
+		// The queue is a stack, so reverse it to run the items in the order they were queued.
+		work_item *fifo = nullptr;
+		while (list) {
+			work_item *next = list->next_;
+			list->next_ = fifo;
+			fifo = list;
+			list = next;
+		}
+
+		while (fifo) {
+			work_item *w = fifo;
+			fifo = w->next_;
+
+			u64 latency = __builtin_ia32_rdtsc() - w->queued_at_;
+			stats.run++;
+			stats.latency_total += latency;
+			if (latency > stats.latency_max) {
+				stats.latency_max = latency;
+			}
+
+			// The item may be queued again (even by itself) as soon as it is no longer pending.
+			work_fn fn = w->fn_;
+			void *fn_arg = w->arg_;
+			__atomic_store_n(&w->pending_, false, __ATOMIC_RELEASE);
+
+			fn(fn_arg);
+		}
+	}
+}
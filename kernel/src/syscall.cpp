@@ -5,7 +5,9 @@
  * Copyright (c) University of St Andrews 2024
  * Tom Spink <tcs6@st-andrews.ac.uk>
  */
+#include <stacsos/kernel/arch/core-manager.h>
 #include <stacsos/kernel/arch/x86/cregs.h>
+#include <stacsos/kernel/arch/x86/x86-core.h>
 #include <stacsos/kernel/arch/x86/pio.h>
 #include <stacsos/kernel/debug.h>
 #include <stacsos/kernel/fs/directory.h>
@@ -13,8 +15,10 @@
 #include <stacsos/kernel/mem/address-space.h>
 #include <stacsos/kernel/obj/object-manager.h>
 #include <stacsos/kernel/obj/object.h>
+#include <stacsos/kernel/sched/futex.h>
 #include <stacsos/kernel/sched/process-manager.h>
 #include <stacsos/kernel/sched/process.h>
+#include <stacsos/kernel/sched/scheduler.h>
 #include <stacsos/kernel/sched/sleeper.h>
 #include <stacsos/kernel/sched/thread.h>
 #include <stacsos/syscalls.h>
@@ -48,10 +52,40 @@ static syscall_result do_open(process &owner, const char *path)
 
 static syscall_result operation_result_to_syscall_result(operation_result &&o)
 {
-	syscall_result_code rc = (syscall_result_code)o.code;
+	syscall_result_code rc;
+
+	switch (o.code) {
+	case operation_result_code::ok:
+		rc = syscall_result_code::ok;
+		break;
+	case operation_result_code::not_found:
+		rc = syscall_result_code::not_found;
+		break;
+	case operation_result_code::timed_out:
+		rc = syscall_result_code::timed_out;
+		break;
+	case operation_result_code::busy:
+		rc = syscall_result_code::busy;
+		break;
+	default:
+		rc = syscall_result_code::not_supported;
+		break;
+	}
+
 	return syscall_result { rc, o.data };
 }
 
+// Converts a timeout in nanoseconds, as passed to a system call, to a deadline for a kernel wait.
+static u64 timeout_to_deadline(u64 timeout_ns)
+{
+	if (timeout_ns == timeout_infinite) {
+		return 0;
+	}
+
+	auto &tsc = x86_core::this_core().local_tsc();
+	return tsc.read() + tsc.ns_to_cycles(timeout_ns);
+}
+
 static syscall_result do_opendir(process &owner, const char *path)
 {
 	auto node = vfs::get().lookup(path);
@@ -102,8 +136,110 @@ static syscall_result do_readdir(process &owner, u64 id, const void *d)
 	return syscall_result { syscall_result_code::ok, 1 };
 }
 
+// Sets the scheduling policy of T.  VALUE is the real-time priority for fifo and rr, and the nice
+// level for normal.  Deadline parameters are set with do_set_sched_deadline().
+static syscall_result do_set_sched_params(thread &t, u64 policy, s64 value)
+{
+	if (policy > (u64)sched_policy::rr) {
+		return syscall_result { syscall_result_code::not_supported, 0 };
+	}
+
+	switch ((sched_policy)policy) {
+	case sched_policy::normal:
+		if (value < min_nice || value > max_nice) {
+			return syscall_result { syscall_result_code::not_supported, 0 };
+		}
+
+		scheduler::get().set_sched_params(t, sched_params { sched_policy::normal, 0, value, 0, 0, 0 });
+		return syscall_result { syscall_result_code::ok, 0 };
+
+	case sched_policy::fifo:
+	case sched_policy::rr:
+		if (value < min_rt_priority || value > max_user_rt_priority) {
+			return syscall_result { syscall_result_code::not_supported, 0 };
+		}
+
+		scheduler::get().set_sched_params(t, sched_params { (sched_policy)policy, (u8)value, t.get_tcb()->nice, 0, 0, 0 });
+		return syscall_result { syscall_result_code::ok, 0 };
+
+	default:
+		break;
+	}
+
+	return syscall_result { syscall_result_code::not_supported, 0 };
+}
+
+// Periods longer than this are not supported, which keeps the bandwidth arithmetic in range.
+static const u64 max_dl_period_ns = 10000000000ull;
+
+// Makes T a deadline thread, reserving RUNTIME_NS of every PERIOD_NS, to be used within
+// DEADLINE_NS of the period starting (or the whole period, if DEADLINE_NS is zero).
+static syscall_result do_set_sched_deadline(thread &t, u64 runtime_ns, u64 period_ns, u64 deadline_ns)
+{
+	if (deadline_ns == 0) {
+		deadline_ns = period_ns;
+	}
+
+	if (runtime_ns == 0 || runtime_ns > deadline_ns || deadline_ns > period_ns || period_ns > max_dl_period_ns) {
+		return syscall_result { syscall_result_code::not_supported, 0 };
+	}
+
+	auto &tsc = x86_core::this_core().local_tsc();
+	sched_params params { sched_policy::deadline, 0, t.get_tcb()->nice, tsc.ns_to_cycles(runtime_ns), tsc.ns_to_cycles(period_ns), tsc.ns_to_cycles(deadline_ns) };
+
+	if (!scheduler::get().set_sched_params(t, params)) {
+		return syscall_result { syscall_result_code::busy, 0 };
+	}
+
+	return syscall_result { syscall_result_code::ok, 0 };
+}
+
+// CPU quota periods are bounded, so that quotas are enforced at a useful granularity, and the
+// arithmetic stays in range.
+static const u64 min_quota_period_ns = 1000000;
+static const u64 max_quota_period_ns = 10000000000ull;
+
+/*
+ * Limits the process with handle HANDLE (or the calling process) to QUOTA_NS of run time, across
+ * all its threads and cores, in every PERIOD_NS.  A quota of zero removes the limit.  The quota may
+ * be more than the period, up to a period on each core.  Deadline threads are not limited by it.
+ */
+static syscall_result do_set_cpu_quota(process &current_process, u64 handle, u64 quota_ns, u64 period_ns)
+{
+	if (quota_ns) {
+		u64 nr_online = 0;
+		for (auto *c : core_manager::get().cores()) {
+			if (c->online()) {
+				nr_online++;
+			}
+		}
+
+		if (period_ns < min_quota_period_ns || period_ns > max_quota_period_ns || quota_ns > period_ns * nr_online) {
+			return syscall_result { syscall_result_code::not_supported, 0 };
+		}
+	}
+
+	auto &tsc = x86_core::this_core().local_tsc();
+	u64 quota = tsc.ns_to_cycles(quota_ns);
+	u64 period = quota ? tsc.ns_to_cycles(period_ns) : 0;
+
+	if (handle == process_self) {
+		current_process.quota().configure(quota, period);
+		return syscall_result { syscall_result_code::ok, 0 };
+	}
+
+	auto process_object = object_manager::get().get_object(current_process, handle);
+	if (!process_object) {
+		return syscall_result { syscall_result_code::not_found, 0 };
+	}
+
+	return operation_result_to_syscall_result(process_object->set_cpu_quota(quota, period));
+}
+
 extern "C" syscall_result handle_syscall(syscall_numbers index, u64 arg0, u64 arg1, u64 arg2, u64 arg3)
 {
+	this_cpu(cpu_data).nr_syscalls++;
+
 	auto &current_thread = thread::current();
 	auto &current_process = current_thread.owner();
 
@@ -207,7 +343,7 @@ extern "C" syscall_result handle_syscall(syscall_numbers index, u64 arg0, u64 ar
 			return syscall_result { syscall_result_code::not_found, 0 };
 		}
 
-		return operation_result_to_syscall_result(process_object->wait_for_status_change());
+		return operation_result_to_syscall_result(process_object->wait_for_status_change(timeout_to_deadline(arg1)));
 	}
 
 	case syscall_numbers::start_thread: {
@@ -219,7 +355,7 @@ extern "C" syscall_result handle_syscall(syscall_numbers index, u64 arg0, u64 ar
 
 	case syscall_numbers::stop_current_thread: {
 		current_thread.stop();
-		asm volatile("int $0xff");
+		core::yield();
 
 		return syscall_result { syscall_result_code::ok, 0 };
 	}
@@ -230,7 +366,7 @@ extern "C" syscall_result handle_syscall(syscall_numbers index, u64 arg0, u64 ar
 			return syscall_result { syscall_result_code::not_found, 0 };
 		}
 
-		return operation_result_to_syscall_result(thread_object->join());
+		return operation_result_to_syscall_result(thread_object->join(timeout_to_deadline(arg1)));
 	}
 
 	case syscall_numbers::sleep: {
@@ -238,6 +374,91 @@ extern "C" syscall_result handle_syscall(syscall_numbers index, u64 arg0, u64 ar
 		return syscall_result { syscall_result_code::ok, 0 };
 	}
 
+	case syscall_numbers::sleep_ns: {
+		sleeper::get().sleep_ns(arg0);
+		return syscall_result { syscall_result_code::ok, 0 };
+	}
+
+	case syscall_numbers::clock_ns: {
+		// Every core converts with the boot core's frequency, so the clock agrees between cores.
+		auto &tsc = x86_core::this_core().local_tsc();
+		return syscall_result { syscall_result_code::ok, tsc.cycles_to_ns(tsc.read()) };
+	}
+
+	case syscall_numbers::futex_wait: {
+		switch (futex_table::get().wait(current_process.addrspace(), arg0, (u32)arg1, timeout_to_deadline(arg2))) {
+		case futex_result::woken:
+			return syscall_result { syscall_result_code::ok, 0 };
+		case futex_result::timed_out:
+			return syscall_result { syscall_result_code::timed_out, 0 };
+		case futex_result::value_changed:
+			return syscall_result { syscall_result_code::would_block, 0 };
+		default:
+			return syscall_result { syscall_result_code::not_supported, 0 };
+		}
+	}
+
+	case syscall_numbers::futex_wake: {
+		unsigned int count = arg1 > 0xffffffffull ? 0xffffffffu : (unsigned int)arg1;
+		return syscall_result { syscall_result_code::ok, futex_table::get().wake(current_process.addrspace(), arg0, count) };
+	}
+
+	case syscall_numbers::sched_yield: {
+		core::yield();
+		return syscall_result { syscall_result_code::ok, 0 };
+	}
+
+	case syscall_numbers::set_sched_params:
+		return do_set_sched_params(current_thread, arg0, (s64)arg1);
+
+	case syscall_numbers::set_sched_deadline:
+		return do_set_sched_deadline(current_thread, arg0, arg1, arg2);
+
+	case syscall_numbers::set_affinity: {
+		// The mask must allow at least one core that is running.
+		u64 online = 0;
+		for (auto *c : core_manager::get().cores()) {
+			if (c->online()) {
+				online |= 1ull << c->id();
+			}
+		}
+
+		if (!(arg1 & online)) {
+			return syscall_result { syscall_result_code::not_supported, 0 };
+		}
+
+		if (arg0 == thread_self) {
+			if (!scheduler::get().set_affinity(current_thread, arg1)) {
+				return syscall_result { syscall_result_code::busy, 0 };
+			}
+
+			return syscall_result { syscall_result_code::ok, 0 };
+		}
+
+		auto thread_object = object_manager::get().get_object(current_process, arg0);
+		if (!thread_object) {
+			return syscall_result { syscall_result_code::not_found, 0 };
+		}
+
+		return operation_result_to_syscall_result(thread_object->set_affinity(arg1));
+	}
+
+	case syscall_numbers::set_cpu_quota:
+		return do_set_cpu_quota(current_process, arg0, arg1, arg2);
+
+	case syscall_numbers::get_affinity: {
+		if (arg0 == thread_self) {
+			return syscall_result { syscall_result_code::ok, current_thread.affinity() };
+		}
+
+		auto thread_object = object_manager::get().get_object(current_process, arg0);
+		if (!thread_object) {
+			return syscall_result { syscall_result_code::not_found, 0 };
+		}
+
+		return operation_result_to_syscall_result(thread_object->get_affinity());
+	}
+
 	case syscall_numbers::poweroff: {
 		pio::outw(0x604, 0x2000);
 		return syscall_result { syscall_result_code::ok, 0 };
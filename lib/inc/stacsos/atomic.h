@@ -12,7 +12,7 @@ template <class T> class atomic {
 public:
 	using self = atomic<T>;
 
-	atomic(T v)
+	constexpr atomic(T v)
 		: v_(v)
 	{
 	}
@@ -29,6 +29,36 @@ public:
 
 	T operator++(int) { return fetch_and_add(1); }
 
+	T exchange(T value)
+	{
+		asm volatile("xchg %0, %1" : "+r"(value), "+m"(v_) : : "memory");
+		return value;
+	}
+
+	/*
+	 * If the value is EXPECTED, replaces it with DESIRED and returns true.  Otherwise, loads the
+	 * current value into EXPECTED and returns false.
+	 */
+	bool compare_exchange(T &expected, T desired)
+	{
+		bool success;
+
+		asm volatile("lock; cmpxchg %3, %1" : "+a"(expected), "+m"(v_), "=@ccz"(success) : "r"(desired) : "memory");
+
+		return success;
+	}
+
+	T load() const { return *(const volatile T *)&v_; }
+
+	void store(T value)
+	{
+		asm volatile("" ::: "memory");
+		*(volatile T *)&v_ = value;
+	}
+
+	// The address of the underlying value, e.g. to use it as a futex.
+	const T *address() const { return &v_; }
+
 	self &operator=(T value)
 	{
 		v_ = value;
@@ -6,6 +6,8 @@ namespace stacsos {
 template <typename T> class end_list {
 public:
 	typedef list_node<T> node;
+	typedef list_iterator<T> iterator;
+
 	end_list()
 		: last_(nullptr)
 		, head_(nullptr)
@@ -81,10 +83,13 @@ public:
 		}
 	}
 
-	int count() {
+	int count() const {
 		return count_;
 	}
 
+	iterator begin() const { return iterator(head_); }
+	iterator end() const { return iterator(nullptr); }
+
 private:
 	list_node<T> *last_;
 	list_node<T> *head_;
@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Utility Library
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+namespace stacsos {
+/*
+ * A link in an intrusive doubly-linked list.  It is embedded in the object being stored, so that
+ * adding and removing never allocates memory.  A zeroed link is not on any list.
+ */
+struct list_link {
+	list_link *prev, *next;
+};
+
+/*
+ * An intrusive, circular doubly-linked list with a sentinel head.  Every operation is O(1).  The
+ * owning object is recovered from a link with the containing type's layout, e.g. via
+ * __builtin_offsetof.
+ */
+class intrusive_list {
+	DELETE_DEFAULT_COPY_AND_MOVE(intrusive_list)
+
+public:
+	intrusive_list()
+		: count_(0)
+	{
+		head_.prev = head_.next = &head_;
+	}
+
+	static bool linked(const list_link *l) { return l->next != nullptr; }
+
+	void push_back(list_link *l) { insert_between(l, head_.prev, &head_); }
+	void push_front(list_link *l) { insert_between(l, &head_, head_.next); }
+
+	void remove(list_link *l)
+	{
+		l->prev->next = l->next;
+		l->next->prev = l->prev;
+		l->prev = l->next = nullptr;
+
+		count_--;
+	}
+
+	list_link *pop_front()
+	{
+		list_link *l = first();
+		if (l) {
+			remove(l);
+		}
+
+		return l;
+	}
+
+	// Moves the first element to the back of the list, and returns it.
+	list_link *rotate()
+	{
+		list_link *l = first();
+		if (l && count_ > 1) {
+			head_.next = l->next;
+			l->next->prev = &head_;
+
+			l->prev = head_.prev;
+			l->next = &head_;
+			head_.prev->next = l;
+			head_.prev = l;
+		}
+
+		return l;
+	}
+
+	list_link *first() const { return empty() ? nullptr : head_.next; }
+
+	// Returns the element following L, or nullptr if L is the last.
+	list_link *next(const list_link *l) const { return l->next == &head_ ? nullptr : l->next; }
+
+	bool empty() const { return count_ == 0; }
+	unsigned int count() const { return count_; }
+
+private:
+	list_link head_;
+	unsigned int count_;
+
+	void insert_between(list_link *l, list_link *prev, list_link *next)
+	{
+		l->prev = prev;
+		l->next = next;
+		prev->next = l;
+		next->prev = l;
+
+		count_++;
+	}
+};
+} // namespace stacsos
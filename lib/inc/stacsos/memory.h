@@ -7,6 +7,7 @@
  */
 #pragma once
 
+#include <stacsos/atomic.h>
 #include <stacsos/helpers.h>
 
 namespace stacsos {
@@ -148,7 +149,7 @@ public:
 
 	operator bool() const { return use_count() > 0; }
 	bool unique() const { return use_count() == 1; }
-	u64 use_count() const { return refcount_ == nullptr ? 0 : *refcount_; }
+	u64 use_count() const { return refcount_ == nullptr ? 0 : refcount_->load(); }
 
 	T &operator*() { return *ptr_; }
 
@@ -168,20 +169,21 @@ public:
 	}
 
 private:
+	// Copies of a pointer may be taken and dropped on different cores at once, so the count is
+	// changed atomically.
 	void acquire()
 	{
 		if (refcount_ == nullptr) {
-			refcount_ = new u64(1);
+			refcount_ = new atomic_u64(1);
 		} else {
-			(*refcount_)++;
+			refcount_->fetch_and_add(1);
 		}
 	}
 
 	void release()
 	{
 		if (refcount_ != nullptr) {
-			(*refcount_)--;
-			if (*refcount_ == 0) {
+			if (refcount_->fetch_and_add(-1) == 1) {
 				if (ptr_ != nullptr) {
 					(void)sizeof(T);
 					delete ptr_;
@@ -197,7 +199,7 @@ private:
 	template <class U> friend class shared_ptr;
 
 	T *ptr_;
-	u64 *refcount_;
+	atomic_u64 *refcount_;
 };
 
 template <class T, class... U> shared_ptr<T> make_shared(U &&...u) { return shared_ptr<T>(new T(forward<U>(u)...)); }
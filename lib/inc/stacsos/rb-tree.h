@@ -0,0 +1,319 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - Utility Library
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+namespace stacsos {
+/*
+ * A node of an intrusive red-black tree.  It is embedded in the object being stored, so
+ * inserting and removing never allocates memory.  The owning object is recovered from the node
+ * with the containing type's layout, e.g. via __builtin_offsetof.
+ */
+struct rb_node {
+	rb_node *parent, *left, *right;
+	bool red;
+	bool linked;
+};
+
+/*
+ * An intrusive red-black tree, which keeps a pointer to its leftmost (smallest) node, so that
+ * finding the minimum is O(1).  Insertion and removal are O(log n).  Nodes with equal keys are
+ * kept in insertion order.
+ */
+class rb_tree {
+	DELETE_DEFAULT_COPY_AND_MOVE(rb_tree)
+
+public:
+	rb_tree()
+		: root_(nullptr)
+		, leftmost_(nullptr)
+		, count_(0)
+	{
+	}
+
+	/*
+	 * Inserts node N.  LESS(a, b) must return true if node a orders before node b.
+	 */
+	template <typename Less> void insert(rb_node *n, Less less)
+	{
+		rb_node *parent = nullptr;
+		rb_node **link = &root_;
+		bool is_leftmost = true;
+
+		while (*link) {
+			parent = *link;
+
+			if (less(n, parent)) {
+				link = &parent->left;
+			} else {
+				link = &parent->right;
+				is_leftmost = false;
+			}
+		}
+
+		n->parent = parent;
+		n->left = n->right = nullptr;
+		n->red = true;
+		n->linked = true;
+		*link = n;
+
+		if (is_leftmost) {
+			leftmost_ = n;
+		}
+
+		insert_fixup(n);
+		count_++;
+	}
+
+	void remove(rb_node *z)
+	{
+		if (leftmost_ == z) {
+			leftmost_ = next(z);
+		}
+
+		rb_node *y = z;
+		bool y_was_red = y->red;
+		rb_node *x, *x_parent;
+
+		if (!z->left) {
+			x = z->right;
+			x_parent = z->parent;
+			transplant(z, z->right);
+		} else if (!z->right) {
+			x = z->left;
+			x_parent = z->parent;
+			transplant(z, z->left);
+		} else {
+			y = z->right;
+			while (y->left) {
+				y = y->left;
+			}
+
+			y_was_red = y->red;
+			x = y->right;
+
+			if (y->parent == z) {
+				x_parent = y;
+			} else {
+				x_parent = y->parent;
+				transplant(y, y->right);
+				y->right = z->right;
+				y->right->parent = y;
+			}
+
+			transplant(z, y);
+			y->left = z->left;
+			y->left->parent = y;
+			y->red = z->red;
+		}
+
+		if (!y_was_red) {
+			remove_fixup(x, x_parent);
+		}
+
+		z->parent = z->left = z->right = nullptr;
+		z->linked = false;
+		count_--;
+	}
+
+	rb_node *first() const { return leftmost_; }
+
+	// Returns the node following N in order, or nullptr if N is the last.
+	static rb_node *next(rb_node *n)
+	{
+		if (n->right) {
+			n = n->right;
+			while (n->left) {
+				n = n->left;
+			}
+
+			return n;
+		}
+
+		while (n->parent && n == n->parent->right) {
+			n = n->parent;
+		}
+
+		return n->parent;
+	}
+
+	bool empty() const { return count_ == 0; }
+	unsigned int count() const { return count_; }
+
+private:
+	rb_node *root_;
+	rb_node *leftmost_;
+	unsigned int count_;
+
+	static bool is_red(const rb_node *n) { return n && n->red; }
+
+	// Replaces the subtree rooted at U with the one rooted at V.
+	void transplant(rb_node *u, rb_node *v)
+	{
+		if (!u->parent) {
+			root_ = v;
+		} else if (u == u->parent->left) {
+			u->parent->left = v;
+		} else {
+			u->parent->right = v;
+		}
+
+		if (v) {
+			v->parent = u->parent;
+		}
+	}
+
+	void rotate_left(rb_node *x)
+	{
+		rb_node *y = x->right;
+
+		x->right = y->left;
+		if (y->left) {
+			y->left->parent = x;
+		}
+
+		transplant(x, y);
+
+		y->left = x;
+		x->parent = y;
+	}
+
+	void rotate_right(rb_node *x)
+	{
+		rb_node *y = x->left;
+
+		x->left = y->right;
+		if (y->right) {
+			y->right->parent = x;
+		}
+
+		transplant(x, y);
+
+		y->right = x;
+		x->parent = y;
+	}
+
+	void insert_fixup(rb_node *z)
+	{
+		while (is_red(z->parent)) {
+			rb_node *p = z->parent;
+			rb_node *g = p->parent;
+
+			if (p == g->left) {
+				rb_node *u = g->right;
+
+				if (is_red(u)) {
+					p->red = false;
+					u->red = false;
+					g->red = true;
+					z = g;
+				} else {
+					if (z == p->right) {
+						z = p;
+						rotate_left(z);
+						p = z->parent;
+					}
+
+					p->red = false;
+					g->red = true;
+					rotate_right(g);
+				}
+			} else {
+				rb_node *u = g->left;
+
+				if (is_red(u)) {
+					p->red = false;
+					u->red = false;
+					g->red = true;
+					z = g;
+				} else {
+					if (z == p->left) {
+						z = p;
+						rotate_right(z);
+						p = z->parent;
+					}
+
+					p->red = false;
+					g->red = true;
+					rotate_left(g);
+				}
+			}
+		}
+
+		root_->red = false;
+	}
+
+	void remove_fixup(rb_node *x, rb_node *parent)
+	{
+		while (x != root_ && !is_red(x)) {
+			if (x == parent->left) {
+				rb_node *w = parent->right;
+
+				if (is_red(w)) {
+					w->red = false;
+					parent->red = true;
+					rotate_left(parent);
+					w = parent->right;
+				}
+
+				if (!is_red(w->left) && !is_red(w->right)) {
+					w->red = true;
+					x = parent;
+					parent = x->parent;
+				} else {
+					if (!is_red(w->right)) {
+						w->left->red = false;
+						w->red = true;
+						rotate_right(w);
+						w = parent->right;
+					}
+
+					w->red = parent->red;
+					parent->red = false;
+					w->right->red = false;
+					rotate_left(parent);
+					x = root_;
+					parent = nullptr;
+				}
+			} else {
+				rb_node *w = parent->left;
+
+				if (is_red(w)) {
+					w->red = false;
+					parent->red = true;
+					rotate_right(parent);
+					w = parent->left;
+				}
+
+				if (!is_red(w->left) && !is_red(w->right)) {
+					w->red = true;
+					x = parent;
+					parent = x->parent;
+				} else {
+					if (!is_red(w->left)) {
+						w->right->red = false;
+						w->red = true;
+						rotate_left(w);
+						w = parent->left;
+					}
+
+					w->red = parent->red;
+					parent->red = false;
+					w->left->red = false;
+					rotate_right(parent);
+					x = root_;
+					parent = nullptr;
+				}
+			}
+		}
+
+		if (x) {
+			x->red = false;
+		}
+	}
+};
+} // namespace stacsos
@@ -8,7 +8,32 @@
 #pragma once
 
 namespace stacsos {
-enum class syscall_result_code : u64 { ok = 0, not_found = 1, not_supported = 2 };
+enum class syscall_result_code : u64 { ok = 0, not_found = 1, not_supported = 2, timed_out = 3, would_block = 4, busy = 5 };
+
+// Passed as the timeout of a wait to wait forever.
+static const u64 timeout_infinite = ~0ull;
+
+// Passed as a thread, or process, handle to refer to the calling thread, or its process.
+static const u64 thread_self = ~0ull;
+static const u64 process_self = ~0ull;
+
+/*
+ * Scheduling policies.  Deadline threads run first, earliest deadline first, each within the runtime
+ * it reserved per period.  Real-time threads (fifo and rr) run next, a higher priority before a
+ * lower one.  A fifo thread runs until it blocks or yields; rr threads of equal priority take
+ * turns, a timeslice at a time.  Normal threads share the remaining time according to their nice
+ * level.
+ */
+enum class sched_policy : u8 { normal = 0, fifo = 1, rr = 2, deadline = 3 };
+
+static const int min_rt_priority = 1;
+static const int max_rt_priority = 99;
+
+// Priorities above this are kept for kernel threads, such as the workers that run deferred
+// interrupt handling, so that a user thread cannot shut them out.
+static const int max_user_rt_priority = 49;
+static const int min_nice = -20;
+static const int max_nice = 19;
 
 enum class syscall_numbers {
 	exit = 0,
@@ -31,6 +56,16 @@ enum class syscall_numbers {
 	ioctl = 17,
 	opendir = 18,
 	readdir = 19,
+	sleep_ns = 20,
+	clock_ns = 21,
+	futex_wait = 22,
+	futex_wake = 23,
+	sched_yield = 24,
+	set_sched_params = 25,
+	set_sched_deadline = 26,
+	set_affinity = 27,
+	get_affinity = 28,
+	set_cpu_quota = 29,
 };
 
 struct syscall_result {
@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - CPU affinity test utility
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/console.h>
+#include <stacsos/threads.h>
+#include <stacsos/user-syscall.h>
+
+using namespace stacsos;
+
+static const unsigned int nr_hogs = 8;
+static const unsigned int nr_samples = 100;
+static const u64 sleep_duration_ns = 1000000;
+static const u64 batch_cores = 1;
+static const u64 all_cores = ~0ull;
+
+static volatile bool stop_hogs;
+
+// Burns CPU time, like a batch job (e.g. mandelbrot), until told to stop.
+static void *hog(void *)
+{
+	while (!stop_hogs) {
+		asm volatile("pause");
+	}
+
+	return nullptr;
+}
+
+// Returns the worst wakeup latency seen over NR_SAMPLES short sleeps.
+static u64 worst_latency()
+{
+	u64 worst = 0;
+
+	for (unsigned int i = 0; i < nr_samples; i++) {
+		u64 start = syscalls::clock_ns();
+		syscalls::sleep_ns(sleep_duration_ns);
+		u64 elapsed = syscalls::clock_ns() - start;
+
+		u64 latency = elapsed > sleep_duration_ns ? elapsed - sleep_duration_ns : 0;
+		if (latency > worst) {
+			worst = latency;
+		}
+	}
+
+	return worst;
+}
+
+int main(const char *cmdline)
+{
+	if (thread::set_current_affinity(0)) {
+		console::get().write("error: empty affinity mask was accepted\n");
+	}
+
+	// Batch threads are started confined to the first core, and inherit that from this thread.
+	thread::set_current_affinity(batch_cores);
+	if (thread::current_affinity() != batch_cores) {
+		console::get().write("error: affinity was not set\n");
+	}
+
+	thread *hogs[nr_hogs];
+	for (unsigned int i = 0; i < nr_hogs; i++) {
+		hogs[i] = thread::start(hog);
+	}
+
+	// This thread then moves off the batch core, so it should not have to wait for the hogs.
+	if (!thread::set_current_affinity(~batch_cores)) {
+		console::get().write("error: unable to leave the batch core (is there only one core?)\n");
+	} else {
+		console::get().writef("isolated from %u hogs: worst wakeup latency %lu ns\n", nr_hogs, worst_latency());
+	}
+
+	// Letting the hogs go anywhere shows the difference.
+	for (unsigned int i = 0; i < nr_hogs; i++) {
+		hogs[i]->set_affinity(all_cores);
+	}
+
+	console::get().writef("sharing with %u hogs:  worst wakeup latency %lu ns\n", nr_hogs, worst_latency());
+
+	stop_hogs = true;
+	for (unsigned int i = 0; i < nr_hogs; i++) {
+		hogs[i]->join();
+		delete hogs[i];
+	}
+
+	console::get().write("Affinity test complete.\n");
+	return 0;
+}
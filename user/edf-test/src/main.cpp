@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - deadline scheduling test utility
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/console.h>
+#include <stacsos/threads.h>
+#include <stacsos/user-syscall.h>
+
+using namespace stacsos;
+
+static const unsigned int nr_hogs = 8;
+static const unsigned int nr_jobs = 100;
+static const u64 period_ns = 10000000;
+static const u64 runtime_ns = 2000000;
+static const u64 job_ns = 1000000;
+static const u64 overrun_duration_ns = 500000000;
+
+static volatile bool stop_hogs;
+
+static void spin_until(u64 end)
+{
+	while (syscalls::clock_ns() < end) {
+		asm volatile("pause");
+	}
+}
+
+// Burns CPU time, like a batch job (e.g. mandelbrot), until told to stop.
+static void *hog(void *)
+{
+	while (!stop_hogs) {
+		asm volatile("pause");
+	}
+
+	return nullptr;
+}
+
+/*
+ * A periodic job: does JOB_NS of work every period, then yields to wait for the next one, and
+ * counts the jobs that finished after the end of their period.
+ */
+static void *periodic(void *)
+{
+	if (syscalls::set_sched_deadline(runtime_ns, period_ns).code != syscall_result_code::ok) {
+		console::get().write("error: unable to become a deadline thread\n");
+		return nullptr;
+	}
+
+	unsigned int late = 0;
+	u64 worst = 0;
+	u64 release = syscalls::clock_ns();
+
+	for (unsigned int i = 0; i < nr_jobs; i++) {
+		spin_until(syscalls::clock_ns() + job_ns);
+
+		u64 finish = syscalls::clock_ns();
+		u64 response = finish - release;
+		if (response > worst) {
+			worst = response;
+		}
+
+		if (response > period_ns) {
+			late++;
+		}
+
+		syscalls::sched_yield();
+		release += period_ns;
+	}
+
+	console::get().writef("periodic: %u jobs, %u late, worst response %lu ns\n", nr_jobs, late, worst);
+	return nullptr;
+}
+
+/*
+ * Never yields, so runs out of budget every period.  Gaps in the clock show the time it spent
+ * throttled, which should leave it close to RUNTIME_NS of every PERIOD_NS.
+ */
+static void *overrun(void *)
+{
+	if (syscalls::set_sched_deadline(runtime_ns, period_ns).code != syscall_result_code::ok) {
+		console::get().write("error: unable to become a deadline thread\n");
+		return nullptr;
+	}
+
+	u64 start = syscalls::clock_ns();
+	u64 last = start;
+	u64 throttled = 0;
+
+	while (last - start < overrun_duration_ns) {
+		u64 now = syscalls::clock_ns();
+		if (now - last > job_ns / 10) {
+			throttled += now - last;
+		}
+
+		last = now;
+	}
+
+	u64 elapsed = last - start;
+	console::get().writef("overrun: ran %lu%% of the time, reserved %lu%%\n", ((elapsed - throttled) * 100) / elapsed, (runtime_ns * 100) / period_ns);
+	return nullptr;
+}
+
+int main(const char *cmdline)
+{
+	// Reservations beyond the core's limit, or that do not fit in their period, are refused.
+	if (syscalls::set_sched_deadline(period_ns - 1, period_ns).code != syscall_result_code::busy) {
+		console::get().write("error: over-utilised reservation was admitted\n");
+	}
+
+	if (syscalls::set_sched_deadline(period_ns * 2, period_ns).code != syscall_result_code::not_supported) {
+		console::get().write("error: invalid reservation was admitted\n");
+	}
+
+	thread *hogs[nr_hogs];
+	for (unsigned int i = 0; i < nr_hogs; i++) {
+		hogs[i] = thread::start(hog);
+	}
+
+	thread *t = thread::start(periodic);
+	t->join();
+	delete t;
+
+	t = thread::start(overrun);
+	t->join();
+	delete t;
+
+	stop_hogs = true;
+	for (unsigned int i = 0; i < nr_hogs; i++) {
+		hogs[i]->join();
+		delete hogs[i];
+	}
+
+	console::get().write("Deadline test complete; see /dev/schedstat for per-thread misses.\n");
+	return 0;
+}
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - CPU quota test utility
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/console.h>
+#include <stacsos/threads.h>
+#include <stacsos/user-syscall.h>
+
+using namespace stacsos;
+
+static const unsigned int nr_spinners = 4;
+static const u64 quota_ns = 20000000;
+static const u64 period_ns = 100000000;
+static const u64 duration_ns = 1000000000;
+static const u64 gap_ns = 100000;
+
+/*
+ * Spins for DURATION_NS, and returns how long it actually ran for.  Gaps in the clock are time
+ * spent not running, e.g. parked because the process used up its quota.
+ */
+static void *spinner(void *)
+{
+	u64 start = syscalls::clock_ns();
+	u64 last = start;
+	u64 stopped = 0;
+
+	while (last - start < duration_ns) {
+		u64 now = syscalls::clock_ns();
+		if (now - last > gap_ns) {
+			stopped += now - last;
+		}
+
+		last = now;
+	}
+
+	return (void *)((last - start) - stopped);
+}
+
+// Runs the spinners together, and returns their total run time, in percent of one core.
+static u64 measure()
+{
+	thread *spinners[nr_spinners];
+	for (unsigned int i = 0; i < nr_spinners; i++) {
+		spinners[i] = thread::start(spinner);
+	}
+
+	u64 total = 0;
+	for (unsigned int i = 0; i < nr_spinners; i++) {
+		total += (u64)spinners[i]->join();
+		delete spinners[i];
+	}
+
+	return (total * 100) / duration_ns;
+}
+
+int main(const char *cmdline)
+{
+	console::get().writef("unlimited: %u spinners used %lu%% of a core\n", nr_spinners, measure());
+
+	if (syscalls::set_cpu_quota(process_self, quota_ns, period_ns).code != syscall_result_code::ok) {
+		console::get().write("error: unable to set cpu quota\n");
+		return 1;
+	}
+
+	console::get().writef("quota %lu%%: %u spinners used %lu%% of a core\n", (quota_ns * 100) / period_ns, nr_spinners, measure());
+
+	syscalls::set_cpu_quota(process_self, 0, 0);
+
+	console::get().write("Quota test complete.\n");
+	return 0;
+}
@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - scheduling latency test utility
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/console.h>
+#include <stacsos/samples.h>
+#include <stacsos/threads.h>
+#include <stacsos/user-syscall.h>
+
+using namespace stacsos;
+
+static const unsigned int nr_samples = 100;
+static const unsigned int nr_hogs = 8;
+static const u64 sleep_duration_ns = 1000000;
+
+static u64 latency_storage[nr_samples];
+static sample_set latency(latency_storage, nr_samples);
+static volatile bool stop_hogs;
+
+// Burns CPU time, like a batch job (e.g. mandelbrot), until told to stop.
+static void *hog(void *)
+{
+	while (!stop_hogs) {
+		asm volatile("pause");
+	}
+
+	return nullptr;
+}
+
+/*
+ * Sleeps repeatedly, and reports how long after its timer each wakeup got to run, which is what an
+ * interactive program (e.g. the shell, waiting for a key) sees.
+ */
+static void measure(const char *label)
+{
+	latency.clear();
+
+	for (unsigned int i = 0; i < nr_samples; i++) {
+		u64 start = syscalls::clock_ns();
+		syscalls::sleep_ns(sleep_duration_ns);
+		latency.add_overshoot(start, syscalls::clock_ns(), sleep_duration_ns);
+	}
+
+	console::get().writef("%s ", label);
+	latency.write_percentiles();
+}
+
+int main(const char *cmdline)
+{
+	console::get().writef("Measuring wakeup latency over %u samples...\n", nr_samples);
+
+	measure("idle, normal:     ");
+
+	thread *hogs[nr_hogs];
+	for (unsigned int i = 0; i < nr_hogs; i++) {
+		hogs[i] = thread::start(hog);
+	}
+
+	measure("loaded, normal:   ");
+
+	syscalls::set_sched_params(sched_policy::normal, min_nice);
+	measure("loaded, nice -20: ");
+
+	if (syscalls::set_sched_params(sched_policy::fifo, 10).code != syscall_result_code::ok) {
+		console::get().write("error: unable to become real-time\n");
+	} else {
+		measure("loaded, fifo 10:  ");
+	}
+
+	syscalls::set_sched_params(sched_policy::normal, 0);
+
+	stop_hogs = true;
+	for (unsigned int i = 0; i < nr_hogs; i++) {
+		hogs[i]->join();
+		delete hogs[i];
+	}
+
+	console::get().write("Latency test complete.\n");
+	return 0;
+}
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - sleep precision test utility
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/console.h>
+#include <stacsos/samples.h>
+#include <stacsos/user-syscall.h>
+
+using namespace stacsos;
+
+static const unsigned int nr_samples = 100;
+static u64 overshoot_storage[nr_samples];
+static sample_set overshoot(overshoot_storage, nr_samples);
+
+/*
+ * Sleeps for DURATION_NS repeatedly, and reports how far past the requested duration each wakeup
+ * landed.
+ */
+static void measure(u64 duration_ns)
+{
+	overshoot.clear();
+
+	for (unsigned int i = 0; i < nr_samples; i++) {
+		u64 start = syscalls::clock_ns();
+		syscalls::sleep_ns(duration_ns);
+		overshoot.add_overshoot(start, syscalls::clock_ns(), duration_ns);
+	}
+
+	console::get().writef("sleep %8lu ns: overshoot ", duration_ns);
+	overshoot.write_percentiles();
+}
+
+int main(const char *cmdline)
+{
+	console::get().writef("Measuring sleep overshoot over %u samples...\n", nr_samples);
+
+	measure(50000);		// 50 us
+	measure(100000);	// 100 us
+	measure(1000000);	// 1 ms
+	measure(10000000);	// 10 ms
+
+	console::get().write("Sleep test complete.\n");
+	return 0;
+}
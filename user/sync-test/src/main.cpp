@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - synchronisation primitives test utility
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/console.h>
+#include <stacsos/sync.h>
+#include <stacsos/threads.h>
+#include <stacsos/user-syscall.h>
+
+using namespace stacsos;
+
+static const unsigned int nr_threads = 4;
+static const unsigned int nr_iterations = 100000;
+static const unsigned int nr_rounds = 100;
+
+static mutex counter_lock;
+static u64 counter;
+
+static barrier round_barrier(nr_threads);
+static u64 rounds_completed;
+
+static void *mutex_worker(void *)
+{
+	for (unsigned int i = 0; i < nr_iterations; i++) {
+		counter_lock.lock();
+		counter++;
+		counter_lock.unlock();
+	}
+
+	return nullptr;
+}
+
+static void *barrier_worker(void *)
+{
+	for (unsigned int i = 0; i < nr_rounds; i++) {
+		if (round_barrier.wait()) {
+			rounds_completed++;
+		}
+	}
+
+	return nullptr;
+}
+
+static mutex queue_lock;
+static condvar queue_cv;
+static unsigned int queued;
+static semaphore done(0);
+
+static void *consumer(void *)
+{
+	for (unsigned int i = 0; i < nr_iterations / 100; i++) {
+		queue_lock.lock();
+		while (queued == 0) {
+			queue_cv.wait(queue_lock);
+		}
+
+		queued--;
+		queue_lock.unlock();
+	}
+
+	done.post();
+	return nullptr;
+}
+
+static void run(const char *name, thread_entry_fn fn)
+{
+	thread *threads[nr_threads];
+
+	u64 start = syscalls::clock_ns();
+
+	for (unsigned int i = 0; i < nr_threads; i++) {
+		threads[i] = thread::start(fn);
+	}
+
+	for (unsigned int i = 0; i < nr_threads; i++) {
+		threads[i]->join();
+		delete threads[i];
+	}
+
+	console::get().writef("%s: %lu us\n", name, (syscalls::clock_ns() - start) / 1000);
+}
+
+int main(const char *cmdline)
+{
+	run("mutex", mutex_worker);
+	console::get().writef("  counter=%lu (expected %lu)\n", counter, (u64)nr_threads * nr_iterations);
+
+	run("barrier", barrier_worker);
+	console::get().writef("  rounds=%lu (expected %u)\n", rounds_completed, nr_rounds);
+
+	thread *c = thread::start(consumer);
+	for (unsigned int i = 0; i < nr_iterations / 100; i++) {
+		queue_lock.lock();
+		queued++;
+		queue_cv.signal();
+		queue_lock.unlock();
+	}
+
+	done.wait();
+	c->join();
+	delete c;
+
+	console::get().writef("condvar/semaphore: queued=%u (expected 0)\n", queued);
+
+	console::get().write("Sync test complete.\n");
+	return 0;
+}
@@ -14,6 +14,10 @@ public:
 
 	void wait_for_exit();
 
+	// Waits up to TIMEOUT_NS nanoseconds for the process to change state.  Returns false if it
+	// did not.
+	bool wait_for_exit(u64 timeout_ns);
+
 private:
 	process(u64 handle)
 		: handle_(handle)
@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - userspace standard library
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+namespace stacsos {
+/*
+ * A set of measurements, e.g. latencies in nanoseconds, held in storage supplied by the caller, and
+ * summarised by percentiles.  Samples beyond the capacity of the storage are dropped.
+ */
+class sample_set {
+public:
+	constexpr sample_set(u64 *storage, unsigned int capacity)
+		: values_(storage)
+		, capacity_(capacity)
+		, count_(0)
+		, sorted_(true)
+	{
+	}
+
+	void clear()
+	{
+		count_ = 0;
+		sorted_ = true;
+	}
+
+	void add(u64 value);
+
+	// Adds the time from START to END, both clock_ns() readings, or zero if the clock appears to have
+	// gone backwards.
+	void add_interval(u64 start, u64 end) { add(end > start ? end - start : 0); }
+
+	// Adds how far the time from START to END overran EXPECTED, or zero if it did not.
+	void add_overshoot(u64 start, u64 end, u64 expected)
+	{
+		u64 elapsed = end > start ? end - start : 0;
+		add(elapsed > expected ? elapsed - expected : 0);
+	}
+
+	unsigned int count() const { return count_; }
+
+	// Returns the smallest sample that is at least PCT percent of the way through the set, so 0
+	// gives the minimum, and 100 the maximum.  Returns zero if the set is empty.
+	u64 percentile(unsigned int pct);
+	u64 max() { return percentile(100); }
+	u64 mean() const;
+
+	// Writes the 50th, 90th and 99th percentiles, and the maximum, to the console, in nanoseconds,
+	// followed by a newline.
+	void write_percentiles();
+
+private:
+	u64 *values_;
+	unsigned int capacity_;
+	unsigned int count_;
+	bool sorted_;
+
+	void sort();
+};
+} // namespace stacsos
@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - userspace standard library
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#pragma once
+
+#include <stacsos/atomic.h>
+
+namespace stacsos {
+/*
+ * A mutex built on a futex.  Locking and unlocking an uncontended mutex are a single atomic
+ * instruction each; the kernel is only entered when a thread has to wait.
+ */
+class mutex {
+public:
+	constexpr mutex()
+		: state_(unlocked)
+	{
+	}
+
+	void lock();
+	bool try_lock();
+	void unlock();
+
+private:
+	// The mutex is "contended" when it is locked and a thread may be waiting for it.
+	static const u32 unlocked = 0, locked = 1, contended = 2;
+
+	atomic_u32 state_;
+};
+
+class condvar {
+public:
+	constexpr condvar()
+		: seq_(0)
+		, waiters_(0)
+	{
+	}
+
+	// Unlocks M, waits to be signalled, and locks M again.  As with any condition variable, wakeups
+	// may be spurious, so the caller must re-check its condition.
+	void wait(mutex &m);
+
+	void signal();
+	void broadcast();
+
+private:
+	atomic_u32 seq_;
+	atomic_u32 waiters_;
+};
+
+class semaphore {
+public:
+	constexpr semaphore(u32 initial)
+		: count_(initial)
+		, waiters_(0)
+	{
+	}
+
+	void wait();
+	bool try_wait();
+	void post();
+
+private:
+	atomic_u32 count_;
+	atomic_u32 waiters_;
+};
+
+class barrier {
+public:
+	constexpr barrier(u32 nr_threads)
+		: nr_threads_(nr_threads)
+		, arrived_(0)
+		, generation_(0)
+	{
+	}
+
+	// Waits until NR_THREADS threads have arrived.  Returns true in exactly one of them.
+	bool wait();
+
+private:
+	u32 nr_threads_;
+	atomic_u32 arrived_;
+	atomic_u32 generation_;
+};
+} // namespace stacsos
@@ -24,6 +24,22 @@ public:
 
 	void *join();
 
+	// Waits up to TIMEOUT_NS nanoseconds for the thread to finish.  Returns false if it is still
+	// running, otherwise stores its result in RESULT.
+	bool try_join(u64 timeout_ns, void *&result);
+
+	/*
+	 * Restricts the thread to the cores in MASK, which has a bit for each core ID.  Threads inherit
+	 * the affinity of the thread that starts them.  Returns false if MASK allows no running core, or
+	 * the thread cannot be moved.
+	 */
+	bool set_affinity(u64 mask);
+	u64 affinity();
+
+	// The same, for the calling thread.
+	static bool set_current_affinity(u64 mask);
+	static u64 current_affinity();
+
 private:
 	thread(u64 handle, thread_context *tc)
 		: handle_(handle)
@@ -90,13 +90,68 @@ public:
 	}
 
 	static syscall_result start_process(const char *path, const char *args) { return syscall2(syscall_numbers::start_process, (u64)path, (u64)args); }
-	static syscall_result wait_process(u64 id) { return syscall1(syscall_numbers::wait_for_process, id); }
+	// Waits for the process to change state, or for TIMEOUT_NS nanoseconds, whichever comes first.
+	static syscall_result wait_process(u64 id, u64 timeout_ns = timeout_infinite)
+	{
+		return syscall2(syscall_numbers::wait_for_process, id, timeout_ns);
+	}
 
 	static syscall_result start_thread(void *entrypoint, void *arg) { return syscall2(syscall_numbers::start_thread, (u64)entrypoint, (u64)arg); }
-	static syscall_result join_thread(u64 id) { return syscall1(syscall_numbers::join_thread, id); }
+	static syscall_result join_thread(u64 id, u64 timeout_ns = timeout_infinite) { return syscall2(syscall_numbers::join_thread, id, timeout_ns); }
 	static syscall_result stop_current_thread() { return syscall0(syscall_numbers::stop_current_thread); }
 
+	// Gives up the processor to another runnable thread, if there is one.
+	static syscall_result sched_yield() { return syscall0(syscall_numbers::sched_yield); }
+
+	/*
+	 * Sets the scheduling policy of the calling thread.  VALUE is the real-time priority for fifo and
+	 * rr, up to max_user_rt_priority, and the nice level for normal.  Threads created afterwards
+	 * inherit the policy.
+	 */
+	static syscall_result set_sched_params(sched_policy policy, s64 value) { return syscall2(syscall_numbers::set_sched_params, (u64)policy, (u64)value); }
+
+	/*
+	 * Makes the calling thread a deadline thread, reserving RUNTIME_NS of every PERIOD_NS, to be used
+	 * within DEADLINE_NS of each period starting (the whole period, if zero).  Calling sched_yield()
+	 * ends the current job.  Fails with busy if the core cannot fit the reservation.
+	 */
+	static syscall_result set_sched_deadline(u64 runtime_ns, u64 period_ns, u64 deadline_ns = 0)
+	{
+		return syscall3(syscall_numbers::set_sched_deadline, runtime_ns, period_ns, deadline_ns);
+	}
+
+	// Sets, or returns, the mask of cores that the thread with handle THREAD (or thread_self) may run
+	// on, with a bit for each core ID.
+	static syscall_result set_affinity(u64 thread, u64 mask) { return syscall2(syscall_numbers::set_affinity, thread, mask); }
+	static syscall_result get_affinity(u64 thread) { return syscall1(syscall_numbers::get_affinity, thread); }
+
+	/*
+	 * Limits the process with handle PROCESS (or process_self) to QUOTA_NS of run time, across all
+	 * its threads, in every PERIOD_NS.  Its threads are held back once the quota is used up, until
+	 * the next period.  A quota of zero removes the limit.
+	 */
+	static syscall_result set_cpu_quota(u64 process, u64 quota_ns, u64 period_ns)
+	{
+		return syscall3(syscall_numbers::set_cpu_quota, process, quota_ns, period_ns);
+	}
+
 	static syscall_result sleep(u64 ms) { return syscall1(syscall_numbers::sleep, ms); }
+	static syscall_result sleep_ns(u64 ns) { return syscall1(syscall_numbers::sleep_ns, ns); }
+
+	// Returns the time since boot, in nanoseconds.
+	static u64 clock_ns() { return syscall0(syscall_numbers::clock_ns).data; }
+
+	/*
+	 * Sleeps while the 32-bit word at ADDR holds EXPECTED, until woken by futex_wake or for TIMEOUT_NS
+	 * nanoseconds.  Returns would_block straight away if the word has already changed.
+	 */
+	static syscall_result futex_wait(const u32 *addr, u32 expected, u64 timeout_ns = timeout_infinite)
+	{
+		return syscall3(syscall_numbers::futex_wait, (u64)addr, expected, timeout_ns);
+	}
+
+	// Wakes up to COUNT threads sleeping on the word at ADDR.  The number woken is returned as data.
+	static syscall_result futex_wake(const u32 *addr, u64 count) { return syscall2(syscall_numbers::futex_wake, (u64)addr, count); }
 
 	static void poweroff() { syscall0(syscall_numbers::poweroff); }
 
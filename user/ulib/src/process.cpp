@@ -22,3 +22,5 @@ process *process::create(const char *path, const char *args)
 }
 
 void process::wait_for_exit() { syscalls::wait_process(handle_); }
+
+bool process::wait_for_exit(u64 timeout_ns) { return syscalls::wait_process(handle_, timeout_ns).code == syscall_result_code::ok; }
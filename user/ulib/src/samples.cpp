@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - userspace standard library
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/console.h>
+#include <stacsos/samples.h>
+
+using namespace stacsos;
+
+void sample_set::add(u64 value)
+{
+	if (count_ == capacity_) {
+		return;
+	}
+
+	values_[count_++] = value;
+	sorted_ = false;
+}
+
+// Sample sets are small, so an insertion sort will do.
+void sample_set::sort()
+{
+	for (unsigned int i = 1; i < count_; i++) {
+		u64 x = values_[i];
+		unsigned int j = i;
+
+		while (j > 0 && values_[j - 1] > x) {
+			values_[j] = values_[j - 1];
+			j--;
+		}
+
+		values_[j] = x;
+	}
+
+	sorted_ = true;
+}
+
+u64 sample_set::percentile(unsigned int pct)
+{
+	if (count_ == 0) {
+		return 0;
+	}
+
+	if (!sorted_) {
+		sort();
+	}
+
+	return values_[((count_ - 1) * pct) / 100];
+}
+
+u64 sample_set::mean() const
+{
+	if (count_ == 0) {
+		return 0;
+	}
+
+	u64 total = 0;
+	for (unsigned int i = 0; i < count_; i++) {
+		total += values_[i];
+	}
+
+	return total / count_;
+}
+
+void sample_set::write_percentiles()
+{
+	console::get().writef("p50=%lu p90=%lu p99=%lu max=%lu ns\n", percentile(50), percentile(90), percentile(99), max());
+}
@@ -0,0 +1,131 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - userspace standard library
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/sync.h>
+#include <stacsos/user-syscall.h>
+
+using namespace stacsos;
+
+static const u64 wake_all = 0xffffffffull;
+
+void mutex::lock()
+{
+	u32 c = unlocked;
+	if (state_.compare_exchange(c, locked)) {
+		return;
+	}
+
+	// Mark the mutex as contended before sleeping, so that whoever unlocks it knows to wake a
+	// waiter.  A thread that takes the mutex here also leaves it marked contended, as there may be
+	// other waiters.
+	if (c != contended) {
+		c = state_.exchange(contended);
+	}
+
+	while (c != unlocked) {
+		syscalls::futex_wait(state_.address(), contended);
+		c = state_.exchange(contended);
+	}
+}
+
+bool mutex::try_lock()
+{
+	u32 c = unlocked;
+	return state_.compare_exchange(c, locked);
+}
+
+void mutex::unlock()
+{
+	if (state_.exchange(unlocked) == contended) {
+		syscalls::futex_wake(state_.address(), 1);
+	}
+}
+
+void condvar::wait(mutex &m)
+{
+	waiters_++;
+	u32 seq = seq_.load();
+
+	m.unlock();
+
+	// If a signal arrives between the unlock and the wait, the sequence number will have moved on,
+	// and the wait returns immediately.
+	syscalls::futex_wait(seq_.address(), seq);
+
+	waiters_.fetch_and_add((u32)-1);
+	m.lock();
+}
+
+void condvar::signal()
+{
+	seq_++;
+
+	if (waiters_.load() > 0) {
+		syscalls::futex_wake(seq_.address(), 1);
+	}
+}
+
+void condvar::broadcast()
+{
+	seq_++;
+
+	if (waiters_.load() > 0) {
+		syscalls::futex_wake(seq_.address(), wake_all);
+	}
+}
+
+bool semaphore::try_wait()
+{
+	u32 c = count_.load();
+
+	while (c > 0) {
+		if (count_.compare_exchange(c, c - 1)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void semaphore::wait()
+{
+	while (!try_wait()) {
+		waiters_++;
+		syscalls::futex_wait(count_.address(), 0);
+		waiters_.fetch_and_add((u32)-1);
+	}
+}
+
+void semaphore::post()
+{
+	count_++;
+
+	if (waiters_.load() > 0) {
+		syscalls::futex_wake(count_.address(), 1);
+	}
+}
+
+bool barrier::wait()
+{
+	u32 gen = generation_.load();
+
+	if (arrived_.fetch_and_add(1) + 1 == nr_threads_) {
+		// The count is reset before the generation moves on, so threads released from this
+		// generation cannot arrive at the next one early.
+		arrived_.store(0);
+		generation_++;
+
+		syscalls::futex_wake(generation_.address(), wake_all);
+		return true;
+	}
+
+	while (generation_.load() == gen) {
+		syscalls::futex_wait(generation_.address(), gen);
+	}
+
+	return false;
+}
@@ -33,3 +33,20 @@ void *thread::join()
 	auto r = syscalls::join_thread(handle_);
 	return tc_->result_;
 }
+
+bool thread::try_join(u64 timeout_ns, void *&result)
+{
+	auto r = syscalls::join_thread(handle_, timeout_ns);
+	if (r.code != syscall_result_code::ok) {
+		return false;
+	}
+
+	result = tc_->result_;
+	return true;
+}
+
+bool thread::set_affinity(u64 mask) { return syscalls::set_affinity(handle_, mask).code == syscall_result_code::ok; }
+u64 thread::affinity() { return syscalls::get_affinity(handle_).data; }
+
+bool thread::set_current_affinity(u64 mask) { return syscalls::set_affinity(thread_self, mask).code == syscall_result_code::ok; }
+u64 thread::current_affinity() { return syscalls::get_affinity(thread_self).data; }
@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: MIT */
+
+/* StACSOS - yield latency test utility
+ *
+ * Copyright (c) University of St Andrews 2024
+ * Tom Spink <tcs6@st-andrews.ac.uk>
+ */
+#include <stacsos/console.h>
+#include <stacsos/samples.h>
+#include <stacsos/threads.h>
+#include <stacsos/user-syscall.h>
+
+using namespace stacsos;
+
+/*
+ * Measures the time from a thread calling sched_yield to the next thread running.  All threads are
+ * kept on core 0, so that every yield with more than one thread is a switch.  Each thread stamps
+ * the time just before it yields, and the thread that runs next takes its sample from that stamp.
+ * With one thread, the sample is the round trip of a yield that switches to nothing.
+ *
+ * The kernel yields by switching context directly, unless booted with yield=trap, which keeps the
+ * old "int $0xff" path, so the two can be compared.
+ */
+
+static const unsigned int nr_yields = 2000;
+static const unsigned int max_threads = 8;
+
+static u64 storage[max_threads][nr_yields];
+static sample_set *yield_samples[max_threads];
+static volatile u64 yield_started;
+
+static void *yielder(void *arg)
+{
+	sample_set &s = *(sample_set *)arg;
+
+	for (unsigned int i = 0; i < nr_yields; i++) {
+		yield_started = syscalls::clock_ns();
+		syscalls::sched_yield();
+		s.add_interval(yield_started, syscalls::clock_ns());
+	}
+
+	return nullptr;
+}
+
+static void measure(unsigned int nr_threads)
+{
+	thread *threads[max_threads];
+
+	for (unsigned int i = 0; i < nr_threads; i++) {
+		yield_samples[i]->clear();
+		threads[i] = thread::start(yielder, yield_samples[i]);
+	}
+
+	for (unsigned int i = 0; i < nr_threads; i++) {
+		threads[i]->join();
+		delete threads[i];
+	}
+
+	for (unsigned int i = 0; i < nr_threads; i++) {
+		console::get().writef("%u threads, thread %u: mean=%lu ", nr_threads, i, yield_samples[i]->mean());
+		yield_samples[i]->write_percentiles();
+	}
+}
+
+int main(const char *cmdline)
+{
+	for (unsigned int i = 0; i < max_threads; i++) {
+		yield_samples[i] = new sample_set(storage[i], nr_yields);
+	}
+
+	// Each sample includes one clock_ns call, so report what a call costs on its own.
+	sample_set &clock = *yield_samples[0];
+	for (unsigned int i = 0; i < nr_yields; i++) {
+		u64 start = syscalls::clock_ns();
+		clock.add_interval(start, syscalls::clock_ns());
+	}
+
+	console::get().write("clock_ns: ");
+	clock.write_percentiles();
+
+	u64 old_affinity = thread::current_affinity();
+	if (!thread::set_current_affinity(1)) {
+		console::get().write("error: unable to move to core 0\n");
+		return 1;
+	}
+
+	console::get().writef("Measuring sched_yield switch latency over %u yields per thread...\n", nr_yields);
+
+	measure(1);
+	measure(2);
+	measure(8);
+
+	thread::set_current_affinity(old_affinity);
+
+	console::get().write("Yield test complete.\n");
+	return 0;
+}